@@ -0,0 +1,119 @@
+use 5.14.0;
+use warnings;
+use blib;
+use Perl::JIT;
+use Perl::JIT::Emit;
+use Getopt::Long qw(GetOptions);
+use File::Find qw(find);
+use File::Spec;
+use B;
+
+# Reports which op types and reasons keep the code of a module tree
+# from being JITted, weighted by the number of ops:
+#
+#   perl author_tools/jit_coverage.pl -I lib lib/
+#
+# Files are loaded (so BEGIN blocks and top-level code run) and every
+# sub they define is passed to jit_sub, but never called.
+
+my @inc;
+my $top = 30;
+GetOptions(
+  'I=s' => \@inc,
+  'top=i' => \$top,
+);
+@ARGV or die "Usage: $0 [-I dir] [--top N] file-or-directory...\n";
+unshift @INC, @inc;
+
+my @files;
+for my $path (@ARGV) {
+  if (-d $path) {
+    find({ no_chdir => 1, wanted => sub { push @files, $_ if /\.p[lm]$/ } }, $path);
+  } else {
+    push @files, $path;
+  }
+}
+
+my %wanted_file = map { File::Spec->rel2abs($_) => 1 } @files;
+for my $file (sort keys %wanted_file) {
+  eval { require $file; 1 } or warn "Skipping $file: $@";
+}
+
+my @subs;
+my %seen_stash;
+sub collect_subs {
+  my ($stash) = @_;
+  no strict 'refs';
+
+  return if $seen_stash{$stash}++;
+  for my $name (keys %{$stash}) {
+    my $glob = \${$stash}{$name};
+    next unless ref $glob eq 'GLOB';
+
+    if ($name =~ /::$/) {
+      collect_subs("$stash$name") unless $name eq 'main::';
+    } elsif (defined *{$glob}{CODE}) {
+      my $cv = B::svref_2object(*{$glob}{CODE});
+
+      next if $cv->XSUB || !$cv->START->isa('B::OP');
+      push @subs, [ "$stash$name", *{$glob}{CODE} ]
+        if $wanted_file{File::Spec->rel2abs($cv->FILE)};
+    }
+  }
+}
+collect_subs('main::');
+
+sub count_ops {
+  my ($op) = @_;
+  my $count = 0;
+
+  for (my $kid = $op; $kid && $$kid; $kid = $kid->sibling) {
+    ++$count unless $kid->name eq 'null';
+    $count += count_ops($kid->first) if $kid->flags & B::OPf_KIDS;
+  }
+
+  return $count;
+}
+
+my ($ops, $compiled, %failures) = (0, 0);
+Perl::JIT::Emit::reset_bailouts();
+for my $sub (sort { $a->[0] cmp $b->[0] } @subs) {
+  my ($name, $code) = @$sub;
+
+  $ops += count_ops(B::svref_2object($code)->ROOT);
+  if (eval { Perl::JIT::Emit::jit_sub($code); 1 }) {
+    ++$compiled;
+  } else {
+    (my $error = $@) =~ s/ at \S+ line \d+\.?\n//;
+    ++$failures{$error};
+  }
+}
+
+my $bailouts = Perl::JIT::Emit::bailouts();
+my (@rows, %by_reason);
+for my $reason (keys %$bailouts) {
+  for my $op (keys %{$bailouts->{$reason}}) {
+    my $count = $bailouts->{$reason}{$op};
+
+    push @rows, [ $reason, $op, $count ];
+    $by_reason{$reason} += $count;
+  }
+}
+
+printf "%d files, %d subs, %d ops; %d subs compiled\n\n",
+  scalar keys %wanted_file, scalar @subs, $ops, $compiled;
+
+print "Bailouts by reason:\n";
+printf "  %-24s %8d\n", $_, $by_reason{$_}
+  for sort { $by_reason{$b} <=> $by_reason{$a} } keys %by_reason;
+
+print "\nTop bailouts by op type:\n";
+@rows = sort { $b->[2] <=> $a->[2] || $a->[1] cmp $b->[1] } @rows;
+splice @rows, $top if @rows > $top;
+printf "  %-24s %-16s %8d\n", @$_ for @rows;
+
+if (%failures) {
+  print "\nFailed compilations:\n";
+  printf "  %5d %s\n", $failures{$_}, $_
+    for sort { $failures{$b} <=> $failures{$a} } keys %failures;
+}
@@ -71,6 +71,16 @@ foreach my $op (@op_defs) {
     $max_col_length[AST_FLAGS]+1, qq{$op->[AST_FLAGS],},
     $max_col_length[AST_CONST], $op->[AST_CONST], $op->[AST_CLASS];
 }
+print $data_fh "};\n\n";
+
+my @return_types = map scalar_return_type($_), @op_defs;
+my $max_return_type_length = max_col_length([map [$_], @return_types], 0);
+print $data_fh "static pj_op_return_type pj_ast_op_return_types[] = {\n";
+foreach my $i (0..$#op_defs) {
+  printf $data_fh "  %-*s // %-*s (%s)\n",
+    $max_return_type_length+1, "$return_types[$i],",
+    $max_col_length[AST_CONST], $op_defs[$i][AST_CONST], $op_defs[$i][AST_CLASS];
+}
 print $data_fh "};\n\n#endif\n";
 close $data_fh;
 
@@ -240,6 +250,34 @@ sub find_first_last_of_class {
   return \@first_and_last;
 }
 
+# Maps the scalar context part of the return type column to a
+# pj_op_return_type constant
+sub scalar_return_type {
+  my $op = shift;
+  my $type = $op->[RET_TYPE];
+
+  $type =~ s/^\s+|\s+$//g;
+  if ($type =~ /=/) {
+    $type = $type =~ /\bScalar=(\S+)/ ? $1 : 'Any';
+  }
+  $type = 'Any' if $type =~ /\s/;
+
+  my %return_types = (
+    Integer         => 'pj_ret_integer',
+    UnsignedInteger => 'pj_ret_unsigned_integer',
+    Double          => 'pj_ret_double',
+    Numeric         => 'pj_ret_numeric',
+    String          => 'pj_ret_string',
+    Boolean         => 'pj_ret_boolean',
+    Any             => 'pj_ret_any',
+    Scalar          => 'pj_ret_any',
+    Empty           => 'pj_ret_any',
+    'List[Any]'     => 'pj_ret_any',
+  );
+  return $return_types{$type}
+    // die "Unrecognized return type '$type' for '$op->[AST_CONST]'";
+}
+
 sub has_option {
   my $op = shift;
   my $option = shift;
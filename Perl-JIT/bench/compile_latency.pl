@@ -0,0 +1,114 @@
+use 5.14.0;
+use warnings;
+use blib;
+use Perl::JIT;
+use Perl::JIT::Emit;
+use Getopt::Long qw(GetOptions);
+use JSON::PP;
+use Time::HiRes qw(time);
+use B;
+
+# Measures compile throughput: loads a corpus of modules, passes every
+# sub they define to jit_sub (without calling it) and reports the time
+# spent in each phase of the compiler and the peak memory:
+#
+#   perl bench/compile_latency.pl
+#   perl bench/compile_latency.pl -M Moose -M DBI --json latency.json
+#   perl bench/compile_latency.pl --async
+#
+# Subs the JIT can't handle count as well: finding out is part of the
+# compile time.
+
+my (@modules, $json_file, $async);
+GetOptions(
+  'M=s' => \@modules,
+  'json=s' => \$json_file,
+  'async' => \$async,
+);
+@modules = qw(
+  Data::Dumper File::Spec File::Temp Getopt::Long JSON::PP Pod::Simple
+  Pod::Man Text::Balanced Test::More CPAN::Meta Module::Metadata Storable
+  Math::BigInt Math::BigFloat IO::Socket::IP TAP::Harness
+) unless @modules;
+
+my @loaded;
+for my $module (@modules) {
+  if (eval "require $module; 1") {
+    push @loaded, $module;
+  } else {
+    warn "Skipping $module: $@";
+  }
+}
+
+my (@subs, %seen_stash, %seen_sub);
+sub collect_subs {
+  my ($stash) = @_;
+  no strict 'refs';
+
+  return if $seen_stash{$stash}++;
+  for my $name (keys %{$stash}) {
+    my $glob = \${$stash}{$name};
+    next unless ref $glob eq 'GLOB';
+
+    if ($name =~ /::$/) {
+      collect_subs("$stash$name") unless $name eq 'main::';
+    } elsif (defined *{$glob}{CODE}) {
+      my $code = *{$glob}{CODE};
+      my $cv = B::svref_2object($code);
+
+      next if $cv->XSUB || !$cv->START->isa('B::OP');
+      # skip ourselves and aliases
+      next if $cv->FILE =~ /Perl\/JIT|compile_latency/ || $seen_sub{$code}++;
+      push @subs, [ "$stash$name", $code ];
+    }
+  }
+}
+collect_subs('main::');
+@subs = sort { $a->[0] cmp $b->[0] } @subs;
+
+my %options = (async => $async ? 1 : 0);
+my $rss_before = Perl::JIT::Emit::peak_rss();
+my $code_before = Perl::JIT::Emit::code_memory()->{machine_code};
+my $compiled = 0;
+
+Perl::JIT::Emit::reset_phase_times();
+my $start = time;
+for my $sub (@subs) {
+  ++$compiled if eval { Perl::JIT::Emit::jit_sub($sub->[1], %options); 1 };
+}
+Perl::JIT::Emit::wait_for_compilation();
+my $elapsed = time - $start;
+
+my $phases = Perl::JIT::Emit::phase_times();
+my $rss_after = Perl::JIT::Emit::peak_rss();
+my $code_size = Perl::JIT::Emit::code_memory()->{machine_code} - $code_before;
+
+printf "%d modules, %d subs, %d compiled in %.3fs (%.1f subs/s)\n\n",
+  scalar @loaded, scalar @subs, $compiled, $elapsed, $elapsed ? @subs / $elapsed : 0;
+printf "  %-16s %10s %8s %6s\n", qw(phase seconds count %);
+for my $phase (sort { $phases->{$b}{seconds} <=> $phases->{$a}{seconds} } keys %$phases) {
+  printf "  %-16s %10.4f %8d %5.1f%%\n", $phase, $phases->{$phase}{seconds},
+    $phases->{$phase}{count}, $elapsed ? 100 * $phases->{$phase}{seconds} / $elapsed : 0;
+}
+printf "\npeak RSS %.1f MB (%.1f MB before compiling), machine code %d bytes\n",
+  $rss_after / 2**20, $rss_before / 2**20, $code_size;
+
+if ($json_file) {
+  my $report = {
+    perl         => sprintf('%vd', $^V),
+    perl_jit     => $Perl::JIT::VERSION,
+    timestamp    => time,
+    modules      => \@loaded,
+    subs         => scalar @subs,
+    compiled     => $compiled,
+    seconds      => $elapsed,
+    phases       => $phases,
+    peak_rss     => $rss_after,
+    initial_rss  => $rss_before,
+    code_size    => $code_size,
+  };
+
+  open my $fh, '>', $json_file or die "Can't write $json_file: $!";
+  print $fh JSON::PP->new->pretty->canonical->encode($report);
+  close $fh;
+}
@@ -0,0 +1,30 @@
+# binary-trees: allocation of many small array-based trees
+{
+  name => 'binary_trees',
+  args => [12],
+  code => q{
+    sub {
+      my ($depth) = @_;
+      my $make;
+      my $check;
+      $make = sub {
+        my ($d) = @_;
+        return $d ? [$make->($d - 1), $make->($d - 1)] : [];
+      };
+      $check = sub {
+        my ($tree) = @_;
+        return @$tree ? 1 + $check->($tree->[0]) + $check->($tree->[1]) : 1;
+      };
+
+      typed Int $total = 0;
+      for (typed Int $d = 4; $d <= $depth; $d += 2) {
+        typed Int $iterations = 2 ** ($depth - $d + 4);
+        for (typed Int $i = 0; $i < $iterations; ++$i) {
+          $total += $check->($make->($d));
+        }
+      }
+
+      return $total;
+    }
+  },
+};
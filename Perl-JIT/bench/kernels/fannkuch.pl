@@ -0,0 +1,49 @@
+# fannkuch-redux: integer array permutations
+{
+  name => 'fannkuch',
+  args => [8],
+  code => q{
+    sub {
+      my ($n) = @_;
+      my @perm1 = (0 .. $n - 1);
+      my @count = (0) x $n;
+      typed Int $max_flips = 0;
+      typed Int $checksum = 0;
+      typed Int $permutations = 0;
+      typed Int $r = $n;
+
+      while (1) {
+        while ($r != 1) {
+          $count[$r - 1] = $r;
+          --$r;
+        }
+
+        my @perm = @perm1;
+        typed Int $flips = 0;
+        typed Int $k = $perm[0];
+        while ($k != 0) {
+          @perm[0 .. $k] = reverse @perm[0 .. $k];
+          ++$flips;
+          $k = $perm[0];
+        }
+        $max_flips = $flips if $flips > $max_flips;
+        $checksum += $permutations % 2 ? -$flips : $flips;
+
+        while (1) {
+          return $checksum * 1000 + $max_flips if $r == $n;
+
+          typed Int $first = $perm1[0];
+          for (typed Int $i = 0; $i < $r; ++$i) {
+            $perm1[$i] = $perm1[$i + 1];
+          }
+          $perm1[$r] = $first;
+
+          --$count[$r];
+          last if $count[$r] > 0;
+          ++$r;
+        }
+        ++$permutations;
+      }
+    }
+  },
+};
@@ -0,0 +1,28 @@
+# fasta: pseudo-random numbers and string output
+{
+  name => 'fasta',
+  args => [200_000],
+  code => q{
+    sub {
+      my ($n) = @_;
+      my @symbols = split //, 'acgtBDHKMNRSVWY';
+      my @probabilities = (0.27, 0.12, 0.12, 0.27, (0.02) x 11);
+      typed Int $seed = 42;
+      typed String $out = '';
+
+      for (typed Int $i = 0; $i < $n; ++$i) {
+        $seed = ($seed * 3877 + 29573) % 139968;
+        typed Double $r = $seed / 139968.0;
+        typed Int $j = 0;
+        while ($j < $#probabilities && $r >= $probabilities[$j]) {
+          $r -= $probabilities[$j];
+          ++$j;
+        }
+        $out .= $symbols[$j];
+        $out .= "\n" if $i % 60 == 59;
+      }
+
+      return length($out) . ':' . substr($out, 0, 60);
+    }
+  },
+};
@@ -0,0 +1,25 @@
+# hash counting: word frequencies
+{
+  name => 'hash_counting',
+  args => [200_000],
+  code => q{
+    sub {
+      my ($n) = @_;
+      my %count;
+      typed Int $seed = 7;
+
+      for (typed Int $i = 0; $i < $n; ++$i) {
+        $seed = ($seed * 1103515245 + 12345) % 2147483648;
+        typed String $word = 'w' . ($seed % 997);
+        ++$count{$word};
+      }
+
+      typed Int $max = 0;
+      for my $word (keys %count) {
+        $max = $count{$word} if $count{$word} > $max;
+      }
+
+      return scalar(keys %count) . ':' . $max;
+    }
+  },
+};
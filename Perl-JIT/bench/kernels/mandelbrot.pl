@@ -0,0 +1,31 @@
+# mandelbrot: tight floating point loop with an early exit
+{
+  name => 'mandelbrot',
+  args => [250],
+  code => q{
+    sub {
+      my ($size) = @_;
+      typed Int $inside = 0;
+
+      for (typed Int $py = 0; $py < $size; ++$py) {
+        for (typed Int $px = 0; $px < $size; ++$px) {
+          typed Double $cr = 2.0 * $px / $size - 1.5;
+          typed Double $ci = 2.0 * $py / $size - 1.0;
+          typed Double $zr = 0.0;
+          typed Double $zi = 0.0;
+          typed Int $iteration = 0;
+
+          while ($iteration < 50 && $zr * $zr + $zi * $zi <= 4.0) {
+            typed Double $t = $zr * $zr - $zi * $zi + $cr;
+            $zi = 2.0 * $zr * $zi + $ci;
+            $zr = $t;
+            ++$iteration;
+          }
+          ++$inside if $iteration == 50;
+        }
+      }
+
+      return $inside;
+    }
+  },
+};
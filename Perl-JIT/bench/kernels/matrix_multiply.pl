@@ -0,0 +1,30 @@
+# matrix multiply: triple loop over arrays of arrays
+{
+  name => 'matrix_multiply',
+  args => [80],
+  code => q{
+    sub {
+      my ($n) = @_;
+      my (@a, @b, @c);
+
+      for (typed Int $i = 0; $i < $n; ++$i) {
+        for (typed Int $j = 0; $j < $n; ++$j) {
+          $a[$i][$j] = ($i - $j) / $n;
+          $b[$i][$j] = ($i + $j) / $n;
+        }
+      }
+
+      for (typed Int $i = 0; $i < $n; ++$i) {
+        for (typed Int $j = 0; $j < $n; ++$j) {
+          typed Double $sum = 0.0;
+          for (typed Int $k = 0; $k < $n; ++$k) {
+            $sum += $a[$i][$k] * $b[$k][$j];
+          }
+          $c[$i][$j] = $sum;
+        }
+      }
+
+      return $c[$n / 2][$n / 2];
+    }
+  },
+};
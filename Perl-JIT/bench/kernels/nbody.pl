@@ -0,0 +1,50 @@
+# n-body: floating point arithmetic on arrays of bodies
+{
+  name => 'nbody',
+  args => [20_000],
+  code => q{
+    sub {
+      my ($steps) = @_;
+      my @x = (0, 4.84, 8.34, 12.89, 15.37);
+      my @y = (0, -1.16, 4.12, -15.11, -25.91);
+      my @z = (0, -0.10, -0.40, -0.22, 0.17);
+      my @vx = (0, 0.606, -1.010, 1.082, 0.979);
+      my @vy = (0, 2.811, 1.825, 0.868, 0.594);
+      my @vz = (0, -0.025, 0.008, -0.010, -0.034);
+      my @mass = (39.47, 0.037, 0.011, 0.0017, 0.0020);
+      typed Int $n = @x;
+      typed Double $dt = 0.01;
+
+      for (typed Int $step = 0; $step < $steps; ++$step) {
+        for (typed Int $i = 0; $i < $n; ++$i) {
+          for (typed Int $j = $i + 1; $j < $n; ++$j) {
+            typed Double $dx = $x[$i] - $x[$j];
+            typed Double $dy = $y[$i] - $y[$j];
+            typed Double $dz = $z[$i] - $z[$j];
+            typed Double $d2 = $dx * $dx + $dy * $dy + $dz * $dz;
+            typed Double $mag = $dt / ($d2 * sqrt($d2));
+
+            $vx[$i] -= $dx * $mass[$j] * $mag;
+            $vy[$i] -= $dy * $mass[$j] * $mag;
+            $vz[$i] -= $dz * $mass[$j] * $mag;
+            $vx[$j] += $dx * $mass[$i] * $mag;
+            $vy[$j] += $dy * $mass[$i] * $mag;
+            $vz[$j] += $dz * $mass[$i] * $mag;
+          }
+        }
+        for (typed Int $i = 0; $i < $n; ++$i) {
+          $x[$i] += $dt * $vx[$i];
+          $y[$i] += $dt * $vy[$i];
+          $z[$i] += $dt * $vz[$i];
+        }
+      }
+
+      typed Double $e = 0.0;
+      for (typed Int $i = 0; $i < $n; ++$i) {
+        $e += 0.5 * $mass[$i] * ($vx[$i] ** 2 + $vy[$i] ** 2 + $vz[$i] ** 2);
+      }
+
+      return $e;
+    }
+  },
+};
@@ -0,0 +1,37 @@
+# sort-heavy report: records sorted on several keys and summarized
+{
+  name => 'sort_report',
+  args => [50_000],
+  code => q{
+    sub {
+      my ($n) = @_;
+      my @records;
+      typed Int $seed = 11;
+
+      for (typed Int $i = 0; $i < $n; ++$i) {
+        $seed = ($seed * 69069 + 1) % 4294967296;
+        push @records, {
+          region => 'r' . ($seed % 17),
+          amount => ($seed % 10_000) / 100,
+          id     => $i,
+        };
+      }
+
+      my @sorted = sort {
+        $a->{region} cmp $b->{region} ||
+        $b->{amount} <=> $a->{amount} ||
+        $a->{id} <=> $b->{id}
+      } @records;
+
+      typed Double $total = 0.0;
+      my %by_region;
+      for my $record (@sorted) {
+        $total += $record->{amount};
+        $by_region{$record->{region}} += $record->{amount};
+      }
+
+      return join ',', $sorted[0]{id}, $sorted[-1]{id}, sprintf('%.2f', $total),
+                       scalar(keys %by_region);
+    }
+  },
+};
@@ -0,0 +1,36 @@
+# spectral-norm: nested loops calling a small arithmetic helper
+{
+  name => 'spectral_norm',
+  args => [150],
+  code => q{
+    sub {
+      my ($n) = @_;
+      my @u = (1) x $n;
+      my @v = (0) x $n;
+
+      for (typed Int $iteration = 0; $iteration < 10; ++$iteration) {
+        for my $pass (0, 1) {
+          my ($from, $to) = $pass ? (\@v, \@u) : (\@u, \@v);
+
+          for (typed Int $i = 0; $i < $n; ++$i) {
+            typed Double $sum = 0.0;
+            for (typed Int $j = 0; $j < $n; ++$j) {
+              typed Double $a = 1.0 / (($i + $j) * ($i + $j + 1) / 2 + $i + 1);
+              $sum += $a * $from->[$j];
+            }
+            $to->[$i] = $sum;
+          }
+        }
+      }
+
+      typed Double $vbv = 0.0;
+      typed Double $vv = 0.0;
+      for (typed Int $i = 0; $i < $n; ++$i) {
+        $vbv += $u[$i] * $v[$i];
+        $vv += $v[$i] * $v[$i];
+      }
+
+      return sqrt($vbv / $vv);
+    }
+  },
+};
@@ -0,0 +1,20 @@
+# string building: concatenation, sprintf and substr
+{
+  name => 'string_building',
+  args => [200_000],
+  code => q{
+    sub {
+      my ($n) = @_;
+      typed String $s = '';
+      typed Int $digits = 0;
+
+      for (typed Int $i = 0; $i < $n; ++$i) {
+        typed String $item = sprintf('%05d', $i);
+        $digits += substr($item, -1);
+        $s .= $item . ',';
+      }
+
+      return length($s) + $digits;
+    }
+  },
+};
@@ -0,0 +1,152 @@
+use 5.14.0;
+use warnings;
+use blib;
+use Perl::JIT;
+use Perl::JIT::Emit;
+use Getopt::Long qw(GetOptions);
+use File::Basename qw(dirname);
+use File::Spec;
+use JSON::PP;
+use Time::HiRes qw(time);
+
+# Runs the benchmark kernels in bench/kernels, both interpreted and
+# JITted, and writes the results as JSON:
+#
+#   perl bench/run.pl --json results.json
+#   perl bench/run.pl --baseline bench/baseline.json --threshold 10
+#
+# Each kernel is written once, with typed declarations; the interpreted
+# variant is the same code with the declarations turned into my.
+#
+# With --baseline, JIT times (and compile times) are compared against a
+# previous result file, and the exit status is 1 if any kernel got
+# slower than the threshold (in percent).
+
+my ($json_file, $baseline_file, @only);
+my $threshold = 5;
+my $runs = 5;
+GetOptions(
+  'json=s' => \$json_file,
+  'baseline=s' => \$baseline_file,
+  'threshold=f' => \$threshold,
+  'runs=i' => \$runs,
+  'kernel=s' => \@only,
+);
+
+my $kernel_dir = File::Spec->rel2abs(File::Spec->catdir(dirname(__FILE__), 'kernels'));
+my @kernels = map { do $_ or die "Failed to load $_: ", $@ || $! }
+              sort glob("$kernel_dir/*.pl");
+if (@only) {
+  my %only = map { $_ => 1 } @only;
+  @kernels = grep $only{$_->{name}}, @kernels;
+}
+
+sub interpreted_code {
+  my ($code) = @_;
+
+  $code =~ s/\btyped\s+\w+\s+(?=\$)/my /g;
+  return $code;
+}
+
+# best of several runs, to filter out noise
+sub best_time {
+  my ($sub, $args) = @_;
+  my $best;
+
+  for (1 .. $runs) {
+    my $start = time;
+    $sub->(@$args);
+    my $elapsed = time - $start;
+    $best = $elapsed if !defined $best || $elapsed < $best;
+  }
+
+  return $best;
+}
+
+sub same_result {
+  my ($x, $y) = @_;
+
+  return abs($x - $y) <= 1e-9 * (abs($x) + 1)
+    if $x =~ /^-?[\d.]+(?:e[-+]?\d+)?$/i && $y =~ /^-?[\d.]+(?:e[-+]?\d+)?$/i;
+  return $x eq $y;
+}
+
+my %results;
+for my $kernel (@kernels) {
+  my $name = $kernel->{name};
+  my @args = @{$kernel->{args}};
+  my $perl_sub = eval "no strict; " . interpreted_code($kernel->{code})
+    or die "Failed to compile $name (interpreted): $@";
+  my $jit_sub = eval "use Perl::JIT; no strict; $kernel->{code}"
+    or die "Failed to compile $name (typed): $@";
+
+  my $code_size = Perl::JIT::Emit::code_memory()->{machine_code};
+  my $compile_start = time;
+  Perl::JIT::Emit::jit_sub($jit_sub);
+  Perl::JIT::Emit::wait_for_compilation();
+  my $compile_time = time - $compile_start;
+  $code_size = Perl::JIT::Emit::code_memory()->{machine_code} - $code_size;
+
+  my $expected = $perl_sub->(@args);
+  my $got = $jit_sub->(@args);
+  die "Wrong result for $name: expected $expected, got $got\n"
+    unless same_result($expected, $got);
+
+  my $perl_time = best_time($perl_sub, \@args);
+  my $jit_time = best_time($jit_sub, \@args);
+
+  $results{$name} = {
+    interpreted  => $perl_time,
+    jit          => $jit_time,
+    compile_time => $compile_time,
+    speedup      => $jit_time ? $perl_time / $jit_time : undef,
+    code_size    => $code_size,
+  };
+  printf "%-18s perl %8.4fs  jit %8.4fs  speedup %5.2fx  compile %7.4fs  code %7d bytes\n",
+    $name, $perl_time, $jit_time, $results{$name}{speedup} // 0, $compile_time, $code_size;
+}
+
+my $report = {
+  perl      => sprintf('%vd', $^V),
+  perl_jit  => $Perl::JIT::VERSION,
+  timestamp => time,
+  runs      => $runs,
+  kernels   => \%results,
+};
+
+if ($json_file) {
+  open my $fh, '>', $json_file or die "Can't write $json_file: $!";
+  print $fh JSON::PP->new->pretty->canonical->encode($report);
+  close $fh;
+}
+
+exit 0 unless $baseline_file;
+
+my $baseline = do {
+  open my $fh, '<', $baseline_file or die "Can't read $baseline_file: $!";
+  local $/;
+  decode_json(<$fh>);
+};
+
+my $regressions = 0;
+print "\nCompared to $baseline_file (threshold $threshold%):\n";
+for my $name (sort keys %results) {
+  my $old = $baseline->{kernels}{$name};
+  unless ($old) {
+    printf "%-18s not in the baseline\n", $name;
+    next;
+  }
+
+  my @changes;
+  for my $metric (qw(jit compile_time)) {
+    next unless $old->{$metric};
+    my $change = 100 * ($results{$name}{$metric} - $old->{$metric}) / $old->{$metric};
+    my $regressed = $change > $threshold;
+
+    $regressions += $regressed;
+    push @changes, sprintf('%s %+6.1f%%%s', $metric, $change, $regressed ? ' REGRESSION' : '');
+  }
+  printf "%-18s %s\n", $name, join '  ', @changes;
+}
+
+exit($regressions ? 1 : 0);
@@ -23,7 +23,10 @@ my $llc = $ENV{LLVM_LLC} || 'llc';
 
 {
     local $0 = "perl"; # allows testing with one-liners
-    $ccopts = $Config{optimize} . ' ' . ExtUtils::Embed::ccopts();
+    # snippets are always optimized, regardless of how perl was built:
+    # the static inline helpers from the perl headers must be folded
+    # into the snippet body, since only the snippet body is extracted
+    $ccopts = $Config{optimize} . ' -O2 ' . ExtUtils::Embed::ccopts();
     ($ccopts_no_dashg = $ccopts) =~ s/(^|\s)-g\S*(\s|$)/$1$2/g;
 }
 
@@ -67,6 +67,23 @@ sub ACTION_code {
     $self->SUPER::ACTION_code(@_);
 }
 
+# ./Build bench [--json results.json] [--baseline old.json] [--threshold 5]
+#               [--runs 5] [--kernel nbody]
+sub ACTION_bench {
+    my ($self) = shift;
+    my @args;
+
+    $self->depends_on('code');
+    for my $option (qw(json baseline threshold runs kernel)) {
+        my $value = $self->args($option);
+        next unless defined $value;
+        push @args, map { ("--$option", $_) } ref $value ? @$value : $value;
+    }
+
+    $self->do_system($^X, 'bench/run.pl', @args)
+        or die "Benchmark failed or regressed\n";
+}
+
 sub ACTION_perlapi {
     my ($self) = shift;
     my $source = do {
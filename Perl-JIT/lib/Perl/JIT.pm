@@ -12,13 +12,46 @@ our @ISA = qw(Exporter); # Oh, the pain.
 our @EXPORT_OK; # filled-in by XS code
 our %EXPORT_TAGS = ( 'all' => \@EXPORT_OK );
 
+# defaults for "use Perl::JIT 'tiered'"
+our $TIER_CALLS = 1000;
+our $TIER_HOT_CALLS = 100_000;
+
 sub import {
+  my ($class, @args) = @_;
+  my @export;
+
   $^H{PJ_KEYWORD_PLUGIN_HINT()} = 1;
-  __PACKAGE__->export_to_level(1, @_);
+
+  while (@args) {
+    my $arg = shift @args;
+
+    if ($arg eq 'tiered') {
+      my %opts = ref($args[0]) eq 'HASH' ? %{shift @args} : ();
+
+      require Perl::JIT::Emit;
+      $^H{PJ_TIER_CALLS_HINT()} = $opts{calls} // $TIER_CALLS;
+      $^H{PJ_TIER_HOT_CALLS_HINT()} = $opts{hot_calls} // $TIER_HOT_CALLS;
+    } else {
+      push @export, $arg;
+    }
+  }
+
+  __PACKAGE__->export_to_level(1, $class, @export);
+}
+
+sub stats {
+  require Perl::JIT::Emit;
+
+  return [
+    sort { ($a->{file} // '') cmp ($b->{file} // '') ||
+           ($a->{line} // 0) <=> ($b->{line} // 0) }
+         @{Perl::JIT::Emit::_region_stats()}
+  ];
 }
 
 sub unimport {
   $^H{PJ_KEYWORD_PLUGIN_HINT()} = 0;
+  $^H{PJ_TIER_CALLS_HINT()} = 0;
 }
 
 1;
@@ -36,6 +69,129 @@ Perl::JIT - Perl extension for blah blah blah
 
 =head1 DESCRIPTION
 
+=head2 Tiered compilation
+
+  use Perl::JIT 'tiered';
+  use Perl::JIT tiered => { calls => 100, hot_calls => 10_000 };
+
+Subs compiled in the lexical scope of a C<tiered> import start out
+interpreted and are compiled by L<Perl::JIT::Emit/jit_sub> once they
+have been called C<calls> times (loop iterations count as calls). The
+JITted regions are recompiled at the highest optimization level after
+C<hot_calls> further executions.
+
+Defaults come from C<$Perl::JIT::TIER_CALLS> and
+C<$Perl::JIT::TIER_HOT_CALLS>.
+
+=head2 Code cache
+
+When C<$Perl::JIT::Emit::CACHE_DIR> is set (it defaults to the
+C<PERL_JIT_CACHE_DIR> environment variable), optimized code for each
+JITted region is saved to that directory, and later processes compiling
+the same code reuse it instead of running the optimizer. Entries are
+keyed by the code structure, the perl build, the LLVM version and the
+host CPU.
+
+Cached entries are executed, so the directory (created with mode 0700
+if it doesn't exist) and the entries in it are ignored unless they are
+owned by the current user and not writable by anyone else; the cache
+can't be shared between users.
+
+=head2 Code budget
+
+C<$Perl::JIT::Emit::CODE_BUDGET> (default: the C<PERL_JIT_CODE_BUDGET>
+environment variable) limits the memory used by JITted code, counting
+machine code and (estimated) IR. Regions compiled while a budget is set
+record when they were last used, and when the limit is exceeded the
+least recently used ones are evicted: only their bitcode is kept, and
+they are recompiled on their next execution.
+L<Perl::JIT::Emit/code_memory> returns the current usage.
+
+=head2 Lazy compilation
+
+With C<$Perl::JIT::Emit::LAZY> (default: the C<PERL_JIT_LAZY>
+environment variable) set, or the C<lazy> option of
+L<Perl::JIT::Emit/jit_sub>, the op tree is patched right away but the
+IR of each region is only optimized and compiled to machine code the
+first time the region runs, so code that is never executed costs no
+code generation time.
+
+=head2 Profiling
+
+With C<$Perl::JIT::Emit::PROFILE> (default: the C<PERL_JIT_PROFILE>
+environment variable) or the C<profile> option of
+L<Perl::JIT::Emit/jit_sub> set to 1, JITted regions count their
+executions; with 2 they also accumulate the CPU cycles (as read by the
+processor's cycle counter) spent running them. C<Perl::JIT::stats()>
+returns an array of hashes, sorted by file and line, with one entry per
+instrumented region:
+
+  {
+    sub       => \&code,     # the sub containing the region
+    name      => 'main::foo',
+    file      => 'foo.pl',
+    line      => 12,         # first statement of the region
+    calls     => 1000,
+    cycles    => 123456,     # only with profile => 2
+    opt_level => 2,
+  }
+
+Cycles are inclusive of the interpreted subtrees the region calls, and
+not counted when the region is left by an exception.
+
+=head2 Profiling with perf
+
+JITted regions are named after their sub and the position of their
+first statement, e.g. C<main::foo [foo.pl:12] #0>. Setting
+C<$Perl::JIT::Emit::PERF> (default: the C<PERL_JIT_PERF> environment
+variable) or the C<perf> option of L<Perl::JIT::Emit/jit_sub> makes
+these names visible to Linux C<perf>:
+
+=over 4
+
+=item map
+
+appends the address range of each function to F</tmp/perf-PID.map>,
+which C<perf report> reads automatically;
+
+=item jitdump
+
+writes F</tmp/jit-PID.dump>, including the generated code, for use
+with C<perf record -k mono> followed by C<perf inject --jit>.
+
+=back
+
+Both can be enabled with C<map,jitdump>. Once enabled, an output stays
+on for the rest of the process.
+
+With C<jitdump>, the code is also annotated with the source line of
+each statement (this can be controlled separately with the
+C<debug_info> option of L<Perl::JIT::Emit/jit_sub>), and the dump
+includes line tables, so C<perf annotate> and C<perf report
+--sort srcline> can attribute samples to Perl source lines.
+
+=head2 Coverage
+
+Every term left to the interpreter, and every failed compilation, is
+counted by reason (C<unknown_op>, C<opaque_operand>,
+C<caller_context>, ...) and Perl op type. C<Perl::JIT::Emit::bailouts>
+returns the counts for the process as C<< { reason => { op => count } } >>,
+and C<Perl::JIT::Emit::reset_bailouts> clears them.
+F<author_tools/jit_coverage.pl> compiles all the subs of a module tree
+and reports the most common reasons.
+
+=head2 Compile time
+
+The time spent in each phase of the compiler (C<find_candidates>,
+C<build_ast>, C<infer_types>, C<emit>, C<optimize>, C<codegen> and
+C<cache>) is accumulated for the process, including the compile thread.
+C<Perl::JIT::Emit::phase_times> returns it as
+C<< { phase => { seconds => ..., count => ... } } >>, with nested
+phases excluded from the enclosing one, C<Perl::JIT::Emit::reset_phase_times>
+clears it and C<Perl::JIT::Emit::peak_rss> returns the peak resident
+set size in bytes. F<bench/compile_latency.pl> reports both for a
+corpus of modules.
+
 =head1 SEE ALSO
 
 =head1 AUTHOR
@@ -5,14 +5,56 @@ use Exporter qw(import);
 
 use Perl::JIT qw(:all);
 use B::Replace;
+use File::Path qw(make_path);
 
-our @EXPORT_OK = qw(jit_sub concise_dump);
+our @EXPORT_OK = qw(jit_sub wait_for_compilation code_memory
+                    bailouts reset_bailouts phase_times reset_phase_times
+                    peak_rss concise_dump);
 our %EXPORT_TAGS = ( all => \@EXPORT_OK );
 
+# 0 only promotes stack slots to registers, 1 adds cheap cleanups,
+# 2 is the general-purpose pipeline, 3 adds loop optimizations and
+# vectorization for long-running kernels
+our $DEFAULT_OPT_LEVEL = 2;
+
+# directory for the on-disk code cache, undef disables caching
+our $CACHE_DIR = $ENV{PERL_JIT_CACHE_DIR};
+
+# maximum bytes of machine code and IR, 0 for no limit
+our $CODE_BUDGET = $ENV{PERL_JIT_CODE_BUDGET};
+
+# generate code for each region on its first execution
+our $LAZY = $ENV{PERL_JIT_LAZY};
+
+# instrument regions for Perl::JIT::stats: 1 counts executions, 2 also
+# measures CPU cycles
+our $PROFILE = $ENV{PERL_JIT_PROFILE};
+
+# symbol files for Linux perf: "map", "jitdump" or "map,jitdump"
+our $PERF = $ENV{PERL_JIT_PERF};
+
 sub jit_sub {
-    my ($sub) = @_;
+    my ($sub, %opts) = @_;
+
+    my %defaults = (opt_level => $DEFAULT_OPT_LEVEL);
+    if (defined $CACHE_DIR && length $CACHE_DIR) {
+        make_path($CACHE_DIR, { mode => 0700 }) unless -d $CACHE_DIR;
+        $defaults{cache_dir} = $CACHE_DIR;
+    }
+    $defaults{code_budget} = $CODE_BUDGET if defined $CODE_BUDGET;
+    $defaults{lazy} = 1 if $LAZY;
+    $defaults{profile} = $PROFILE if $PROFILE;
+    $defaults{perf} = $PERF if $PERF;
+    # with async => 1 code is generated in the background, and the op
+    # tree is only patched on the first call after it is ready, so
+    # there are no edits to apply here
+    my $ops = _jit_sub($sub, { %defaults, %opts });
+
+    _apply_ops($ops);
+}
 
-    my $ops = _jit_sub($sub);
+sub _apply_ops {
+    my ($ops) = @_;
 
     # TODO add C API for B::Replace and remove this horror
     for my $op (@$ops) {
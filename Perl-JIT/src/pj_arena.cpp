@@ -0,0 +1,172 @@
+#include "pj_arena.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include <map>
+#include <new>
+
+using namespace PerlJIT::AST;
+using namespace std;
+
+// chunks grow geometrically up to this size
+#define MAX_CHUNK_SIZE (64 * 1024)
+// enough for any AST node member
+#define ALIGNMENT      (2 * sizeof(void *))
+
+namespace {
+  // chunk start => (chunk size, arena), for Arena::owner(); only used
+  // when wrapping objects for Perl, but arenas are created by all
+  // interpreters
+  typedef map<const char *, pair<size_t, Arena *> > chunk_map_t;
+
+  pthread_mutex_t chunks_mutex = PTHREAD_MUTEX_INITIALIZER;
+  chunk_map_t *all_chunks = NULL;
+}
+
+Arena::Arena(size_t first_chunk_size) :
+  next(NULL), end(NULL),
+  next_chunk_size(first_chunk_size), allocated_bytes(0),
+  refcount(1)
+{
+}
+
+Arena::~Arena()
+{
+  for (size_t i = destructors.size(); i > 0; --i)
+    destructors[i - 1].second(destructors[i - 1].first);
+
+  pthread_mutex_lock(&chunks_mutex);
+  for (size_t i = 0, max = chunks.size(); i < max; ++i)
+    all_chunks->erase(chunks[i].first);
+  pthread_mutex_unlock(&chunks_mutex);
+
+  for (size_t i = 0, max = chunks.size(); i < max; ++i)
+    free(chunks[i].first);
+}
+
+char *
+Arena::add_chunk(size_t size)
+{
+  char *chunk = (char *) malloc(size);
+
+  if (!chunk)
+    throw bad_alloc();
+  chunks.push_back(make_pair(chunk, size));
+
+  pthread_mutex_lock(&chunks_mutex);
+  if (!all_chunks)
+    all_chunks = new chunk_map_t;
+  (*all_chunks)[chunk] = make_pair(size, this);
+  pthread_mutex_unlock(&chunks_mutex);
+
+  return chunk;
+}
+
+void *
+Arena::allocate(size_t size, void (*destroy)(void *))
+{
+  void *object;
+
+  size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+  if (size > next_chunk_size) {
+    // oversized objects get a chunk of their own, without changing
+    // the current one
+    object = add_chunk(size);
+  } else {
+    if (size > (size_t) (end - next)) {
+      next = add_chunk(next_chunk_size);
+      end = next + next_chunk_size;
+      if (next_chunk_size < MAX_CHUNK_SIZE)
+        next_chunk_size *= 2;
+    }
+    object = next;
+    next += size;
+  }
+
+  allocated_bytes += size;
+  if (destroy)
+    destructors.push_back(make_pair(object, destroy));
+
+  return object;
+}
+
+void
+Arena::forget(void *object)
+{
+  // the memory itself is just wasted
+  if (!destructors.empty() && destructors.back().first == object)
+    destructors.pop_back();
+}
+
+void
+Arena::retain()
+{
+  ++refcount;
+}
+
+void
+Arena::release()
+{
+  if (--refcount == 0)
+    delete this;
+}
+
+Arena *
+Arena::owner(const void *object)
+{
+  Arena *arena = NULL;
+
+  pthread_mutex_lock(&chunks_mutex);
+  if (all_chunks) {
+    chunk_map_t::iterator it = all_chunks->upper_bound((const char *) object);
+
+    if (it != all_chunks->begin()) {
+      --it;
+      if ((const char *) object < it->first + it->second.first)
+        arena = it->second.second;
+    }
+  }
+  pthread_mutex_unlock(&chunks_mutex);
+
+  return arena;
+}
+
+
+STATIC int
+pj_arena_mg_free(pTHX_ SV *sv, MAGIC *mg)
+{
+  PERL_UNUSED_ARG(sv);
+  ((Arena *) mg->mg_ptr)->release();
+  mg->mg_ptr = NULL;
+  return 0;
+}
+
+// the magic holds one reference to the arena
+STATIC MGVTBL PJ_arena_mg_vtbl = {
+  0, 0, 0, 0, pj_arena_mg_free, 0, 0, 0
+};
+
+Arena *
+pj_new_mortal_arena(pTHX)
+{
+  Arena *arena = new Arena();
+  SV *owner = sv_newmortal();
+
+  sv_magicext(owner, NULL, PERL_MAGIC_ext, &PJ_arena_mg_vtbl, (char *) arena, 0);
+
+  return arena;
+}
+
+void
+pj_wrap_arena_object(pTHX_ SV *rv, const char *klass, void *object)
+{
+  sv_setref_pv(rv, klass, object);
+  if (!object)
+    return;
+
+  if (Arena *arena = Arena::owner(object)) {
+    arena->retain();
+    sv_magicext(SvRV(rv), NULL, PERL_MAGIC_ext, &PJ_arena_mg_vtbl, (char *) arena, 0);
+  }
+}
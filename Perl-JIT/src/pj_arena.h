@@ -0,0 +1,65 @@
+#ifndef PJ_ARENA_H_
+#define PJ_ARENA_H_
+
+/* Memory for AST terms */
+
+#include <EXTERN.h>
+#include <perl.h>
+
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+namespace PerlJIT {
+  namespace AST {
+    // Owns the AST terms of a compilation: they are allocated with
+    // new (arena) Term(...), never deleted one by one, and released
+    // all together with the arena.
+    //
+    // Arenas are reference counted, so Perl objects wrapping a node
+    // can keep it alive; the creator holds the first reference.
+    class Arena {
+    public:
+      Arena(size_t first_chunk_size = 4096);
+
+      // destroy, if not NULL, is called on the object when the arena
+      // is released, in reverse allocation order
+      void *allocate(size_t size, void (*destroy)(void *));
+      // undoes allocate() when the constructor of the object throws
+      void forget(void *object);
+
+      void retain();
+      void release();
+
+      // bytes handed out by allocate()
+      size_t allocated() const { return allocated_bytes; }
+
+      // arena owning the object, NULL for objects not allocated in an
+      // arena
+      static Arena *owner(const void *object);
+
+    private:
+      ~Arena();
+      Arena(const Arena &);
+      Arena &operator=(const Arena &);
+
+      char *add_chunk(size_t size);
+
+      std::vector<std::pair<char *, size_t> > chunks;
+      std::vector<std::pair<void *, void (*)(void *)> > destructors;
+      char *next, *end;
+      size_t next_chunk_size, allocated_bytes;
+      int refcount;
+    };
+  }
+}
+
+// New arena released at the next FREETMPS, like a mortal SV (also
+// when unwinding after a croak)
+PerlJIT::AST::Arena *pj_new_mortal_arena(pTHX);
+
+// Sets rv to a reference to a Perl object for an AST term; if the
+// object lives in an arena, the Perl object keeps it alive
+void pj_wrap_arena_object(pTHX_ SV *rv, const char *klass, void *object);
+
+#endif // PJ_ARENA_H_
@@ -14,12 +14,53 @@ using namespace PerlJIT::AST;
 // human-readable names and their flags.
 #include "pj_ast_ops_data-gen.inc"
 
-const std::vector<Term *> Term::empty;
-
 Term::Term(OP *p_op, pj_term_type t, Type *v_type)
   : type(t), perl_op(p_op), _value_type(v_type)
 {}
 
+void *
+Term::operator new(size_t size, Arena &arena)
+{
+  return arena.allocate(size, &Term::destroy);
+}
+
+void
+Term::operator delete(void *term, Arena &arena)
+{
+  arena.forget(term);
+}
+
+void
+Term::destroy(void *term)
+{
+  static_cast<Term *>(term)->~Term();
+}
+
+Term *
+Term::get_kid(size_t i) const
+{
+  abort(); // no kids, shouldn't happen!
+}
+
+void
+Term::set_kid(size_t i, Term *kid)
+{
+  abort(); // no kids, shouldn't happen!
+}
+
+std::vector<Term *>
+Term::get_kids() const
+{
+  std::vector<Term *> kids;
+  size_t count = get_kid_count();
+
+  kids.reserve(count);
+  for (size_t i = 0; i < count; ++i)
+    kids.push_back(get_kid(i));
+
+  return kids;
+}
+
 Empty::Empty()
   : Term(NULL, pj_ttype_empty)
 {}
@@ -37,13 +78,12 @@ List::List(const std::vector<Term *> &kid_terms)
   for (unsigned int i = 0; i < n; ++i) {
     if (kid_terms[i]->get_type() == pj_ttype_list) {
       List *l = (List *)kid_terms[i];
-      // transfer ownership if sub-elements
+      // the nested list stays unused in the arena
       std::vector<Term *> &nested_kids = l->kids;
       for (unsigned int j = 0; j < nested_kids.size(); ++j) {
         kids.push_back(nested_kids[j]);
       }
       nested_kids.clear();
-      delete l;
     }
     else
       kids.push_back(kid_terms[i]);
@@ -55,27 +95,27 @@ Constant::Constant(OP *p_op, Type *v_type)
 {}
 
 NumericConstant::NumericConstant(OP *p_op, NV c)
-  : Constant(p_op, new Scalar(pj_double_type)),
+  : Constant(p_op, Scalar::get(pj_double_type)),
     dbl_value(c)
 {}
 
 NumericConstant::NumericConstant(OP *p_op, IV c)
-  : Constant(p_op, new Scalar(pj_int_type)),
+  : Constant(p_op, Scalar::get(pj_int_type)),
     int_value(c)
 {}
 
 NumericConstant::NumericConstant(OP *p_op, UV c)
-  : Constant(p_op, new Scalar(pj_uint_type)),
+  : Constant(p_op, Scalar::get(pj_uint_type)),
     uint_value(c)
 {}
 
 StringConstant::StringConstant(OP *p_op, const std::string& s, bool isUTF8)
-  : Constant(p_op, new Scalar(pj_string_type)),
+  : Constant(p_op, Scalar::get(pj_string_type)),
     string_value(s), is_utf8(isUTF8)
 {}
 
 StringConstant::StringConstant(pTHX_ OP *p_op, SV *string_literal_sv)
-  : Constant(p_op, new Scalar(pj_string_type))
+  : Constant(p_op, Scalar::get(pj_string_type))
 {
   STRLEN l;
   char *s;
@@ -85,12 +125,12 @@ StringConstant::StringConstant(pTHX_ OP *p_op, SV *string_literal_sv)
 }
 
 UndefConstant::UndefConstant()
-  : Constant(NULL, new Scalar(pj_unspecified_type))
+  : Constant(NULL, Scalar::get(pj_unspecified_type))
 {
 }
 
 ArrayConstant::ArrayConstant(OP *p_op, AV *array)
-  : Constant(p_op, new Array(new Scalar(pj_unspecified_type))),
+  : Constant(p_op, Array::get(Scalar::get(pj_unspecified_type))),
     const_array(array)
 {}
 
@@ -102,7 +142,7 @@ Identifier::Identifier(OP *p_op, pj_term_type t, pj_variable_sigil s, Type *v_ty
 
 VariableDeclaration::VariableDeclaration(OP *p_op, int ivariable, pj_variable_sigil sigil, Type *v_type)
   : Identifier(p_op, pj_ttype_variabledeclaration, sigil, v_type),
-    ivar(ivariable)
+    ivar(ivariable), local_uses(0)
 {}
 
 
@@ -379,9 +419,9 @@ NumericConstant::dump(int indent_lvl) const
   if (this->_value_type->tag() == pj_double_type)
     printf("C = (NV)%f\n", (float)this->dbl_value);
   else if (this->_value_type->tag() == pj_int_type)
-    printf("C = (IV)%i\n", (int)this->int_value);
+    printf("C = (IV)%" IVdf "\n", this->int_value);
   else if (this->_value_type->tag() == pj_uint_type)
-    printf("C = (UV)%lu\n", (unsigned long)this->uint_value);
+    printf("C = (UV)%" UVuf "\n", this->uint_value);
   else
     abort();
 }
@@ -706,7 +746,7 @@ void LoopControlStatement::dump(int indent_lvl) const
 
   if (label_is_dynamic()) {
     printf("%s%s(\n", name.c_str(), target_unresolved);
-    get_kids()[0]->dump(indent_lvl+1);
+    kids[0]->dump(indent_lvl+1);
     S_dump_tree_indent(indent_lvl);
     printf(")\n");
   }
@@ -768,23 +808,6 @@ Sort::dump(int indent_lvl) const
 
 Term::~Term()
 {
-  delete _value_type;
-}
-
-Op::~Op()
-{
-  std::vector<PerlJIT::AST::Term *> &k = kids;
-  const unsigned int n = k.size();
-  for (unsigned int i = 0; i < n; ++i)
-    delete k[i];
-}
-
-List::~List()
-{
-  std::vector<PerlJIT::AST::Term *> &k = kids;
-  const unsigned int n = k.size();
-  for (unsigned int i = 0; i < n; ++i)
-    delete k[i];
 }
 
 pj_term_type Term::get_type() const
@@ -827,7 +850,6 @@ OP *Term::last_op()
 
 void Term::set_value_type(Type *t)
 {
-  delete _value_type;
   _value_type = t;
 }
 
@@ -845,6 +867,9 @@ Op::name() const
 unsigned int Op::flags() const
 { return pj_ast_op_flags[op_type]; }
 
+pj_op_return_type Op::return_type() const
+{ return pj_ast_op_return_types[op_type]; }
+
 pj_op_type Op::get_op_type() const
 { return op_type; }
 
@@ -902,27 +927,51 @@ GV *Global::get_gv() const
 }
 #endif
 
-std::vector<PerlJIT::AST::Term *> BareBlock::get_kids() const
+size_t BareBlock::get_kid_count() const
 {
-  std::vector<PerlJIT::AST::Term *> kids;
+  return continuation->get_type() != pj_ttype_empty ? 2 : 1;
+}
 
-  kids.push_back(body);
-  if (continuation->get_type() != pj_ttype_empty)
-    kids.push_back(continuation);
+Term *BareBlock::get_kid(size_t i) const
+{
+  return i == 0 ? body : continuation;
+}
 
-  return kids;
+void BareBlock::set_kid(size_t i, Term *kid)
+{
+  (i == 0 ? body : continuation) = kid;
 }
 
-std::vector<PerlJIT::AST::Term *> While::get_kids() const
+size_t While::get_kid_count() const
 {
-  std::vector<PerlJIT::AST::Term *> kids;
+  return continuation->get_type() != pj_ttype_empty ? 3 : 2;
+}
 
-  kids.push_back(condition);
-  kids.push_back(body);
-  if (continuation->get_type() != pj_ttype_empty)
-    kids.push_back(continuation);
+Term *While::get_kid(size_t i) const
+{
+  switch (i) {
+  case 0:
+    return condition;
+  case 1:
+    return body;
+  default:
+    return continuation;
+  }
+}
 
-  return kids;
+void While::set_kid(size_t i, Term *kid)
+{
+  switch (i) {
+  case 0:
+    condition = kid;
+    break;
+  case 1:
+    body = kid;
+    break;
+  default:
+    continuation = kid;
+    break;
+  }
 }
 
 OP *For::last_op()
@@ -939,36 +988,96 @@ OP *For::last_op()
   return leave;
 }
 
-std::vector<PerlJIT::AST::Term *> For::get_kids() const
+size_t For::get_kid_count() const
 {
-  std::vector<PerlJIT::AST::Term *> kids;
+  return 4;
+}
 
-  kids.push_back(init);
-  kids.push_back(condition);
-  kids.push_back(step);
-  kids.push_back(body);
+Term *For::get_kid(size_t i) const
+{
+  switch (i) {
+  case 0:
+    return init;
+  case 1:
+    return condition;
+  case 2:
+    return step;
+  default:
+    return body;
+  }
+}
 
-  return kids;
+void For::set_kid(size_t i, Term *kid)
+{
+  switch (i) {
+  case 0:
+    init = kid;
+    break;
+  case 1:
+    condition = kid;
+    break;
+  case 2:
+    step = kid;
+    break;
+  default:
+    body = kid;
+    break;
+  }
 }
 
-std::vector<PerlJIT::AST::Term *> Foreach::get_kids() const
+size_t Foreach::get_kid_count() const
 {
-  std::vector<PerlJIT::AST::Term *> kids;
+  return 4;
+}
 
-  kids.push_back(iterator);
-  kids.push_back(expression);
-  kids.push_back(body);
-  kids.push_back(continuation);
+Term *Foreach::get_kid(size_t i) const
+{
+  switch (i) {
+  case 0:
+    return iterator;
+  case 1:
+    return expression;
+  case 2:
+    return body;
+  default:
+    return continuation;
+  }
+}
 
-  return kids;
+void Foreach::set_kid(size_t i, Term *kid)
+{
+  switch (i) {
+  case 0:
+    iterator = kid;
+    break;
+  case 1:
+    expression = kid;
+    break;
+  case 2:
+    body = kid;
+    break;
+  default:
+    continuation = kid;
+    break;
+  }
 }
 
-std::vector<PerlJIT::AST::Term *> ListTransformation::get_kids()
+size_t ListTransformation::get_kid_count() const
 {
-  std::vector<PerlJIT::AST::Term *> kids;
+  return 2;
+}
 
-  kids.push_back(body);
-  kids.push_back(parameters);
+Term *ListTransformation::get_kid(size_t i) const
+{
+  return i == 0 ? body : parameters;
+}
 
-  return kids;
+void ListTransformation::set_kid(size_t i, Term *kid)
+{
+  if (i == 0) {
+    body = kid;
+  } else {
+    assert(kid->get_type() == pj_ttype_list);
+    parameters = static_cast<List *>(kid);
+  }
 }
@@ -2,6 +2,7 @@
 #define PJ_TERMS_H_
 
 #include "pj_types.h"
+#include "pj_arena.h"
 
 #include <vector>
 #include <string>
@@ -74,12 +75,31 @@ typedef enum {
 // Indicates that the op may have overloading
 #define PJ_ASTf_OVERLOAD (1<<3)
 
+// Type of the value an op returns in scalar context (from the return
+// types in author_tools/opcodes)
+typedef enum {
+  pj_ret_any,              // anything else (Any, Scalar, lists, ...)
+  pj_ret_boolean,          // PL_sv_yes/PL_sv_no
+  pj_ret_numeric,          // covering type of the numeric operands
+  pj_ret_integer,
+  pj_ret_unsigned_integer,
+  pj_ret_double,
+  pj_ret_string
+} pj_op_return_type;
+
 namespace PerlJIT {
   namespace AST {
+    // Terms are allocated with new (arena) and are released with the
+    // arena, so they do not own their kids (and types are interned);
+    // constructors must not croak before all members are initialized,
+    // since the arena runs their destructor regardless
     class Term {
     public:
       Term(OP *p_op, pj_term_type t, Type *v_type = 0);
 
+      void *operator new(size_t size, Arena &arena);
+      void operator delete(void *term, Arena &arena);
+
       OP *start_op();
       virtual OP *first_op();
       virtual OP *last_op();
@@ -95,7 +115,14 @@ namespace PerlJIT {
       virtual Type *get_value_type() const;
       virtual void set_value_type(Type *t);
 
-      virtual std::vector<Term *> get_kids() const { return empty; }
+      // Kids are accessed by index, without copying them; get_kid()
+      // may return NULL for a missing optional kid, and set_kid()
+      // replaces a kid (see pj_ast_visitor.h for traversals)
+      virtual size_t get_kid_count() const { return 0; }
+      virtual Term *get_kid(size_t i) const;
+      virtual void set_kid(size_t i, Term *kid);
+      // copy of the kids, for the Perl bindings
+      std::vector<Term *> get_kids() const;
 
       virtual void dump(int indent_lvl = 0) const = 0;
       virtual const char *perl_class() const
@@ -107,7 +134,12 @@ namespace PerlJIT {
       OP *perl_op;
       Type *_value_type;
 
-      static const std::vector<Term *> empty;
+      // only released with the arena
+      void operator delete(void *) {}
+
+    private:
+      // called by the arena
+      static void destroy(void *term);
     };
 
     class Empty : public Term {
@@ -127,13 +159,15 @@ namespace PerlJIT {
       List();
       List(const std::vector<Term *> &kid_terms);
 
-      std::vector<Term *> get_kids() const { return kids; }
       std::vector<PerlJIT::AST::Term *> kids;
 
+      virtual size_t get_kid_count() const { return kids.size(); }
+      virtual Term *get_kid(size_t i) const { return kids[i]; }
+      virtual void set_kid(size_t i, Term *kid) { kids[i] = kid; }
+
       virtual void dump(int indent_lvl = 0) const;
       virtual const char *perl_class() const
         { return "Perl::JIT::AST::List"; }
-      virtual ~List();
     };
 
     class Constant : public Term {
@@ -153,8 +187,8 @@ namespace PerlJIT {
 
       union {
         double dbl_value;
-        int int_value;
-        unsigned int uint_value;
+        IV int_value;
+        UV uint_value;
       };
 
       virtual void dump(int indent_lvl = 0) const;
@@ -211,6 +245,10 @@ namespace PerlJIT {
       VariableDeclaration(OP *p_op, int ivariable, pj_variable_sigil s, Type *v_type = 0);
 
       int ivar;
+      // number of terms referring to the variable when all of them are
+      // in the ASTs and nothing else can see it (no reference taken, no
+      // closure, no string eval); 0 when the variable might escape
+      int local_uses;
 
       int get_pad_index() const { return perl_op->op_targ; }
 
@@ -259,9 +297,12 @@ namespace PerlJIT {
 
       virtual const char *name() const;
       unsigned int flags() const;
+      pj_op_return_type return_type() const;
       virtual pj_op_class op_class() const = 0;
 
-      std::vector<Term *> get_kids() const { return kids; }
+      virtual size_t get_kid_count() const { return kids.size(); }
+      virtual Term *get_kid(size_t i) const { return kids[i]; }
+      virtual void set_kid(size_t i, Term *kid) { kids[i] = kid; }
 
       bool evaluates_kids_conditionally() const
         { return flags() & PJ_ASTf_KIDS_CONDITIONAL; }
@@ -283,7 +324,6 @@ namespace PerlJIT {
       virtual void dump(int indent_lvl = 0) const = 0;
       virtual const char *perl_class() const
         { return "Perl::JIT::AST::Op"; }
-      virtual ~Op();
 
     protected:
       pj_op_type op_type;
@@ -361,7 +401,9 @@ namespace PerlJIT {
       Term *get_body() const;
       Term *get_continuation() const;
 
-      std::vector<PerlJIT::AST::Term *> get_kids() const;
+      virtual size_t get_kid_count() const;
+      virtual Term *get_kid(size_t i) const;
+      virtual void set_kid(size_t i, Term *kid);
 
       virtual void dump(int indent_lvl = 0) const;
       virtual const char *perl_class() const
@@ -381,7 +423,9 @@ namespace PerlJIT {
       Term *body;
       Term *continuation;
 
-      std::vector<PerlJIT::AST::Term *> get_kids() const;
+      virtual size_t get_kid_count() const;
+      virtual Term *get_kid(size_t i) const;
+      virtual void set_kid(size_t i, Term *kid);
 
       virtual void dump(int indent_lvl = 0) const;
       virtual const char *perl_class() const
@@ -399,7 +443,9 @@ namespace PerlJIT {
 
       virtual OP *last_op();
 
-      std::vector<PerlJIT::AST::Term *> get_kids() const;
+      virtual size_t get_kid_count() const;
+      virtual Term *get_kid(size_t i) const;
+      virtual void set_kid(size_t i, Term *kid);
 
       virtual void dump(int indent_lvl = 0) const;
       virtual const char *perl_class() const
@@ -415,7 +461,9 @@ namespace PerlJIT {
       Term *body;
       Term *continuation;
 
-      std::vector<PerlJIT::AST::Term *> get_kids() const;
+      virtual size_t get_kid_count() const;
+      virtual Term *get_kid(size_t i) const;
+      virtual void set_kid(size_t i, Term *kid);
 
       virtual void dump(int indent_lvl = 0) const;
       virtual const char *perl_class() const
@@ -428,7 +476,9 @@ namespace PerlJIT {
       Term *body;
       List *parameters;
 
-      std::vector<PerlJIT::AST::Term *> get_kids();
+      virtual size_t get_kid_count() const;
+      virtual Term *get_kid(size_t i) const;
+      virtual void set_kid(size_t i, Term *kid);
 
       virtual void dump(int indent_lvl = 0) const;
       virtual const char *perl_class() const
@@ -497,7 +547,9 @@ namespace PerlJIT {
       LoopControlStatement(pTHX_ OP *p_op, AST::Term *kid);
 
       pj_loop_ctl_type get_loop_ctl_type() const { return ctl_type; }
-      std::vector<Term *> get_kids() const { return kids; }
+      virtual size_t get_kid_count() const { return kids.size(); }
+      virtual Term *get_kid(size_t i) const { return kids[i]; }
+      virtual void set_kid(size_t i, Term *kid) { kids[i] = kid; }
 
       bool has_label() const { return _has_label; }
       bool label_is_dynamic() const { return _label_is_dynamic; }
@@ -596,7 +648,9 @@ namespace PerlJIT {
 
       std::vector<PerlJIT::AST::Term *> kids;
 
-      std::vector<Term *> get_kids() const { return kids; }
+      virtual size_t get_kid_count() const { return kids.size(); }
+      virtual Term *get_kid(size_t i) const { return kids[i]; }
+      virtual void set_kid(size_t i, Term *kid) { kids[i] = kid; }
 
       virtual void dump(int indent_lvl = 0) const;
       virtual const char *perl_class() const
@@ -614,7 +668,9 @@ namespace PerlJIT {
 
       std::vector<PerlJIT::AST::Term *> kids;
 
-      std::vector<Term *> get_kids() const { return kids; }
+      virtual size_t get_kid_count() const { return kids.size(); }
+      virtual Term *get_kid(size_t i) const { return kids[i]; }
+      virtual void set_kid(size_t i, Term *kid) { kids[i] = kid; }
 
       virtual void dump(int indent_lvl = 0) const;
       virtual const char *perl_class() const
@@ -0,0 +1,102 @@
+#include "pj_ast_visitor.h"
+
+#include <stdlib.h>
+
+using namespace PerlJIT;
+using namespace PerlJIT::AST;
+
+ASTVisitor::ASTVisitor() :
+  base(0)
+{
+}
+
+ASTVisitor::~ASTVisitor()
+{
+}
+
+bool
+ASTVisitor::visit(Term *term)
+{
+  size_t outer_base = base;
+  bool completed;
+
+  base = stack.size();
+  completed = walk(term);
+  stack.resize(base);
+  base = outer_base;
+
+  return completed;
+}
+
+bool
+ASTVisitor::visit(const std::vector<Term *> &terms)
+{
+  for (size_t i = 0, max = terms.size(); i < max; ++i)
+    if (!visit(terms[i]))
+      return false;
+
+  return true;
+}
+
+bool
+ASTVisitor::visit_kids(Term *term)
+{
+  for (size_t i = 0, max = term->get_kid_count(); i < max; ++i) {
+    Term *kid = term->get_kid(i);
+
+    if (kid && !visit(kid))
+      return false;
+  }
+
+  return true;
+}
+
+bool
+ASTVisitor::walk(Term *term)
+{
+  visit_control_t status = visit_term_pre(term);
+
+  if (status == VISIT_ABORT)
+    return false;
+
+  Frame root = { term, 0, status == VISIT_SKIP ? 0 : term->get_kid_count() };
+  stack.push_back(root);
+
+  // callbacks might start a nested walk, which can reallocate the
+  // stack: frame references are not used across callbacks
+  while (stack.size() > base) {
+    Frame &frame = stack.back();
+
+    if (frame.next_kid < frame.kid_count) {
+      Term *kid = frame.term->get_kid(frame.next_kid++);
+
+      if (!kid)
+        continue;
+      status = visit_term_pre(kid);
+      if (status == VISIT_ABORT)
+        return false;
+
+      Frame next = { kid, 0, status == VISIT_SKIP ? 0 : kid->get_kid_count() };
+      stack.push_back(next);
+    } else {
+      status = visit_term_post(frame.term);
+      stack.pop_back();
+      if (status == VISIT_ABORT)
+        return false;
+    }
+  }
+
+  return true;
+}
+
+void
+ASTVisitor::replace_term(Term *replacement)
+{
+  if (stack.size() - base < 2)
+    abort(); // replacing a root, shouldn't happen!
+
+  Frame &parent = stack[stack.size() - 2];
+
+  parent.term->set_kid(parent.next_kid - 1, replacement);
+  stack.back().term = replacement;
+}
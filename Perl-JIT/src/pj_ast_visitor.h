@@ -0,0 +1,61 @@
+#ifndef PJ_AST_VISITOR_H_
+#define PJ_AST_VISITOR_H_
+
+#include "pj_ast_terms.h"
+
+#include <vector>
+
+/* Code relating to traversing and rewriting the AST */
+
+namespace PerlJIT {
+  class ASTVisitor {
+  public:
+    enum visit_control_t {
+      VISIT_CONT = 0,
+      VISIT_SKIP = 1,
+      VISIT_ABORT = 2
+    };
+
+    ASTVisitor();
+    virtual ~ASTVisitor();
+
+    // Walks the AST depth-first, left to right, invoking visit_term_pre
+    // before a term's kids and visit_term_post after them (missing
+    // optional kids are not visited). visit_term_pre may return
+    // VISIT_SKIP to avoid visiting the term's kids (visit_term_post is
+    // still called) and either callback may return VISIT_ABORT to stop
+    // walking altogether, in which case visit() returns false.
+    //
+    // The walk uses an explicit stack that is reused across calls, so
+    // it does not allocate per term; callbacks may call visit() on the
+    // same visitor for a nested walk.
+    bool visit(PerlJIT::AST::Term *term);
+    bool visit(const std::vector<PerlJIT::AST::Term *> &terms);
+    // visits the kids of term, but not term itself
+    bool visit_kids(PerlJIT::AST::Term *term);
+
+  protected:
+    // To be implemented in subclass
+    virtual visit_control_t visit_term_pre(PerlJIT::AST::Term *term) = 0;
+    virtual visit_control_t visit_term_post(PerlJIT::AST::Term *term)
+      { return VISIT_CONT; }
+
+    // Only valid in visit_term_post: replaces the term being visited
+    // in its parent (the roots of the walk can't be replaced)
+    void replace_term(PerlJIT::AST::Term *replacement);
+
+  private:
+    struct Frame {
+      PerlJIT::AST::Term *term;
+      size_t next_kid, kid_count;
+    };
+
+    bool walk(PerlJIT::AST::Term *term);
+
+    std::vector<Frame> stack;
+    // stack depth at the start of the innermost visit() call
+    size_t base;
+  };
+}
+
+#endif
@@ -0,0 +1,86 @@
+#include "pj_clone.h"
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Support/InstIterator.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+using namespace llvm;
+
+static void map_constant(Module *dest, Constant *value, ValueToValueMapTy &vmap);
+
+static GlobalValue *
+copy_global(Module *dest, GlobalValue *global, ValueToValueMapTy &vmap)
+{
+  if (Function *function = dyn_cast<Function>(global)) {
+    if (Function *existing = dest->getFunction(function->getName()))
+      return existing;
+
+    Function *copy = Function::Create(function->getFunctionType(),
+                                      GlobalValue::ExternalLinkage,
+                                      function->getName(), dest);
+
+    copy->setAttributes(function->getAttributes());
+    return copy;
+  }
+
+  GlobalVariable *variable = cast<GlobalVariable>(global);
+
+  if (!variable->hasLocalLinkage())
+    if (GlobalVariable *existing = dest->getGlobalVariable(variable->getName()))
+      return existing;
+
+  GlobalVariable *copy = new GlobalVariable(
+    *dest, variable->getType()->getElementType(), variable->isConstant(),
+    variable->getLinkage(), NULL, variable->getName(), NULL,
+    variable->getThreadLocalMode());
+
+  copy->setAlignment(variable->getAlignment());
+  copy->setUnnamedAddr(variable->hasUnnamedAddr());
+  vmap[variable] = copy;
+
+  if (variable->hasInitializer()) {
+    map_constant(dest, variable->getInitializer(), vmap);
+    copy->setInitializer(cast<Constant>(MapValue(variable->getInitializer(), vmap)));
+  }
+
+  return copy;
+}
+
+static void
+map_constant(Module *dest, Constant *value, ValueToValueMapTy &vmap)
+{
+  if (GlobalValue *global = dyn_cast<GlobalValue>(value)) {
+    if (!vmap.count(global))
+      vmap[global] = copy_global(dest, global, vmap);
+    return;
+  }
+
+  for (User::op_iterator it = value->op_begin(), end = value->op_end(); it != end; ++it)
+    map_constant(dest, cast<Constant>(*it), vmap);
+}
+
+Function *
+PerlJIT::pj_clone_function_into(Function *function, Module *dest,
+                                const std::string &name,
+                                ValueToValueMapTy &vmap)
+{
+  for (inst_iterator it = inst_begin(function), end = inst_end(function); it != end; ++it)
+    for (User::op_iterator op = it->op_begin(), op_end = it->op_end(); op != op_end; ++op)
+      if (Constant *value = dyn_cast<Constant>(*op))
+        map_constant(dest, value, vmap);
+
+  Function *copy = Function::Create(function->getFunctionType(),
+                                    GlobalValue::ExternalLinkage,
+                                    name, dest);
+  Function::arg_iterator copy_arg = copy->arg_begin();
+  SmallVector<ReturnInst *, 4> returns;
+
+  for (Function::arg_iterator arg = function->arg_begin(), end = function->arg_end(); arg != end; ++arg, ++copy_arg)
+    vmap[arg] = copy_arg;
+  copy->setAttributes(function->getAttributes());
+  CloneFunctionInto(copy, function, vmap, true, returns);
+
+  return copy;
+}
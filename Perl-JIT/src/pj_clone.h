@@ -0,0 +1,21 @@
+#ifndef PJ_CLONE_H_
+#define PJ_CLONE_H_
+
+#include <llvm/IR/Module.h>
+#include <llvm/Transforms/Utils/ValueMapper.h>
+
+#include <string>
+
+namespace PerlJIT {
+  // Copies a function to another module, declaring the functions and
+  // external variables it references there (or reusing existing
+  // declarations with the same name), and making private copies of
+  // the internal variables it uses; vmap receives the mapping from the
+  // original values to the copies
+  llvm::Function *pj_clone_function_into(llvm::Function *function,
+                                         llvm::Module *dest,
+                                         const std::string &name,
+                                         llvm::ValueToValueMapTy &vmap);
+}
+
+#endif // PJ_CLONE_H_
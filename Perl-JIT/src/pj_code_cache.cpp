@@ -0,0 +1,384 @@
+#include "pj_code_cache.h"
+#include "pj_keyword_plugin.h"
+#include "pj_clone.h"
+
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Bitcode/ReaderWriter.h>
+#include <llvm/DebugInfo.h>
+#include <llvm/Linker.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <sstream>
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace PerlJIT;
+using namespace PerlJIT::AST;
+using namespace llvm;
+using namespace std;
+
+#define CACHE_MAGIC "PJCACHE1\n"
+#define REGION_NAME "pj_region"
+
+static unsigned int loaded_regions = 0;
+
+static string
+slot_name(size_t index)
+{
+  ostringstream name;
+
+  name << "pj_slot." << index;
+  return name.str();
+}
+
+// 64-bit FNV-1a, only used to pick a file name: the full key is stored
+// in the file and compared on load
+static string
+key_hash(const string &key)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  char buffer[17];
+
+  for (size_t i = 0, max = key.size(); i < max; ++i) {
+    hash ^= (unsigned char) key[i];
+    hash *= 1099511628211ULL;
+  }
+  snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long) hash);
+
+  return buffer;
+}
+
+static string
+environment_key()
+{
+  ostringstream key;
+  StringMap<bool> features;
+  vector<string> enabled;
+
+  key << "perl " << PERL_REVISION << "." << PERL_VERSION << "." << PERL_SUBVERSION
+      << " " << ARCHNAME
+      << " Perl::JIT " << XS_VERSION
+      << " llvm " << LLVM_VERSION_MAJOR << "." << LLVM_VERSION_MINOR
+      << " cpu " << sys::getHostCPUName().str();
+
+  if (sys::getHostCPUFeatures(features))
+    for (StringMap<bool>::iterator it = features.begin(), end = features.end(); it != end; ++it)
+      if (it->getValue())
+        enabled.push_back(it->getKey().str());
+  sort(enabled.begin(), enabled.end());
+  for (size_t i = 0, max = enabled.size(); i < max; ++i)
+    key << " +" << enabled[i];
+
+  return key.str();
+}
+
+static void
+append_term(pTHX_ ostringstream &key, Term *term)
+{
+  OP *op = term->get_perl_op();
+
+  key << "(" << term->get_type();
+  if (term->get_value_type())
+    key << ":" << term->get_value_type()->to_string();
+  if (op)
+    key << " op=" << op->op_type << "/" << (int) op->op_flags
+        << "/" << (int) op->op_private << "/" << op->op_targ;
+
+  switch (term->get_type()) {
+  case pj_ttype_constant:
+    if (NumericConstant *c = dynamic_cast<NumericConstant *>(term)) {
+      char buffer[64];
+
+      // %a is exact for doubles, and harmless for the integer members
+      snprintf(buffer, sizeof(buffer), " %a/%" IVdf "/%" UVuf, c->dbl_value, c->int_value, c->uint_value);
+      key << buffer;
+    } else if (StringConstant *c = dynamic_cast<StringConstant *>(term)) {
+      key << " " << c->string_value.size() << ":" << c->string_value << "/" << c->is_utf8;
+    }
+    break;
+  case pj_ttype_variabledeclaration: {
+    VariableDeclaration *decl = static_cast<VariableDeclaration *>(term);
+
+    // region-local variables are not stored in the pad
+    key << " ivar=" << decl->ivar << "/" << decl->local_uses;
+  }
+    break;
+  case pj_ttype_lexical: {
+    Lexical *lexical = static_cast<Lexical *>(term);
+
+    key << " pad=" << lexical->get_pad_index();
+    if (lexical->declaration)
+      key << "/" << lexical->declaration->local_uses;
+  }
+    break;
+  case pj_ttype_global: {
+#ifdef USE_ITHREADS
+    key << " pad=" << static_cast<Global *>(term)->get_pad_index();
+#else
+    GV *gv = static_cast<Global *>(term)->get_gv();
+    const char *stash = GvSTASH(gv) ? HvNAME(GvSTASH(gv)) : NULL;
+
+    key << " gv=" << (stash ? stash : "") << "::" << GvNAME(gv);
+#endif
+  }
+    break;
+  case pj_ttype_op: {
+    Op *o = static_cast<Op *>(term);
+
+    key << " " << o->get_op_type() << "/" << o->is_integer_variant();
+    if (o->op_class() == pj_opc_binop)
+      key << "/" << static_cast<Binop *>(o)->is_assignment_form();
+  }
+    break;
+  case pj_ttype_while: {
+    While *w = static_cast<While *>(term);
+
+    key << " " << w->negated << "/" << w->evaluate_after;
+  }
+    break;
+  default:
+    break;
+  }
+
+  for (size_t i = 0, max = term->get_kid_count(); i < max; ++i) {
+    Term *kid = term->get_kid(i);
+
+    if (kid)
+      append_term(aTHX_ key, kid);
+    else
+      key << "()";
+  }
+
+  key << ")";
+}
+
+// Cached code is linked in and executed, so only files and directories
+// nobody but the current user can write to are trusted
+static bool
+is_private(const struct stat &st)
+{
+  return st.st_uid == geteuid() && !(st.st_mode & (S_IWGRP | S_IWOTH));
+}
+
+static bool
+is_private_directory(const string &path)
+{
+  struct stat st;
+
+  return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode) && is_private(st);
+}
+
+static bool
+read_file(const string &path, string &contents)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat st;
+  char buffer[8192];
+  size_t count;
+
+  if (fd < 0)
+    return false;
+  // checked on the open file, so it can't be swapped in between
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || !is_private(st)) {
+    close(fd);
+    return false;
+  }
+
+  FILE *file = fdopen(fd, "rb");
+  if (!file) {
+    close(fd);
+    return false;
+  }
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    contents.append(buffer, count);
+
+  bool ok = !ferror(file);
+  fclose(file);
+
+  return ok;
+}
+
+// Writes to a temporary file first, so concurrent processes never see
+// a partially written entry
+static void
+write_file(const string &path, const string &contents)
+{
+  ostringstream temp_path;
+
+  temp_path << path << "." << getpid() << ".tmp";
+
+  int fd = open(temp_path.str().c_str(), O_WRONLY | O_CREAT | O_EXCL, 0600);
+  if (fd < 0)
+    return;
+
+  FILE *file = fdopen(fd, "wb");
+  if (!file) {
+    close(fd);
+    unlink(temp_path.str().c_str());
+    return;
+  }
+
+  bool ok = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+  ok = fclose(file) == 0 && ok;
+
+  if (!ok || rename(temp_path.str().c_str(), path.c_str()) != 0)
+    unlink(temp_path.str().c_str());
+}
+
+CodeCache::CodeCache(const string &_directory) :
+  directory(_directory)
+{
+}
+
+string
+CodeCache::region_key(pTHX_ CV *cv, const vector<Term *> &asts, const string &settings)
+{
+  ostringstream key;
+  pj_declaration_map_t *declarations = pj_get_typed_variable_declarations(aTHX_ cv);
+
+  key << environment_key() << "\n" << settings << "\n";
+
+  if (declarations) {
+    vector<string> typed;
+
+    for (pj_declaration_map_t::iterator it = declarations->begin(), end = declarations->end(); it != end; ++it) {
+      ostringstream declaration;
+
+      declaration << it->first << ":" << it->second.get_type()->to_string();
+      typed.push_back(declaration.str());
+    }
+    sort(typed.begin(), typed.end());
+    for (size_t i = 0, max = typed.size(); i < max; ++i)
+      key << typed[i] << " ";
+    key << "\n";
+  }
+
+  for (size_t i = 0, max = asts.size(); i < max; ++i)
+    append_term(aTHX_ key, asts[i]);
+
+  return key.str();
+}
+
+string
+CodeCache::path_for(const string &key) const
+{
+  return directory + "/" + key_hash(key) + ".pjc";
+}
+
+Function *
+CodeCache::load(const string &key, Module *module, vector<GlobalVariable *> &slots)
+{
+  string contents;
+
+  if (!is_private_directory(directory) || !read_file(path_for(key), contents))
+    return NULL;
+
+  size_t magic_length = sizeof(CACHE_MAGIC) - 1;
+  if (contents.compare(0, magic_length, CACHE_MAGIC) != 0)
+    return NULL;
+
+  size_t newline = contents.find('\n', magic_length);
+  if (newline == string::npos)
+    return NULL;
+
+  // guards against hash collisions
+  size_t key_length = strtoul(contents.c_str() + magic_length, NULL, 10);
+  size_t key_start = newline + 1;
+  if (contents.size() < key_start + key_length ||
+      contents.compare(key_start, key_length, key) != 0)
+    return NULL;
+
+  return from_bitcode(contents.substr(key_start + key_length), module, slots);
+}
+
+void
+CodeCache::store(const string &key, Function *function, const vector<GlobalVariable *> &slots)
+{
+  ostringstream header;
+
+  if (!is_private_directory(directory))
+    return;
+
+  header << CACHE_MAGIC << key.size() << "\n" << key;
+
+  write_file(path_for(key), header.str() + to_bitcode(function, slots));
+}
+
+string
+CodeCache::to_bitcode(Function *function, const vector<GlobalVariable *> &slots)
+{
+  Module *module = function->getParent();
+  Module copy("pj_code_cache", module->getContext());
+  ValueToValueMapTy vmap;
+
+  copy.setDataLayout(module->getDataLayout());
+  copy.setTargetTriple(module->getTargetTriple());
+#if LLVM_VERSION_MAJOR > 3 || LLVM_VERSION_MINOR >= 4
+  // otherwise the reader drops the source line info
+  copy.addModuleFlag(Module::Warning, "Debug Info Version", DEBUG_METADATA_VERSION);
+#endif
+
+  pj_clone_function_into(function, &copy, REGION_NAME, vmap);
+  for (size_t i = 0, max = slots.size(); i < max; ++i)
+    cast<GlobalVariable>(vmap[slots[i]])->setName(slot_name(i));
+
+  string bitcode;
+  raw_string_ostream out(bitcode);
+
+  WriteBitcodeToFile(&copy, out);
+  out.flush();
+
+  return bitcode;
+}
+
+Function *
+CodeCache::from_bitcode(const string &bitcode, Module *module, vector<GlobalVariable *> &slots)
+{
+  string error;
+  MemoryBuffer *buffer = MemoryBuffer::getMemBufferCopy(bitcode, "pj_code_cache");
+  Module *copy = ParseBitcodeFile(buffer, module->getContext(), &error);
+
+  delete buffer;
+  if (!copy)
+    return NULL;
+
+  Function *function = copy->getFunction(REGION_NAME);
+  if (!function) {
+    delete copy;
+    return NULL;
+  }
+
+  // unique names make the function and its slots easy to find after
+  // linking
+  ostringstream prefix;
+  vector<string> slot_names;
+
+  prefix << "pj_cached_" << ++loaded_regions;
+  function->setName(prefix.str());
+  for (size_t i = 0; ; ++i) {
+    GlobalVariable *slot = copy->getGlobalVariable(slot_name(i), true);
+
+    if (!slot)
+      break;
+    slot_names.push_back(prefix.str() + "_" + slot_name(i));
+    slot->setName(slot_names.back());
+  }
+
+  bool failed = Linker::LinkModules(module, copy, Linker::DestroySource, &error);
+
+  delete copy;
+  if (failed)
+    return NULL;
+
+  slots.clear();
+  for (size_t i = 0, max = slot_names.size(); i < max; ++i)
+    slots.push_back(module->getGlobalVariable(slot_names[i], true));
+
+  return module->getFunction(prefix.str());
+}
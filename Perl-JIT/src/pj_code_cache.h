@@ -0,0 +1,63 @@
+#ifndef PJ_CODE_CACHE_H_
+#define PJ_CODE_CACHE_H_
+
+#include "pj_ast_terms.h"
+
+#include <EXTERN.h>
+#include <perl.h>
+
+#undef Copy
+
+#include <llvm/IR/Module.h>
+#include <llvm/IR/GlobalVariable.h>
+
+#include <string>
+#include <vector>
+
+namespace PerlJIT {
+  // On-disk cache of optimized code for JITted regions.
+  //
+  // Entries are keyed by everything the generated code depends on: the
+  // structure of the AST (including constants, pad indices and types),
+  // the typed declarations of the sub, the emitter settings, the perl
+  // build, the LLVM version and the host CPU. The cached code never
+  // embeds addresses: the ops it runs are loaded from per-region op
+  // slots, which are filled in after loading.
+  //
+  // "Slots" are private variables of the function that the caller
+  // needs to find again after loading (op slots, use tracking).
+  //
+  // The cache directory and its entries are only used when they are
+  // owned by the current user and nobody else can write to them.
+  class CodeCache {
+  public:
+    CodeCache(const std::string &directory);
+
+    static std::string region_key(pTHX_ CV *cv,
+                                  const std::vector<PerlJIT::AST::Term *> &asts,
+                                  const std::string &settings);
+
+    // Links the cached function into module and returns it, or NULL
+    // on a cache miss; slots receives the copies of the slots passed
+    // to store(), in the same order
+    llvm::Function *load(const std::string &key, llvm::Module *module,
+                         std::vector<llvm::GlobalVariable *> &slots);
+    // Writes an optimized function to the cache; errors are ignored,
+    // since the cache is only an optimization
+    void store(const std::string &key, llvm::Function *function,
+               const std::vector<llvm::GlobalVariable *> &slots);
+
+    // In-memory versions of store()/load(), without the key
+    static std::string to_bitcode(llvm::Function *function,
+                                  const std::vector<llvm::GlobalVariable *> &slots);
+    static llvm::Function *from_bitcode(const std::string &bitcode, llvm::Module *module,
+                                        std::vector<llvm::GlobalVariable *> &slots);
+
+  private:
+    std::string path_for(const std::string &key) const;
+
+    std::string directory;
+  };
+}
+
+#endif // PJ_CODE_CACHE_H_
@@ -0,0 +1,165 @@
+#include "pj_compile_queue.h"
+#include "pj_phase_timer.h"
+
+#include <algorithm>
+
+using namespace PerlJIT;
+using namespace llvm;
+using namespace std;
+using namespace std::tr1;
+
+CompileQueue::CompileQueue(JITLayer *_jit) :
+  jit(_jit), started(false), stopping(false), current(NULL)
+{
+  pthread_mutex_init(&queue_mutex, NULL);
+  pthread_mutex_init(&llvm_mutex, NULL);
+  pthread_cond_init(&queue_changed, NULL);
+}
+
+CompileQueue::~CompileQueue()
+{
+  if (started) {
+    pthread_mutex_lock(&queue_mutex);
+    stopping = true;
+    pthread_cond_broadcast(&queue_changed);
+    pthread_mutex_unlock(&queue_mutex);
+
+    pthread_join(worker, NULL);
+  }
+
+  pthread_cond_destroy(&queue_changed);
+  pthread_mutex_destroy(&llvm_mutex);
+  pthread_mutex_destroy(&queue_mutex);
+}
+
+void
+CompileQueue::enqueue(const shared_ptr<CompileJob> &job)
+{
+  pthread_mutex_lock(&queue_mutex);
+  // the worker is only started on first use
+  if (!started)
+    started = pthread_create(&worker, NULL, run_worker, this) == 0;
+  jobs.push_back(job);
+  pthread_cond_broadcast(&queue_changed);
+  pthread_mutex_unlock(&queue_mutex);
+
+  // no thread, no background compilation
+  if (!started) {
+    pthread_mutex_lock(&queue_mutex);
+    jobs.pop_back();
+    pthread_mutex_unlock(&queue_mutex);
+
+    compile(jit, job.get());
+    mark_done(job);
+  }
+}
+
+bool
+CompileQueue::is_done(const shared_ptr<CompileJob> &job)
+{
+  pthread_mutex_lock(&queue_mutex);
+  bool done = job->done;
+  pthread_mutex_unlock(&queue_mutex);
+
+  return done;
+}
+
+void
+CompileQueue::mark_done(const shared_ptr<CompileJob> &job)
+{
+  pthread_mutex_lock(&queue_mutex);
+  job->done = true;
+  pthread_cond_broadcast(&queue_changed);
+  pthread_mutex_unlock(&queue_mutex);
+}
+
+void
+CompileQueue::cancel(const shared_ptr<CompileJob> &job)
+{
+  pthread_mutex_lock(&queue_mutex);
+  deque<shared_ptr<CompileJob> >::iterator it = find(jobs.begin(), jobs.end(), job);
+  if (it != jobs.end()) {
+    jobs.erase(it);
+    pthread_cond_broadcast(&queue_changed);
+  }
+  while (current == job.get())
+    pthread_cond_wait(&queue_changed, &queue_mutex);
+  pthread_mutex_unlock(&queue_mutex);
+}
+
+void
+CompileQueue::wait_idle()
+{
+  pthread_mutex_lock(&queue_mutex);
+  while (jobs.size() || current)
+    pthread_cond_wait(&queue_changed, &queue_mutex);
+  pthread_mutex_unlock(&queue_mutex);
+}
+
+void *
+CompileQueue::compile(JITLayer *jit, CompileJob *job)
+{
+  if (job->fpm) {
+    PhaseTimer timer(pj_phase_optimize);
+
+    job->fpm->run(*job->function);
+  }
+  // before code generation, which changes the IR
+  if (job->cache) {
+    PhaseTimer timer(pj_phase_cache);
+
+    job->cache->store(job->cache_key, job->function, job->slots);
+  }
+
+  void *code;
+  {
+    PhaseTimer timer(pj_phase_codegen);
+
+    code = jit->function_code(job->function);
+  }
+
+  // the op might already be linked into the op tree (when replacing
+  // the code of a JITted region): make sure the code is visible before
+  // the pointer to it
+  job->code = code;
+  __sync_synchronize();
+  job->op->op_ppaddr = job->install ? job->install : (OP *(*)(pTHX)) code;
+
+  return code;
+}
+
+void *
+CompileQueue::run_worker(void *self)
+{
+  static_cast<CompileQueue *>(self)->run();
+
+  return NULL;
+}
+
+void
+CompileQueue::run()
+{
+  pthread_mutex_lock(&queue_mutex);
+  for (;;) {
+    while (!jobs.size() && !stopping)
+      pthread_cond_wait(&queue_changed, &queue_mutex);
+    if (!jobs.size())
+      break;
+
+    shared_ptr<CompileJob> job = jobs.front();
+
+    jobs.pop_front();
+    current = job.get();
+    pthread_mutex_unlock(&queue_mutex);
+
+    lock_llvm();
+    compile(jit, job.get());
+    unlock_llvm();
+
+    pthread_mutex_lock(&queue_mutex);
+    job->done = true;
+    current = NULL;
+    pthread_cond_broadcast(&queue_changed);
+  }
+  pthread_mutex_unlock(&queue_mutex);
+}
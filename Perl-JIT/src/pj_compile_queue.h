@@ -0,0 +1,94 @@
+#ifndef PJ_COMPILE_QUEUE_H_
+#define PJ_COMPILE_QUEUE_H_
+
+#include "pj_code_cache.h"
+#include "pj_jit_layer.h"
+
+#include <EXTERN.h>
+#include <perl.h>
+
+#undef Copy
+
+#include <llvm/IR/Function.h>
+#include <llvm/PassManager.h>
+
+#include <deque>
+#include <tr1/memory>
+#include <pthread.h>
+
+namespace PerlJIT {
+  // Optimizes a function and generates machine code for it, then
+  // installs the code as the op_ppaddr of op
+  struct CompileJob {
+    llvm::Function *function;
+    // NULL for code loaded from the cache, which is already optimized
+    llvm::FunctionPassManager *fpm;
+    OP *op;
+    // when set, installed as the op_ppaddr instead of the code, which
+    // the stub can find in code
+    OP *(*install)(pTHX);
+    void *code;
+    bool done;
+
+    // when set, the optimized function is written to the code cache
+    std::tr1::shared_ptr<CodeCache> cache;
+    std::string cache_key;
+    std::vector<llvm::GlobalVariable *> slots;
+
+    CompileJob(llvm::Function *_function, llvm::FunctionPassManager *_fpm, OP *_op) :
+      function(_function), fpm(_fpm), op(_op), install(NULL), code(NULL),
+      done(false) { }
+  };
+
+  // Runs compile jobs on a background thread. The thread never touches
+  // the Perl interpreter; since LLVM contexts are not thread-safe, all
+  // code using the JIT's LLVM context must hold the LLVM lock.
+  class CompileQueue {
+  public:
+    CompileQueue(JITLayer *jit);
+    // waits for pending jobs and stops the worker
+    ~CompileQueue();
+
+    // must be called with the LLVM lock held
+    void enqueue(const std::tr1::shared_ptr<CompileJob> &job);
+    bool is_done(const std::tr1::shared_ptr<CompileJob> &job);
+    // for jobs compiled outside the worker
+    void mark_done(const std::tr1::shared_ptr<CompileJob> &job);
+    // makes sure the worker won't touch the job: drops it from the
+    // queue, or waits for it when it is being compiled
+    void cancel(const std::tr1::shared_ptr<CompileJob> &job);
+    void wait_idle();
+
+    void lock_llvm() { pthread_mutex_lock(&llvm_mutex); }
+    bool try_lock_llvm() { return pthread_mutex_trylock(&llvm_mutex) == 0; }
+    void unlock_llvm() { pthread_mutex_unlock(&llvm_mutex); }
+
+    // compiles a job on the calling thread; requires the LLVM lock
+    static void *compile(JITLayer *jit, CompileJob *job);
+
+  private:
+    static void *run_worker(void *self);
+    void run();
+
+    JITLayer *jit;
+    std::deque<std::tr1::shared_ptr<CompileJob> > jobs;
+    pthread_t worker;
+    bool started, stopping;
+    // the job being compiled by the worker
+    CompileJob *current;
+    pthread_mutex_t queue_mutex, llvm_mutex;
+    pthread_cond_t queue_changed;
+  };
+
+  // RAII helper for the LLVM lock
+  class LLVMLock {
+  public:
+    LLVMLock(CompileQueue *_queue) : queue(_queue) { queue->lock_llvm(); }
+    ~LLVMLock() { queue->unlock_llvm(); }
+
+  private:
+    CompileQueue *queue;
+  };
+}
+
+#endif // PJ_COMPILE_QUEUE_H_
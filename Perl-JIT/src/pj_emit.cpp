@@ -1,16 +1,31 @@
 #include "pj_emit.h"
 #include "pj_optree.h"
+#include "pj_tbaa.h"
+#include "pj_clone.h"
+#include "pj_perf_map.h"
+#include "pj_phase_timer.h"
 
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/DIBuilder.h>
+#include <llvm/DebugInfo.h>
+#include <llvm/Support/Dwarf.h>
 #include <llvm/Analysis/Passes.h>
-#include <llvm/ExecutionEngine/JIT.h>
+#include <llvm/ExecutionEngine/JITEventListener.h>
 #include <llvm/IR/DataLayout.h>
 #include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Vectorize.h>
 #include <llvm/Analysis/Verifier.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Support/InstIterator.h>
 
-#include <deque>
+#include <algorithm>
+#include <map>
+#include <sstream>
 #include <tr1/unordered_set>
+#include <tr1/unordered_map>
 
 using namespace PerlJIT;
 using namespace PerlJIT::AST;
@@ -24,6 +39,12 @@ using namespace std::tr1;
 #define ITEM_COUNT(A) (sizeof(A) / sizeof((A)[0]))
 #define MY_CXT_KEY "Perl::JIT::_guts" XS_VERSION
 
+// pad lists before 5.18
+#ifndef PadlistARRAY
+# define PadlistARRAY(pl)       ((PAD **)AvARRAY(pl))
+# define PadlistMAX(pl)         AvFILLp(pl)
+#endif
+
 static Perl_ophook_t previous_free_hook = NULL;
 
 namespace {
@@ -39,51 +60,212 @@ namespace {
 
   PerlMutex jit_ops_mutex;
   unordered_set<OP *> jit_ops;
+
+  // Subs compiled in the background, keyed by their entry op, whose
+  // op_ppaddr is replaced by pj_pp_install_pending()
+  struct PendingInstall {
+    OP *(*ppaddr)(pTHX);
+    EmitterOutput output;
+
+    PendingInstall(AV *ops) : ppaddr(NULL), output(ops) { }
+  };
+
+  PerlMutex pending_installs_mutex;
+  unordered_map<OP *, PendingInstall *> pending_installs;
+
+  // Terms left to the interpreter and failed compilations, by reason
+  // and Perl op type (-1 for terms without an op)
+  PerlMutex bailouts_mutex;
+  std::map<std::pair<pj_bailout_reason, int>, UV> bailouts;
+
+  // JIT memory accounting for the code budget, protected by the LLVM
+  // lock; the epoch is read by JITted code to record region uses, and
+  // advances each time the budget is enforced
+  UV jit_epoch = 1;
+  size_t machine_code_bytes = 0, ir_bytes = 0;
+  UV evictions = 0;
+
+  // Keeps track of the size of the machine code of JITted functions
+  class CodeSizeListener : public JITEventListener {
+  public:
+    virtual void NotifyFunctionEmitted(const Function &function, void *code, size_t size,
+                                       const EmittedFunctionDetails &details)
+    {
+      sizes[code] = size;
+      machine_code_bytes += size;
+    }
+
+    virtual void NotifyFreeingMachineCode(void *code)
+    {
+      unordered_map<void *, size_t>::iterator it = sizes.find(code);
+
+      if (it == sizes.end())
+        return;
+      machine_code_bytes -= it->second;
+      sizes.erase(it);
+    }
+
+  private:
+    unordered_map<void *, size_t> sizes;
+  };
 }
 
+// in-memory size of the IR of a function, roughly
+#define IR_BYTES_PER_INSTRUCTION 96
+
 static pj_op_type JITTABLE_OPS[] = {
-  pj_binop_add
+  pj_binop_add,
+  pj_binop_subtract,
+  pj_binop_multiply,
+  pj_binop_sassign
 };
 static unordered_set<int> Jittable_Ops(
   JITTABLE_OPS,
   JITTABLE_OPS + ITEM_COUNT(JITTABLE_OPS)
 );
 
+// What we know about the code currently installed as op_ppaddr
+struct Region {
+  Function *function;
+  pj_opt_level opt_level;
+  Module *module;
+  // private variables of the function: the op slots, followed by the
+  // use tracking variables and the profiling counters (if any); ops
+  // are the values of the op slots
+  std::vector<GlobalVariable *> slots;
+  std::vector<OP *> ops;
+  bool track_use;
+  pj_profile_level profile;
+  // when there is a code budget or tier-up, JITted code stores the
+  // epoch of its last execution and counts its active calls (a croak
+  // leaves the count non-zero, which only makes the region unevictable
+  // and keeps the code replaced by tier-up alive)
+  UV *last_use, *active;
+  // profiling counters of the current code, and the totals of the code
+  // evicted before it
+  UV *calls, *cycles;
+  UV calls_base, cycles_base;
+  // where the region comes from, for the stats
+  CV *cv;
+  const COP *cop;
+  // symbolic name of the function, for perf and the debugger
+  std::string name;
+  // the last compile job for the function, which can't be evicted
+  // until the job is done
+  shared_ptr<CompileJob> job;
+  size_t ir_size;
+  // bitcode of the function, after its code has been evicted
+  std::string evicted;
+  // the function replaced by tier-up, until no frame can be running
+  // its code
+  Function *replaced;
+
+  Region() :
+    function(NULL), opt_level(pj_opt_none), module(NULL),
+    track_use(false), profile(pj_profile_none),
+    last_use(NULL), active(NULL), calls(NULL), cycles(NULL),
+    calls_base(0), cycles_base(0), cv(NULL), cop(NULL), ir_size(0),
+    replaced(NULL) { }
+};
+
 struct ScalarOP : public OP {
-  shared_ptr<ExecutionEngine> execution_engine;
+  shared_ptr<CompilationUnit> unit;
+  Region region;
 };
 
 struct ListOP : public LISTOP {
-  shared_ptr<ExecutionEngine> execution_engine;
+  shared_ptr<CompilationUnit> unit;
+  Region region;
 };
 
+static Region *
+jit_op_region(OP *op)
+{
+  if (op->op_type == JIT_SCALAR_OP)
+    return &((ScalarOP *) op)->region;
+  else
+    return &((ListOP *) op)->region;
+}
+
+static OP *pj_pp_install_pending(pTHX);
+static OP *pj_pp_evicted(pTHX);
+static OP *pj_pp_compile_lazily(pTHX);
+static OP *pj_pp_free_replaced(pTHX);
+static CompileQueue *llvm_lock_owner(pTHX);
+
 static
 void free_execution_engine(pTHX_ OP *op)
 {
+  if (op->op_ppaddr == pj_pp_install_pending) {
+    MUTEX_LOCK(pending_installs_mutex);
+    unordered_map<OP *, PendingInstall *>::iterator it = pending_installs.find(op);
+    if (it != pending_installs.end()) {
+      SvREFCNT_dec(it->second->output.ops);
+      delete it->second;
+      pending_installs.erase(it);
+    }
+    MUTEX_UNLOCK(pending_installs_mutex);
+  }
+
   if (op->op_type == JIT_SCALAR_OP || op->op_type == JIT_LIST_OP) {
+    CompileQueue *queue = llvm_lock_owner(aTHX);
+    shared_ptr<CompileJob> job;
+
+    MUTEX_LOCK(jit_ops_mutex);
+    if (jit_ops.find(op) != jit_ops.end())
+      job = jit_op_region(op)->job;
+    MUTEX_UNLOCK(jit_ops_mutex);
+
+    // the compile thread might still be about to write op_ppaddr; other
+    // jobs in the queue don't matter
+    if (queue && job)
+      queue->cancel(job);
+
+    // releasing the last op of a compilation unit frees its code
+    if (queue)
+      queue->lock_llvm();
+
     MUTEX_LOCK(jit_ops_mutex);
-    if (jit_ops.find(op) != jit_ops.end()) {
+    if (jit_ops.erase(op)) {
+      Region *region = jit_op_region(op);
+
+      ir_bytes -= region->evicted.empty() ? region->ir_size : region->evicted.size();
       if (op->op_type == JIT_SCALAR_OP)
           ((ScalarOP *) op)->~ScalarOP();
       else
           ((ListOP *) op)->~ListOP();
     }
     MUTEX_UNLOCK(jit_ops_mutex);
+
+    if (queue)
+      queue->unlock_llvm();
   }
 
   if (previous_free_hook)
     previous_free_hook(aTHX_ op);
 }
 
+static void pj_jit_tier_up(pTHX);
+
 namespace PerlJIT {
   struct Cxt {
     IRBuilder<> builder;
-    shared_ptr<ExecutionEngine> engine;
+    shared_ptr<JITLayer> jit;
     Module *module;
-    FunctionPassManager *fpm;
+    FunctionPassManager *fpm[pj_opt_aggressive + 1];
     PerlAPI *pa;
+    TBAA *tbaa;
+    CompileQueue *compile_queue;
+    Function *tier_up;
+    GlobalVariable *epoch;
+    CodeSizeListener code_size_listener;
+    PerfMapListener perf_listener;
+    // 0 for no budget
+    size_t code_budget;
 
     void create_module();
+    void map_declarations(Module *unit);
+    FunctionPassManager *function_pass_manager(pj_opt_level level);
 
     Cxt();
     ~Cxt();
@@ -93,14 +275,27 @@ typedef Cxt my_cxt_t;
 START_MY_CXT
 
 Cxt::Cxt() :
-  builder(getGlobalContext()), module(NULL), fpm(NULL), pa(NULL)
+  builder(getGlobalContext()), module(NULL), pa(NULL), tbaa(NULL),
+  compile_queue(NULL), tier_up(NULL), epoch(NULL), code_budget(0)
 {
+  for (size_t i = 0; i < ITEM_COUNT(fpm); ++i)
+    fpm[i] = NULL;
 }
 
 Cxt::~Cxt()
 {
+  // stop the worker thread before anything it might use goes away
+  delete compile_queue;
+  compile_queue = NULL;
+  // the JIT outlives the context when JIT ops are still around
+  if (jit) {
+    jit->remove_listener(&code_size_listener);
+    jit->remove_listener(&perf_listener);
+  }
   delete pa;
-  delete fpm;
+  delete tbaa;
+  for (size_t i = 0; i < ITEM_COUNT(fpm); ++i)
+    delete fpm[i];
 }
 
 void
@@ -112,26 +307,127 @@ Cxt::create_module()
   string errstr;
 
   module = new Module("PerlJIT", getGlobalContext());
-  engine = shared_ptr<ExecutionEngine>(EngineBuilder(module).setErrorStr(&errstr).create());
+  jit = shared_ptr<JITLayer>(JITLayer::create(module, errstr));
 
-  if (!engine) {
+  if (!jit) {
     delete module;
+    module = NULL;
     croak("Could not create ExecutionEngine: %s", errstr.c_str());
   }
 
-  fpm = new FunctionPassManager(module);
+  module->setDataLayout(jit->data_layout()->getStringRepresentation());
+
+  pa = new PerlAPI(module, &builder);
+  tbaa = new TBAA(module);
+  compile_queue = new CompileQueue(jit.get());
+
+  tier_up = Function::Create(pa->helper_type(), GlobalValue::ExternalLinkage,
+                             "pj_jit_tier_up", module);
+  pa->mark_cold(tier_up);
+  jit->map_global(tier_up, (void *) pj_jit_tier_up);
+
+  epoch = new GlobalVariable(*module, pa->UV_constant(0)->getType(), false,
+                             GlobalValue::ExternalLinkage, NULL, "pj_jit_epoch");
+  jit->map_global(epoch, &jit_epoch);
+
+  jit->add_listener(&code_size_listener);
+  jit->add_listener(&perf_listener);
+}
+
+// Declarations in compilation units are resolved by name, which does
+// not work for helpers that are not exported: copy their mappings from
+// the main module
+void
+Cxt::map_declarations(Module *unit)
+{
+  for (Module::iterator it = unit->begin(), end = unit->end(); it != end; ++it) {
+    if (!it->isDeclaration() || jit->mapped_address(it))
+      continue;
+
+    Function *original = module->getFunction(it->getName());
+    void *address = original ? jit->mapped_address(original) : NULL;
+
+    if (address)
+      jit->map_global(it, address);
+  }
+
+  for (Module::global_iterator it = unit->global_begin(), end = unit->global_end(); it != end; ++it) {
+    if (!it->isDeclaration() || jit->mapped_address(it))
+      continue;
+
+    GlobalVariable *original = module->getGlobalVariable(it->getName());
+    void *address = original ? jit->mapped_address(original) : NULL;
+
+    if (address)
+      jit->map_global(it, address);
+  }
+}
+
+// Pass pipelines are created on first use, since most programs only
+// ever use one or two optimization levels
+FunctionPassManager *
+Cxt::function_pass_manager(pj_opt_level level)
+{
+  if (fpm[level])
+    return fpm[level];
+
+  FunctionPassManager *pm = new FunctionPassManager(module);
+
+  pm->add(createTypeBasedAliasAnalysisPass());
+  pm->add(createBasicAliasAnalysisPass());
+  pm->add(createPromoteMemoryToRegisterPass());
+
+  if (level >= pj_opt_basic) {
+    pm->add(createInstructionCombiningPass());
+    pm->add(createCFGSimplificationPass());
+  }
+
+  if (level >= pj_opt_default) {
+    pm->add(createReassociatePass());
+    pm->add(createGVNPass());
+    pm->add(createCFGSimplificationPass());
+  }
+
+  // there is no inliner here: it is not a function pass, and the
+  // JITted functions don't call each other
+  if (level >= pj_opt_aggressive) {
+    pm->add(createSCCPPass());
+    pm->add(createLoopRotatePass());
+    pm->add(createLICMPass());
+    pm->add(createIndVarSimplifyPass());
+    pm->add(createLoopUnrollPass());
+    pm->add(createLoopVectorizePass());
+    pm->add(createSLPVectorizerPass());
+    pm->add(createInstructionCombiningPass());
+    pm->add(createGVNPass());
+    pm->add(createCFGSimplificationPass());
+  }
+
+  pm->doInitialization();
+
+  return fpm[level] = pm;
+}
+
+// The compile queue owns the LLVM lock; there is nothing to lock
+// against after the emitter has been torn down
+static CompileQueue *
+llvm_lock_owner(pTHX)
+{
+  dMY_CXT;
 
-  module->setDataLayout(engine->getDataLayout()->getStringRepresentation());
-  fpm->add(createBasicAliasAnalysisPass());
-  fpm->add(createPromoteMemoryToRegisterPass());
-  fpm->add(createInstructionCombiningPass());
-  fpm->add(createReassociatePass());
-  fpm->add(createGVNPass());
-  fpm->add(createCFGSimplificationPass());
+  return MY_CXT.compile_queue;
+}
 
-  fpm->doInitialization();
+CompilationUnit::CompilationUnit(const shared_ptr<JITLayer> &_jit, Module *_module) :
+  jit(_jit), module(_module)
+{
+  jit->add_module(module);
+}
 
-  pa = new PerlAPI(module, &builder, engine.get());
+CompilationUnit::~CompilationUnit()
+{
+  jit->remove_module(module);
+  delete module;
 }
 
 static void
@@ -155,26 +451,675 @@ PerlJIT::pj_init_emitter(pTHX)
   Perl_call_atexit(aTHX_ cleanup_emitter, NULL);
 }
 
+// The recompiled code of a hot region doesn't need the tier-up check:
+// the branch to the pj_jit_tier_up() call is made never taken and the
+// counter updates are dropped, so the optimizer removes the rest
+static void
+remove_tier_up_check(pMY_CXT_ Function *function)
+{
+  BasicBlock *check = NULL;
+  std::vector<Instruction *> counter_stores;
+
+  for (inst_iterator it = inst_begin(function), end = inst_end(function); it != end; ++it) {
+    if (CallInst *call = dyn_cast<CallInst>(&*it)) {
+      if (call->getCalledFunction() == MY_CXT.tier_up)
+        check = call->getParent();
+    } else if (StoreInst *store = dyn_cast<StoreInst>(&*it)) {
+      GlobalVariable *global = dyn_cast<GlobalVariable>(store->getPointerOperand());
+
+      if (global && global->getName().startswith("tier_up_counter"))
+        counter_stores.push_back(store);
+    }
+  }
+
+  if (check) {
+    for (Function::iterator it = function->begin(), end = function->end(); it != end; ++it) {
+      BranchInst *branch = dyn_cast<BranchInst>(it->getTerminator());
+
+      if (!branch || !branch->isConditional())
+        continue;
+      if (branch->getSuccessor(0) == check)
+        branch->setCondition(ConstantInt::getFalse(function->getContext()));
+      else if (branch->getSuccessor(1) == check)
+        branch->setCondition(ConstantInt::getTrue(function->getContext()));
+    }
+  }
+
+  for (size_t i = 0, max = counter_stores.size(); i < max; ++i)
+    counter_stores[i]->eraseFromParent();
+}
+
+// Called by JITted code compiled with tier_up_calls once the region
+// becomes hot: recompiles it at the highest optimization level and
+// installs the new code for the next execution. JITted code never
+// waits for the compile thread: when the LLVM lock is taken, the
+// region just calls back on its next execution
+static void
+pj_jit_tier_up(pTHX)
+{
+  dMY_CXT;
+  Region *region = jit_op_region(PL_op);
+
+  if (region->opt_level == pj_opt_aggressive)
+    return;
+  if (!MY_CXT.compile_queue->try_lock_llvm())
+    return;
+
+  ValueToValueMapTy vmap;
+  Function *hot = CloneFunction(region->function, vmap, false);
+
+  region->function->getParent()->getFunctionList().push_back(hot);
+  hot->setName(region->name + " hot");
+  remove_tier_up_check(aMY_CXT_ hot);
+  region->replaced = region->function;
+  region->function = hot;
+  region->opt_level = pj_opt_aggressive;
+
+  // the current code keeps running until the new one is ready, and
+  // is freed by the first execution of the new one
+  region->job = shared_ptr<CompileJob>(
+    new CompileJob(hot, MY_CXT.function_pass_manager(pj_opt_aggressive), PL_op));
+  region->job->install = pj_pp_free_replaced;
+  MY_CXT.compile_queue->enqueue(region->job);
+  MY_CXT.compile_queue->unlock_llvm();
+}
+
+// Deletes a function, and the private globals (op slots, counters)
+// only used by it
+static void
+erase_function(Function *function)
+{
+  unordered_set<GlobalVariable *> globals;
+
+  for (inst_iterator it = inst_begin(function), end = inst_end(function); it != end; ++it)
+    for (User::op_iterator op = it->op_begin(), op_end = it->op_end(); op != op_end; ++op)
+      if (GlobalVariable *global = dyn_cast<GlobalVariable>(*op))
+        if (global->hasLocalLinkage())
+          globals.insert(global);
+
+  function->eraseFromParent();
+
+  for (unordered_set<GlobalVariable *>::iterator it = globals.begin(), end = globals.end(); it != end; ++it)
+    if ((*it)->use_empty())
+      (*it)->eraseFromParent();
+}
+
+// op_ppaddr of regions recompiled by tier-up: frees the code they
+// replaced, once no frame is running it, and installs the new code.
+// The old and new code share the count of active calls, which (unlike
+// CvDEPTH) also covers the other clones of a closure, since they
+// share the JIT op
+static OP *
+pj_pp_free_replaced(pTHX)
+{
+  dMY_CXT;
+  OP *op = PL_op;
+  Region *region = jit_op_region(op);
+  OP *(*code)(pTHX) = (OP *(*)(pTHX)) region->job->code;
+
+  // as in pj_jit_tier_up(), retry on the next execution rather than
+  // waiting for the compile thread
+  if (region->active && !*region->active && MY_CXT.compile_queue->try_lock_llvm()) {
+    MY_CXT.jit->free_function_code(region->replaced);
+    erase_function(region->replaced);
+    region->replaced = NULL;
+    op->op_ppaddr = code;
+    MY_CXT.compile_queue->unlock_llvm();
+  }
+
+  return code(aTHX);
+}
+
+static size_t
+ir_size_estimate(Function *function)
+{
+  size_t instructions = 0;
+
+  for (Function::iterator it = function->begin(), end = function->end(); it != end; ++it)
+    instructions += it->size();
+
+  return instructions * IR_BYTES_PER_INSTRUCTION;
+}
+
+// Fills in the private variables of a (possibly reloaded) region
+static void
+bind_region_slots(pTHX_ pMY_CXT_ Region *region)
+{
+  size_t slot = region->ops.size();
+
+  for (size_t i = 0; i < slot; ++i)
+    *(OP **) MY_CXT.jit->global_address(region->slots[i]) = region->ops[i];
+
+  if (region->track_use) {
+    region->last_use = (UV *) MY_CXT.jit->global_address(region->slots[slot++]);
+    region->active = (UV *) MY_CXT.jit->global_address(region->slots[slot++]);
+    *region->last_use = jit_epoch;
+  }
+  if (region->profile >= pj_profile_calls)
+    region->calls = (UV *) MY_CXT.jit->global_address(region->slots[slot++]);
+  if (region->profile >= pj_profile_cycles)
+    region->cycles = (UV *) MY_CXT.jit->global_address(region->slots[slot++]);
+}
+
+// Replaces the code of a region with a stub, keeping just the bitcode;
+// must be called with the LLVM lock held
+static void
+evict_region(pTHX_ pMY_CXT_ OP *op)
+{
+  Region *region = jit_op_region(op);
+
+  region->evicted = CodeCache::to_bitcode(region->function, region->slots);
+  op->op_ppaddr = pj_pp_evicted;
+
+  // the reloaded code starts counting from zero
+  if (region->calls)
+    region->calls_base += *region->calls;
+  if (region->cycles)
+    region->cycles_base += *region->cycles;
+
+  MY_CXT.jit->free_function_code(region->function);
+  erase_function(region->function);
+
+  region->function = NULL;
+  region->slots.clear();
+  region->last_use = region->active = NULL;
+  region->calls = region->cycles = NULL;
+  region->job.reset();
+
+  ir_bytes -= region->ir_size;
+  ir_bytes += region->evicted.size();
+  ++evictions;
+}
+
+// Brings back the code of an evicted region; must be called with the
+// LLVM lock held
+static bool
+restore_region(pTHX_ pMY_CXT_ OP *op)
+{
+  Region *region = jit_op_region(op);
+  std::vector<GlobalVariable *> slots;
+  Function *function = CodeCache::from_bitcode(region->evicted, region->module, slots);
+
+  if (!function)
+    return false;
+
+  MY_CXT.map_declarations(region->module);
+
+  function->setName(region->name);
+  region->function = function;
+  region->slots = slots;
+  bind_region_slots(aTHX_ aMY_CXT_ region);
+
+  ir_bytes -= region->evicted.size();
+  region->ir_size = ir_size_estimate(function);
+  ir_bytes += region->ir_size;
+  std::string().swap(region->evicted);
+
+  // the bitcode is already optimized
+  op->op_ppaddr = (OP *(*)(pTHX)) MY_CXT.jit->function_code(function);
+
+  return true;
+}
+
+// Evicts the least recently used regions until the JIT memory fits the
+// budget; must be called with the LLVM lock held
+static void
+enforce_code_budget(pTHX_ pMY_CXT_ OP *keep)
+{
+  if (!MY_CXT.code_budget || machine_code_bytes + ir_bytes <= MY_CXT.code_budget)
+    return;
+
+  std::vector<std::pair<UV, OP *> > candidates;
+
+  MUTEX_LOCK(jit_ops_mutex);
+  for (unordered_set<OP *>::iterator it = jit_ops.begin(), end = jit_ops.end(); it != end; ++it) {
+    OP *op = *it;
+    Region *region = jit_op_region(op);
+
+    // untracked, already evicted, running, or still being compiled or
+    // replaced
+    if (op == keep || !region->last_use || *region->active || region->replaced)
+      continue;
+    if (region->job && !MY_CXT.compile_queue->is_done(region->job))
+      continue;
+
+    candidates.push_back(std::make_pair(*region->last_use, op));
+  }
+  MUTEX_UNLOCK(jit_ops_mutex);
+
+  std::sort(candidates.begin(), candidates.end());
+  for (size_t i = 0, max = candidates.size();
+       i < max && machine_code_bytes + ir_bytes > MY_CXT.code_budget; ++i)
+    evict_region(aTHX_ aMY_CXT_ candidates[i].second);
+
+  // regions used from now on are more recent than all the ones above
+  ++jit_epoch;
+}
+
+// op_ppaddr of evicted regions: recompiles the code on the next use
+static OP *
+pj_pp_evicted(pTHX)
+{
+  dMY_CXT;
+  OP *op = PL_op;
+  bool restored;
+
+  {
+    LLVMLock lock(MY_CXT.compile_queue);
+
+    restored = restore_region(aTHX_ aMY_CXT_ op);
+    if (restored)
+      enforce_code_budget(aTHX_ aMY_CXT_ op);
+  }
+
+  if (!restored)
+    croak("Unable to restore evicted JIT code");
+
+  return op->op_ppaddr(aTHX);
+}
+
+// op_ppaddr of regions compiled with lazy => 1: generates the code on
+// the first execution of the region
+static OP *
+pj_pp_compile_lazily(pTHX)
+{
+  dMY_CXT;
+  OP *op = PL_op;
+
+  {
+    LLVMLock lock(MY_CXT.compile_queue);
+    Region *region = jit_op_region(op);
+
+    // the region might have been compiled by another thread
+    if (op->op_ppaddr == pj_pp_compile_lazily) {
+      CompileQueue::compile(MY_CXT.jit.get(), region->job.get());
+      MY_CXT.compile_queue->mark_done(region->job);
+      enforce_code_budget(aTHX_ aMY_CXT_ op);
+    }
+  }
+
+  return op->op_ppaddr(aTHX);
+}
+
+// The statement containing an op: the last COP before it in the op
+// tree, in execution order
+static bool
+find_region_cop(OP *op, OP *target, const COP **cop)
+{
+  for (; op; op = op->op_sibling) {
+    if (op->op_type == OP_NEXTSTATE || op->op_type == OP_DBSTATE ||
+        (op->op_type == OP_NULL &&
+         (op->op_targ == OP_NEXTSTATE || op->op_targ == OP_DBSTATE)))
+      *cop = cCOPx(op);
+    if (op == target)
+      return true;
+    if ((op->op_flags & OPf_KIDS) && find_region_cop(cUNOPx(op)->op_first, target, cop))
+      return true;
+  }
+
+  return false;
+}
+
+static const COP *
+region_cop(OP *root, OP *target)
+{
+  const COP *cop = NULL;
+
+  if (!target || !find_region_cop(root, target, &cop))
+    return NULL;
+
+  return cop;
+}
+
+static void
+clear_op_next(OP *op)
+{
+  // in most cases, the exit point for an optree is the op_next
+  // pointer of the root op, but conditional operators have interesting
+  // control flows
+  switch (op->op_type) {
+  case OP_COND_EXPR: {
+    LOGOP *logop = cLOGOPx(op);
+
+    clear_op_next(logop->op_first->op_sibling);
+    clear_op_next(logop->op_first->op_sibling->op_sibling);
+  }
+    break;
+  case OP_AND:
+  case OP_ANDASSIGN:
+  case OP_OR:
+  case OP_ORASSIGN:
+  case OP_DOR:
+  case OP_DORASSIGN: {
+    LOGOP *logop = cLOGOPx(op);
+
+    clear_op_next(logop->op_first->op_sibling);
+    op->op_next = NULL;
+  }
+    break;
+  default:
+    op->op_next = NULL;
+    break;
+  }
+}
+
+// Makes the subtrees called by JITted code stop at their root, and
+// applies the op-tree edits; the caller must be able to croak
+static void
+apply_emitter_output(pTHX_ EmitterOutput *output)
+{
+  for (size_t i = 0, max = output->exits.size(); i < max; ++i)
+    clear_op_next(output->exits[i]);
+
+  dSP;
+
+  ENTER;
+  SAVETMPS;
+
+  PUSHMARK(SP);
+  XPUSHs(sv_2mortal(newRV_inc((SV *) output->ops)));
+  PUTBACK;
+
+  call_pv("Perl::JIT::Emit::_apply_ops", G_VOID | G_DISCARD);
+
+  FREETMPS;
+  LEAVE;
+}
+
+// Entry op of a sub with code compiled in the background: once all the
+// code is ready, and no other frame of the sub is running, the op tree
+// is patched and execution restarts from the (new) start of the sub
+static OP *
+pj_pp_install_pending(pTHX)
+{
+  dMY_CXT;
+  OP *(*ppaddr)(pTHX);
+  PendingInstall *pending = NULL;
+
+  MUTEX_LOCK(pending_installs_mutex);
+  unordered_map<OP *, PendingInstall *>::iterator it = pending_installs.find(PL_op);
+  assert(it != pending_installs.end());
+  ppaddr = it->second->ppaddr;
+
+  if (CvDEPTH(find_runcv(NULL)) == 1) {
+    const std::vector<shared_ptr<CompileJob> > &jobs = it->second->output.jobs;
+    bool done = true;
+
+    for (size_t i = 0, max = jobs.size(); i < max && done; ++i)
+      done = MY_CXT.compile_queue->is_done(jobs[i]);
+
+    if (done) {
+      pending = it->second;
+      pending_installs.erase(it);
+      PL_op->op_ppaddr = ppaddr;
+    }
+  }
+  MUTEX_UNLOCK(pending_installs_mutex);
+
+  if (!pending)
+    return ppaddr(aTHX);
+
+  CV *cv = find_runcv(NULL);
+
+  SAVEFREESV(pending->output.ops);
+  apply_emitter_output(aTHX_ &pending->output);
+  delete pending;
+
+  return CvSTART(cv);
+}
+
+SV *
+PerlJIT::pj_code_memory()
+{
+  dTHX;
+  dMY_CXT;
+  HV *memory = newHV();
+
+  {
+    LLVMLock lock(MY_CXT.compile_queue);
+
+    hv_stores(memory, "machine_code", newSVuv(machine_code_bytes));
+    hv_stores(memory, "ir", newSVuv(ir_bytes));
+    hv_stores(memory, "evictions", newSVuv(evictions));
+  }
+  hv_stores(memory, "budget", newSVuv(MY_CXT.code_budget));
+
+  return newRV_noinc((SV *) memory);
+}
+
+// indexed by pj_bailout_reason
+static const char *bailout_names[] = {
+  "none",
+  "unknown_op",
+  "opaque_operand",
+  "optree",
+  "unsupported_term",
+  "sparse_sequence",
+  "caller_context",
+  "unsupported_constant",
+  "missing_target",
+  "unsupported_assignment",
+  "unsupported_coercion",
+};
+
+SV *
+PerlJIT::pj_bailouts()
+{
+  dTHX;
+  HV *result = newHV();
+
+  MUTEX_LOCK(bailouts_mutex);
+  for (std::map<std::pair<pj_bailout_reason, int>, UV>::iterator it = bailouts.begin(), end = bailouts.end(); it != end; ++it) {
+    const char *reason = bailout_names[it->first.first];
+    const char *op_name = it->first.second >= 0 ? PL_op_name[it->first.second] : "(none)";
+    SV **ops = hv_fetch(result, reason, strlen(reason), 1);
+
+    if (!SvROK(*ops))
+      sv_setsv(*ops, sv_2mortal(newRV_noinc((SV *) newHV())));
+    hv_store((HV *) SvRV(*ops), op_name, strlen(op_name), newSVuv(it->second), 0);
+  }
+  MUTEX_UNLOCK(bailouts_mutex);
+
+  return newRV_noinc((SV *) result);
+}
+
+void
+PerlJIT::pj_reset_bailouts()
+{
+  MUTEX_LOCK(bailouts_mutex);
+  bailouts.clear();
+  MUTEX_UNLOCK(bailouts_mutex);
+}
+
+SV *
+PerlJIT::pj_region_stats()
+{
+  dTHX;
+  dMY_CXT;
+  AV *stats = newAV();
+
+  if (!MY_CXT.compile_queue)
+    return newRV_noinc((SV *) stats);
+
+  LLVMLock lock(MY_CXT.compile_queue);
+
+  MUTEX_LOCK(jit_ops_mutex);
+  for (unordered_set<OP *>::iterator it = jit_ops.begin(), end = jit_ops.end(); it != end; ++it) {
+    Region *region = jit_op_region(*it);
+
+    if (region->profile == pj_profile_none)
+      continue;
+
+    HV *entry = newHV();
+    GV *gv = CvGV(region->cv);
+
+    hv_stores(entry, "sub", newRV_inc((SV *) region->cv));
+    if (gv && GvSTASH(gv) && HvNAME(GvSTASH(gv)))
+      hv_stores(entry, "name", newSVpvf("%s::%s", HvNAME(GvSTASH(gv)), GvNAME(gv)));
+    if (region->cop) {
+      hv_stores(entry, "file", newSVpv(CopFILE(region->cop), 0));
+      hv_stores(entry, "line", newSVuv(CopLINE(region->cop)));
+    }
+    hv_stores(entry, "calls", newSVuv(region->calls_base + (region->calls ? *region->calls : 0)));
+    if (region->profile >= pj_profile_cycles)
+      hv_stores(entry, "cycles", newSVuv(region->cycles_base + (region->cycles ? *region->cycles : 0)));
+    hv_stores(entry, "opt_level", newSViv(region->opt_level));
+
+    av_push(stats, newRV_noinc((SV *) entry));
+  }
+  MUTEX_UNLOCK(jit_ops_mutex);
+
+  return newRV_noinc((SV *) stats);
+}
+
+void
+PerlJIT::pj_wait_for_compilation()
+{
+  dTHX;
+  dMY_CXT;
+
+  if (MY_CXT.compile_queue)
+    MY_CXT.compile_queue->wait_idle();
+}
+
+static IV
+option_iv(pTHX_ HV *options, const char *name, IV default_value)
+{
+  SV **value = hv_fetch(options, name, strlen(name), 0);
+
+  return value && SvOK(*value) ? SvIV(*value) : default_value;
+}
+
+static std::string
+option_string(pTHX_ HV *options, const char *name)
+{
+  SV **value = hv_fetch(options, name, strlen(name), 0);
+  STRLEN length;
+  const char *string;
+
+  if (!value || !SvOK(*value))
+    return std::string();
+  string = SvPV(*value, length);
+
+  return std::string(string, length);
+}
+
 SV *
-PerlJIT::pj_jit_sub(SV *coderef)
+PerlJIT::pj_jit_sub(SV *coderef, HV *options)
 {
   dTHX;
   dMY_CXT;
   SV *error = NULL;
+  EmitterOptions emitter_options;
+  IV opt_level = option_iv(aTHX_ options, "opt_level", pj_opt_default);
+  IV tier_up_calls = option_iv(aTHX_ options, "tier_up_calls", 0);
+
+  if (opt_level < pj_opt_none || opt_level > pj_opt_aggressive)
+    croak("Invalid optimization level %d", (int) opt_level);
+  if (tier_up_calls < 0)
+    croak("Invalid tier-up call count %d", (int) tier_up_calls);
+  emitter_options.opt_level = (pj_opt_level) opt_level;
+  emitter_options.tier_up_calls = tier_up_calls;
+  emitter_options.async = option_iv(aTHX_ options, "async", 0);
+  emitter_options.lazy = option_iv(aTHX_ options, "lazy", 0);
+
+  IV profile = option_iv(aTHX_ options, "profile", pj_profile_none);
+  if (profile < pj_profile_none || profile > pj_profile_cycles)
+    croak("Invalid profiling level %d", (int) profile);
+  emitter_options.profile = (pj_profile_level) profile;
+
+  int perf_outputs;
+  if (!pj_parse_perf_outputs(option_string(aTHX_ options, "perf"), perf_outputs))
+    croak("Invalid perf output '%s'", option_string(aTHX_ options, "perf").c_str());
+  // line tables are only consumed by jitdump
+  emitter_options.debug_info = option_iv(aTHX_ options, "debug_info",
+                                         (perf_outputs & pj_perf_jitdump) != 0);
+  // there is nothing to compile in the background for lazy regions
+  if (emitter_options.lazy)
+    emitter_options.async = false;
+
+  std::string cache_dir = option_string(aTHX_ options, "cache_dir");
+  if (!cache_dir.empty())
+    emitter_options.cache = shared_ptr<CodeCache>(new CodeCache(cache_dir));
 
   MY_CXT.create_module();
+  MY_CXT.perf_listener.enable(perf_outputs);
+
+  IV code_budget = option_iv(aTHX_ options, "code_budget", -1);
+  if (code_budget >= 0)
+    MY_CXT.code_budget = code_budget;
+  emitter_options.track_use = MY_CXT.code_budget != 0;
+
+  CV *cv = (CV *)SvRV(coderef);
+  OP *entry = CvSTART(cv);
+
+  if (emitter_options.async && entry->op_ppaddr == pj_pp_install_pending)
+    croak("Sub is already being compiled");
 
   {
-    std::vector<Term *> asts = pj_find_jit_candidates(aTHX_ coderef);
-    AV *ops = newAV();
-    Emitter emitter(aTHX_ aMY_CXT_ (CV *)SvRV(coderef), ops);
+    // the ASTs are only needed until the IR is emitted, and are
+    // released with the temporaries of the calling statement
+    std::vector<Term *> asts = pj_find_jit_candidates(aTHX_ coderef, *pj_new_mortal_arena(aTHX));
+    PendingInstall *pending = new PendingInstall(newAV());
+    EmitterOutput *output = &pending->output;
+    bool ok;
+
+    {
+      LLVMLock lock(MY_CXT.compile_queue);
+      Module *unit_module = new Module("PerlJIT unit", getGlobalContext());
+
+      unit_module->setDataLayout(MY_CXT.module->getDataLayout());
+      output->unit = shared_ptr<CompilationUnit>(new CompilationUnit(MY_CXT.jit, unit_module));
+
+      {
+        Emitter emitter(aTHX_ aMY_CXT_ cv, output, emitter_options);
+
+        PhaseTimer timer(pj_phase_emit);
+
+        ok = emitter.process_jit_candidates(asts);
+        if (!ok) {
+          std::string error_message = emitter.error();
+          error = sv_2mortal(newSVpv(error_message.c_str(), error_message.size()));
+        }
+      }
+
+      // from now on the unit is owned by the JIT ops, and freed with
+      // the last one (or right here, when there are none)
+      output->unit.reset();
+
+      enforce_code_budget(aTHX_ aMY_CXT_ NULL);
+    }
+
+    if (ok && !emitter_options.async) {
+      AV *ops = output->ops;
+
+      for (size_t i = 0, max = output->exits.size(); i < max; ++i)
+        clear_op_next(output->exits[i]);
+      delete pending;
 
-    if (emitter.process_jit_candidates(asts))
       return newRV_noinc((SV *) ops);
+    }
+
+    if (ok && output->jobs.empty()) {
+      // nothing was JITted, so there is nothing to install
+      SvREFCNT_dec(output->ops);
+      delete pending;
+
+      return newRV_noinc((SV *) newAV());
+    }
 
-    SvREFCNT_dec(ops);
-    std::string error_message = emitter.error();
-    error = sv_2mortal(newSVpv(error_message.c_str(), error_message.size()));
+    if (ok) {
+      MUTEX_LOCK(pending_installs_mutex);
+      pending->ppaddr = entry->op_ppaddr;
+      pending_installs[entry] = pending;
+      entry->op_ppaddr = pj_pp_install_pending;
+      MUTEX_UNLOCK(pending_installs_mutex);
+
+      return newRV_noinc((SV *) newAV());
+    }
+
+    SvREFCNT_dec(output->ops);
+    delete pending;
   }
 
   // here we can croak because all C++ objects have been destroyed
@@ -183,21 +1128,21 @@ PerlJIT::pj_jit_sub(SV *coderef)
 }
 
 
-Emitter::Emitter(pTHX_ pMY_CXT_ CV *_cv, AV *_ops) :
-  cv(_cv), ops(_ops),
-  module(MY_CXT.module), fpm(MY_CXT.fpm),
-  execution_engine(MY_CXT.engine),
-  pa(*MY_CXT.pa)
+Emitter::Emitter(pTHX_ pMY_CXT_ CV *_cv, EmitterOutput *_output, const EmitterOptions &_options) :
+  cv(_cv), output(_output), options(_options),
+  module(MY_CXT.module), fpm(MY_CXT.function_pass_manager(options.opt_level)),
+  jit(MY_CXT.jit),
+  pa(*MY_CXT.pa), sp_state(sp_unloaded)
 {
   SET_CXT_MEMBER;
   SET_THX_MEMBER;
 }
 
 Emitter::Emitter(pTHX_ pMY_CXT_ const Emitter &other) :
-  cv(other.cv), ops(other.ops),
+  cv(other.cv), output(other.output), options(other.options),
   module(other.module), fpm(other.fpm),
-  execution_engine(other.execution_engine),
-  pa(other.pa)
+  jit(other.jit),
+  pa(other.pa), sp_state(sp_unloaded)
 {
   SET_CXT_MEMBER;
   SET_THX_MEMBER;
@@ -210,60 +1155,58 @@ Emitter::~Emitter()
 bool
 Emitter::process_jit_candidates(const std::vector<Term *> &asts)
 {
-  std::deque<Term *> queue(asts.begin(), asts.end());
-
   error_message.clear();
-  while (queue.size()) {
-    Term *ast = queue.front();
-
-    queue.pop_front();
+  return visit(asts);
+}
 
-    switch (ast->get_type()) {
-    case pj_ttype_lexical:
-    case pj_ttype_variabledeclaration:
-    case pj_ttype_global:
-    case pj_ttype_constant:
-      continue;
-    case pj_ttype_statementsequence: {
-      const std::vector<Term *> &kids = ast->get_kids();
-      std::vector<Term *> seq;
-
-      for (size_t i = 0, max = kids.size(); i < max; ++i) {
-        Term *stmt = kids[i];
-
-        if (is_jittable(stmt)) {
-          seq.push_back(static_cast<Statement *>(stmt));
-        } else {
-          if (seq.size()) {
-            if (!jit_statement_sequence(seq))
-              return false;
-            seq.clear();
-          }
-
-          if (!process_jit_candidates(stmt->get_kids()))
-            return false;
-        }
-      }
+ASTVisitor::visit_control_t
+Emitter::visit_term_pre(Term *ast)
+{
+  switch (ast->get_type()) {
+  case pj_ttype_lexical:
+  case pj_ttype_variabledeclaration:
+  case pj_ttype_global:
+  case pj_ttype_constant:
+    return VISIT_SKIP;
+  case pj_ttype_statementsequence: {
+    std::vector<Term *> seq;
 
-      if (seq.size())
-        if (!jit_statement_sequence(seq))
-          return false;
+    for (size_t i = 0, max = ast->get_kid_count(); i < max; ++i) {
+      Term *stmt = ast->get_kid(i);
 
-      break;
-    }
-    default:
-      if (is_jittable(ast)) {
-        jit_tree(ast);
+      if (is_jittable(stmt)) {
+        seq.push_back(static_cast<Statement *>(stmt));
       } else {
-        const std::vector<Term *> &kids = ast->get_kids();
+        if (seq.size()) {
+          if (!jit_statement_sequence(seq))
+            return VISIT_ABORT;
+          seq.clear();
+        }
 
-        queue.insert(queue.begin(), kids.begin(), kids.end());
+        if (!visit_kids(stmt))
+          return VISIT_ABORT;
       }
-      break;
     }
+
+    if (seq.size())
+      if (!jit_statement_sequence(seq))
+        return VISIT_ABORT;
+
+    return VISIT_SKIP;
   }
+  default:
+    if (is_jittable(ast)) {
+      jit_tree(ast);
+      return VISIT_SKIP;
+    }
 
-  return true;
+    // statements just forward the reason of their kid, which is
+    // recorded when it's visited
+    if (ast->get_type() != pj_ttype_statement)
+      record_bailout(jittability(ast), ast);
+
+    return VISIT_CONT;
+  }
 }
 
 bool
@@ -295,30 +1238,169 @@ Emitter::jit_statement_sequence(const std::vector<Term *> &asts)
   return true;
 }
 
+// Names regions after their position in the source, so they can be
+// recognized in profiles: "main::foo [foo.pl:12] #0"
+static std::string
+region_name(pTHX_ CV *cv, const COP *cop, size_t index)
+{
+  std::ostringstream name;
+  GV *gv = CvGV(cv);
+
+  if (gv && GvSTASH(gv) && HvNAME(GvSTASH(gv)))
+    name << HvNAME(GvSTASH(gv)) << "::" << GvNAME(gv);
+  else
+    name << "__ANON__";
+  if (cop)
+    name << " [" << CopFILE(cop) << ":" << CopLINE(cop) << "]";
+  name << " #" << index;
+
+  return name.str();
+}
+
 OP *
 Emitter::_jit_trees(const std::vector<Term *> &asts)
 {
-  Function *f = Function::Create(pa.ppaddr_type(), GlobalValue::ExternalLinkage, "", module);
+  const COP *cop = region_cop(CvROOT(cv), asts[0]->get_perl_op());
+  std::string name = region_name(aTHX_ cv, cop, output->regions++);
+  Function *f = Function::Create(pa.ppaddr_type(), GlobalValue::ExternalLinkage, name, module);
   BasicBlock *bb = BasicBlock::Create(module->getContext(), "entry", f);
 
   pa.set_current_function(f);
   MY_CXT.builder.SetInsertPoint(bb);
+  sp_state = sp_unloaded;
+  find_region_locals(asts);
+
+  bool tier_up = options.tier_up_calls && options.opt_level < pj_opt_aggressive;
+  if (tier_up)
+    _jit_emit_tier_up_check();
+
+  // tier-up needs the count of active calls as well, to know when
+  // the code it replaces can be freed
+  GlobalVariable *last_use = NULL, *active = NULL;
+  if (options.track_use || tier_up)
+    _jit_emit_use_tracking(last_use, active);
+
+  GlobalVariable *calls = NULL, *cycles = NULL;
+  Value *start = NULL;
+  if (options.profile != pj_profile_none)
+    _jit_emit_profile(calls, cycles, start);
+
+  MDNode *debug_scope = NULL;
+  std::ostringstream lines;
+  if (options.debug_info)
+    debug_scope = _jit_emit_debug_scope(name, cop);
+
+  // values returned to the interpreter are pushed without checking
+  // the stack size each time
+  if (size_t stack_depth = region_stack_depth(asts)) {
+    _jit_load_sp();
+    pa.emit_EXTEND(pa.IV_constant(stack_depth));
+  }
 
   bool valid = true;
-  for (size_t i = 0, max = asts.size(); i < max && valid; ++i)
+  for (size_t i = 0, max = asts.size(); i < max && valid; ++i) {
+    // each statement of the region gets its own line
+    if (debug_scope) {
+      const COP *statement = region_cop(CvROOT(cv), asts[i]->get_perl_op());
+      unsigned int line = statement ? CopLINE(statement) : 0;
+
+      lines << line << ",";
+      MY_CXT.builder.SetCurrentDebugLocation(DebugLoc::get(line, 0, debug_scope));
+    }
     valid = valid && _jit_emit_root(asts[i]);
+  }
 
-  MY_CXT.builder.CreateRet(pa.emit_OP_op_next());
+  _jit_store_sp();
+  Value *next = pa.emit_OP_op_next();
+  if (active)
+    _jit_emit_use_tracking_exit(active);
+  if (cycles)
+    _jit_emit_profile_exit(cycles, start);
+  MY_CXT.builder.CreateRet(next);
+  MY_CXT.builder.SetCurrentDebugLocation(DebugLoc());
 
   if (!valid) {
+    // together with its op slots and counters
+    erase_function(f);
     subtrees.clear();
+    op_slots.clear();
+    region_locals.clear();
     return NULL;
   }
 
+  MY_CXT.tbaa->annotate(f);
+
   // f->dump();
   verifyFunction(*f);
-  fpm->run(*f);
-  // f->dump();
+
+  Module *unit = output->unit->module;
+  std::vector<GlobalVariable *> slots;
+  std::string cache_key;
+  bool cached = false;
+
+  for (size_t i = 0, max = op_slots.size(); i < max; ++i)
+    slots.push_back(op_slots[i].first);
+  if (last_use) {
+    slots.push_back(last_use);
+    slots.push_back(active);
+  }
+  if (calls)
+    slots.push_back(calls);
+  if (cycles)
+    slots.push_back(cycles);
+
+  if (options.cache) {
+    std::ostringstream settings;
+    std::vector<GlobalVariable *> cached_slots;
+
+    settings << "opt_level=" << options.opt_level
+             << " tier_up_calls=" << options.tier_up_calls
+             << " track_use=" << options.track_use
+             << " profile=" << options.profile
+             << " debug_info=" << options.debug_info;
+    // the AST does not include line numbers
+    if (debug_scope)
+      settings << " file=" << (cop ? CopFILE(cop) : "") << " lines=" << lines.str();
+    Function *cached_f;
+    {
+      PhaseTimer timer(pj_phase_cache);
+
+      cache_key = CodeCache::region_key(aTHX_ cv, asts, settings.str());
+      cached_f = options.cache->load(cache_key, unit, cached_slots);
+    }
+
+    // the cached code is already optimized, and replaces the one just
+    // emitted
+    if (cached_f) {
+      if (cached_slots.size() == slots.size()) {
+        erase_function(f);
+        f = cached_f;
+        f->setName(name);
+        slots = cached_slots;
+        cached = true;
+      } else
+        erase_function(cached_f);
+    }
+  }
+
+  // the function was emitted using the declarations in the main
+  // module, move it to the compilation unit so it can be freed
+  if (!cached) {
+    Function *moved;
+
+    {
+      ValueToValueMapTy vmap;
+
+      moved = pj_clone_function_into(f, unit, name, vmap);
+      for (size_t i = 0, max = slots.size(); i < max; ++i)
+        slots[i] = cast<GlobalVariable>(vmap[slots[i]]);
+    }
+
+    erase_function(f);
+    f = moved;
+  }
+
+  MY_CXT.map_declarations(unit);
 
   // here it'd be nice to use custom ops, but they are registered by
   // PP function address; we could use a trampoline address (with
@@ -334,7 +1416,7 @@ Emitter::_jit_trees(const std::vector<Term *> &asts)
     listop->op_type = JIT_LIST_OP;
     listop->op_flags = OPf_KIDS;
     listop->op_first = listop->op_last = subtrees[0];
-    listop->execution_engine = execution_engine;
+    listop->unit = output->unit;
 
     for (size_t i = 1, max = subtrees.size(); i < max; ++i) {
       OP *sibling = subtrees[i];
@@ -351,7 +1433,7 @@ Emitter::_jit_trees(const std::vector<Term *> &asts)
       new (scalarop) ScalarOP();
 
       scalarop->op_type = JIT_SCALAR_OP;
-      scalarop->execution_engine = execution_engine;
+      scalarop->unit = output->unit;
 
       op = (OP *) scalarop;
   }
@@ -360,23 +1442,187 @@ Emitter::_jit_trees(const std::vector<Term *> &asts)
   jit_ops.insert(op);
   MUTEX_UNLOCK(jit_ops_mutex);
 
-  op->op_ppaddr = (OP *(*)(pTHX)) execution_engine->getPointerToFunction(f);
   op->op_targ = asts.back()->get_perl_op()->op_targ;
 
+  Region *region = jit_op_region(op);
+
+  region->function = f;
+  region->opt_level = options.opt_level;
+  region->module = unit;
+  region->slots = slots;
+  region->track_use = last_use != NULL;
+  region->profile = options.profile;
+  region->cv = cv;
+  region->cop = cop;
+  region->name = name;
+  for (size_t i = 0, max = op_slots.size(); i < max; ++i)
+    region->ops.push_back(op_slots[i].second);
+  region->ir_size = ir_size_estimate(f);
+  ir_bytes += region->ir_size;
+  bind_region_slots(aTHX_ aMY_CXT_ region);
+
+  shared_ptr<CompileJob> job(new CompileJob(f, cached ? NULL : fpm, op));
+
+  if (options.cache && !cached) {
+    job->cache = options.cache;
+    job->cache_key = cache_key;
+    job->slots = slots;
+  }
+
+  region->job = job;
+  if (options.lazy) {
+    op->op_ppaddr = pj_pp_compile_lazily;
+  } else if (options.async) {
+    output->jobs.push_back(job);
+    MY_CXT.compile_queue->enqueue(job);
+  } else {
+    CompileQueue::compile(jit.get(), job.get());
+    MY_CXT.compile_queue->mark_done(job);
+  }
+
   subtrees.clear();
+  op_slots.clear();
+  region_locals.clear();
 
   return op;
 }
 
+// Records the current epoch as the last use of the region, and counts
+// the active calls, for the code budget
+void
+Emitter::_jit_emit_use_tracking(GlobalVariable *&last_use, GlobalVariable *&active)
+{
+  IRBuilder<> &builder = MY_CXT.builder;
+  llvm::Type *uv_type = pa.UV_constant(0)->getType();
+
+  last_use = new GlobalVariable(
+    *module, uv_type, false, GlobalValue::InternalLinkage,
+    pa.UV_constant(0), "last_use");
+  active = new GlobalVariable(
+    *module, uv_type, false, GlobalValue::InternalLinkage,
+    pa.UV_constant(0), "active");
+
+  builder.CreateStore(builder.CreateLoad(MY_CXT.epoch), last_use);
+  builder.CreateStore(builder.CreateAdd(builder.CreateLoad(active), pa.UV_constant(1)), active);
+}
+
+void
+Emitter::_jit_emit_use_tracking_exit(GlobalVariable *active)
+{
+  IRBuilder<> &builder = MY_CXT.builder;
+
+  builder.CreateStore(builder.CreateSub(builder.CreateLoad(active), pa.UV_constant(1)), active);
+}
+
+// Debug info scope for the statements of a region, used by JIT event
+// listeners to map machine code back to source lines
+MDNode *
+Emitter::_jit_emit_debug_scope(const std::string &name, const COP *cop)
+{
+  DIBuilder debug_info(*module);
+  const char *file = cop ? CopFILE(cop) : "";
+  unsigned int line = cop ? CopLINE(cop) : 0;
+  bool optimized = options.opt_level != pj_opt_none;
+
+  debug_info.createCompileUnit(dwarf::DW_LANG_lo_user, file, "", "Perl::JIT",
+                               optimized, "", 0);
+
+  DIFile debug_file = debug_info.createFile(file, "");
+  DISubprogram scope = debug_info.createFunction(
+    debug_file, name, name, debug_file, line,
+    debug_info.createSubroutineType(debug_file, debug_info.getOrCreateArray(ArrayRef<Value *>())),
+    false, true, line, 0, optimized);
+
+  debug_info.finalize();
+  // the compile unit list would only grow: instructions keep their
+  // scope alive
+  if (NamedMDNode *units = module->getNamedMetadata("llvm.dbg.cu"))
+    module->eraseNamedMetadata(units);
+
+  return scope;
+}
+
+// Counts the executions of the region and, for pj_profile_cycles,
+// reads the cycle counter on entry; the counters are not atomic, so
+// they are approximate when several threads run the same code
+void
+Emitter::_jit_emit_profile(GlobalVariable *&calls, GlobalVariable *&cycles, Value *&start)
+{
+  IRBuilder<> &builder = MY_CXT.builder;
+  llvm::Type *uv_type = pa.UV_constant(0)->getType();
+
+  calls = new GlobalVariable(
+    *module, uv_type, false, GlobalValue::InternalLinkage,
+    pa.UV_constant(0), "calls");
+  builder.CreateStore(builder.CreateAdd(builder.CreateLoad(calls), pa.UV_constant(1)), calls);
+
+  if (options.profile < pj_profile_cycles)
+    return;
+
+  cycles = new GlobalVariable(
+    *module, uv_type, false, GlobalValue::InternalLinkage,
+    pa.UV_constant(0), "cycles");
+  start = builder.CreateCall(Intrinsic::getDeclaration(module, Intrinsic::readcyclecounter));
+}
+
+// Adds the cycles elapsed since the region entry; code leaving the
+// region by croaking is not accounted
+void
+Emitter::_jit_emit_profile_exit(GlobalVariable *cycles, Value *start)
+{
+  IRBuilder<> &builder = MY_CXT.builder;
+  llvm::Type *uv_type = pa.UV_constant(0)->getType();
+  Value *end = builder.CreateCall(Intrinsic::getDeclaration(module, Intrinsic::readcyclecounter));
+  Value *elapsed = builder.CreateZExtOrTrunc(builder.CreateSub(end, start), uv_type);
+
+  builder.CreateStore(builder.CreateAdd(builder.CreateLoad(cycles), elapsed), cycles);
+}
+
+// Counts executions of the region, and calls pj_jit_tier_up() once it
+// becomes hot (until the new code is installed); the call is rare, so
+// it is laid out after the body
+void
+Emitter::_jit_emit_tier_up_check()
+{
+  IRBuilder<> &builder = MY_CXT.builder;
+  llvm::Type *counter_type = pa.UV_constant(0)->getType();
+  GlobalVariable *counter = new GlobalVariable(
+    *module, counter_type, false, GlobalValue::InternalLinkage,
+    pa.UV_constant(0), "tier_up_counter");
+  BasicBlock *hot = BasicBlock::Create(module->getContext(), "tier_up", builder.GetInsertBlock()->getParent());
+  BasicBlock *body = BasicBlock::Create(module->getContext(), "body", builder.GetInsertBlock()->getParent());
+
+  Value *count = builder.CreateAdd(builder.CreateLoad(counter), pa.UV_constant(1));
+  builder.CreateStore(count, counter);
+  MDNode *weights = MDBuilder(module->getContext()).createBranchWeights(
+    1, (uint32_t) std::min(options.tier_up_calls, (UV) 0xffffffff));
+  builder.CreateCondBr(
+    builder.CreateICmpUGE(count, pa.UV_constant(options.tier_up_calls)),
+    hot, body, weights);
+
+  builder.SetInsertPoint(hot);
+  pa.emit_call_helper(MY_CXT.tier_up);
+  builder.CreateBr(body);
+
+  builder.SetInsertPoint(body);
+}
+
 bool
 Emitter::_jit_emit_root(Term *ast)
 {
+  // the statements of a sequence are emitted inline, so the values of
+  // region-local variables can flow between them
+  if (ast->get_type() == pj_ttype_statement)
+    return _jit_emit_root(static_cast<Statement *>(ast)->kids[0]);
+
   EmitValue jv = _jit_emit(ast, ast->get_perl_op()->op_targ ? &ANY_T : &SCALAR_T);
 
   if (jv.is_invalid())
     return false;
   if (jv.value)
     return _jit_emit_return(ast, ast->context(), jv.value, jv.type);
+
+  return true;
 }
 
 EmitValue
@@ -386,15 +1632,26 @@ Emitter::_jit_emit(Term *ast, const PerlJIT::AST::Type *type)
   case pj_ttype_constant:
     return _jit_emit_const(static_cast<PerlJIT::AST::Constant *>(ast), type);
   case pj_ttype_lexical:
-    return _jit_get_lexical_sv(static_cast<Lexical *>(ast));
+    if (Value *slot = region_local_slot(ast))
+      return _jit_get_region_local(slot, ast->get_value_type());
+    return _jit_get_lexical_sv(static_cast<Lexical *>(ast), type);
   case pj_ttype_variabledeclaration:
+    if (Value *slot = region_local_slot(ast))
+      return _jit_get_region_local(slot, ast->get_value_type());
     return _jit_get_lexical_declaration_sv(static_cast<VariableDeclaration *>(ast));
-  case pj_ttype_op:
-    if (is_jittable(ast))
+  case pj_ttype_op: {
+    pj_bailout_reason reason = jittability(ast);
+
+    if (reason == pj_bailout_none)
       return _jit_emit_op(static_cast<Op *>(ast), type);
-    else
-      return _jit_emit_optree_jit_kids(ast, type);
+    record_bailout(reason, ast);
+    if (is_directly_callable(static_cast<Op *>(ast)))
+      return _jit_emit_direct_call(static_cast<Op *>(ast), type);
+    return _jit_emit_optree_jit_kids(ast, type);
+  }
   default:
+    if (ast->get_type() != pj_ttype_statement)
+      record_bailout(jittability(ast), ast);
     return _jit_emit_optree_jit_kids(ast, type);
   }
 }
@@ -414,34 +1671,147 @@ EmitValue
 Emitter::_jit_emit_optree_jit_kids(Term *ast, const PerlJIT::AST::Type *type)
 {
   Emitter emitter(aTHX_ aMY_CXT_ *this);
+  // the kids can be JITted as regions of their own
+  IRBuilderBase::InsertPoint insert_point = MY_CXT.builder.saveIP();
+  DebugLoc debug_location = MY_CXT.builder.getCurrentDebugLocation();
+  Snippets::FunctionState function_state = pa.get_function_state();
+  bool kids_ok = emitter.visit_kids(ast);
+
+  pa.restore_function_state(function_state);
+  MY_CXT.builder.restoreIP(insert_point);
+  MY_CXT.builder.SetCurrentDebugLocation(debug_location);
+  if (!kids_ok)
+    return EmitValue::invalid();
+  return _jit_emit_optree(ast, type);
+}
+
+// Simple unary/binary ops the JIT can't emit, whose operands are all
+// on the Perl stack when the op runs: those can be executed by calling
+// their pp function directly, with operands computed by JITted code,
+// instead of running their subtree in the interpreter
+bool
+Emitter::is_directly_callable(Op *ast)
+{
+  OP *o = ast->get_perl_op();
+
+  if (ast->op_class() != pj_opc_unop && ast->op_class() != pj_opc_binop)
+    return false;
+  if (ast->return_type() == pj_ret_any ||
+      ast->evaluates_kids_conditionally() ||
+      ast->context() != pj_context_scalar ||
+      (o->op_flags & OPf_STACKED) || !(o->op_flags & OPf_KIDS))
+    return false;
+  if (ast->op_class() == pj_opc_binop &&
+      static_cast<Binop *>(ast)->is_assignment_form())
+    return false;
+
+  // the operands must map 1:1 to the Perl kids, with nothing the
+  // interpreter would evaluate in between
+  OP *kid = cUNOPx(o)->op_first;
+  size_t count = ast->get_kid_count();
+
+  for (size_t i = 0; i < count; ++i, kid = kid->op_sibling) {
+    Term *term = ast->get_kid(i);
+
+    if (!kid || !term || kid->op_type == OP_NULL || term->get_perl_op() != kid)
+      return false;
+    switch (term->get_type()) {
+    case pj_ttype_constant:
+      break;
+    case pj_ttype_lexical:
+    case pj_ttype_variabledeclaration:
+      if (static_cast<Identifier *>(term)->sigil != pj_sigil_scalar)
+        return false;
+      break;
+    case pj_ttype_op:
+      if (term->context() != pj_context_scalar)
+        return false;
+      break;
+    default:
+      return false;
+    }
+  }
+
+  return kid == NULL;
+}
+
+EmitValue
+Emitter::_jit_emit_direct_call(Op *ast, const PerlJIT::AST::Type *type)
+{
+  OP *o = ast->get_perl_op();
+  size_t count = ast->get_kid_count();
+  std::vector<Value *> operands;
+
+  for (size_t i = 0; i < count; ++i) {
+    Term *kid = ast->get_kid(i);
+
+    if (kid->get_type() == pj_ttype_constant) {
+      operands.push_back(pa.emit_cSVOPx_sv(_jit_load_op(kid->get_perl_op())));
+      continue;
+    }
+
+    EmitValue value = _jit_emit(kid, &SCALAR_T);
+    if (value.is_invalid())
+      return EmitValue::invalid();
+
+    // the SV the kid produced is pushed as is (the op_targ of the kid
+    // is not always its TARG, e.g. for aelemfast it's the array), only
+    // native values need an SV
+    Value *sv = _jit_result_sv(kid, value.value, value.type);
+    if (!sv)
+      return EmitValue::invalid();
+    operands.push_back(sv);
+  }
 
-  if (!emitter.process_jit_candidates(ast->get_kids()))
-    return EmitValue::invalid();
-  return _jit_emit_optree(ast);
+  // the space was reserved on region entry
+  _jit_load_sp();
+  for (size_t i = 0; i < count; ++i)
+    pa.emit_PUSHs(operands[i]);
+  sp_state = sp_modified;
+  _jit_store_sp();
+
+  // the kids are never executed, but the op still needs them (and
+  // its TARG) to be alive
+  detach_tree(o, true);
+  subtrees.push_back(o);
+  pa.emit_CALL_PPADDR(_jit_load_op(o));
+  sp_state = sp_unloaded;
+
+  _jit_load_sp();
+  Value *res = pa.emit_POPs();
+  sp_state = sp_modified;
+
+  return _jit_opaque_result(ast, res, type);
 }
 
 bool
 Emitter::is_jittable(PerlJIT::AST::Term *ast)
+{
+  return jittability(ast) == pj_bailout_none;
+}
+
+pj_bailout_reason
+Emitter::jittability(PerlJIT::AST::Term *ast)
 {
   switch (ast->get_type()) {
   case pj_ttype_constant:
   case pj_ttype_lexical:
   case pj_ttype_variabledeclaration:
-    return true;
+    return pj_bailout_none;
   case pj_ttype_optree:
-    return false;
+    return pj_bailout_optree;
   case pj_ttype_statement:
-    return is_jittable(static_cast<PerlJIT::AST::Statement *>(ast)->kids[0]);
+    return jittability(static_cast<PerlJIT::AST::Statement *>(ast)->kids[0]);
   case pj_ttype_statementsequence: {
-    std::vector<Term *> all = ast->get_kids();
+    size_t count = ast->get_kid_count();
     unsigned int jittable = 0;
 
-    for (size_t i = 0, max = all.size(); i < max; ++i)
-      jittable += is_jittable(all[i]);
+    for (size_t i = 0; i < count; ++i)
+      jittable += is_jittable(ast->get_kid(i));
 
     // TODO arbitrary threshold, it's probably better to look for
     //      long stretches of JITtable ops
-    return jittable * 2 >= all.size();
+    return jittable * 2 >= count ? pj_bailout_none : pj_bailout_sparse_sequence;
 
   }
   case pj_ttype_op: {
@@ -449,103 +1819,125 @@ Emitter::is_jittable(PerlJIT::AST::Term *ast)
     bool known = Jittable_Ops.find(op->get_op_type()) != Jittable_Ops.end();
 
     if (!known)
-      return false;
+      return pj_bailout_unknown_op;
+    if (op->get_op_type() == pj_binop_sassign)
+      return assignment_jittability(static_cast<Binop *>(op));
     if (op->may_have_explicit_overload())
-      return true;
-    if (op->op_class() == pj_opc_binop &&
-        static_cast<Binop *>(op)->is_synthesized_assignment())
-      return is_jittable(op->kids[1]);
-    return !needs_excessive_magic(op);
+      return pj_bailout_none;
+    return needs_excessive_magic(op) ? pj_bailout_opaque_operand : pj_bailout_none;
   }
   default:
-    return false;
+    return pj_bailout_unsupported_term;
   }
 }
 
-bool
-Emitter::needs_excessive_magic(PerlJIT::AST::Op *ast)
+// Scalar assignments to lexicals, of values that can be JITted; in a
+// synthesized assignment (OPpTARGET_MY) the op itself writes its
+// target, so only the value matters
+pj_bailout_reason
+Emitter::assignment_jittability(Binop *ast)
 {
-  std::deque<Term *> nodes(1, ast);
-
-  while (nodes.size()) {
-    Term *node = nodes.front();
-    nodes.pop_front();
+  Term *target = ast->kids[0], *value = ast->kids[1];
+
+  if (!ast->is_synthesized_assignment()) {
+    if (target->get_type() != pj_ttype_lexical &&
+        target->get_type() != pj_ttype_variabledeclaration)
+      return pj_bailout_unsupported_assignment;
+    if (target->get_value_type()->is_opaque())
+      return pj_bailout_opaque_operand;
+    if (value->get_type() == pj_ttype_constant &&
+        !value->get_value_type()->is_numeric())
+      return pj_bailout_unsupported_constant;
+    if (value->get_type() == pj_ttype_lexical &&
+        value->get_value_type()->is_opaque())
+      return pj_bailout_opaque_operand;
+  }
 
-    if ((node->get_type() == pj_ttype_lexical || node->get_type() == pj_ttype_variabledeclaration) &&
-            node->get_value_type()->is_opaque())
-      return true;
+  return jittability(value);
+}
 
-    if (node->get_type() != pj_ttype_op)
-      continue;
-    Op *op = static_cast<Op *>(node);
+bool
+Emitter::needs_excessive_magic(PerlJIT::AST::Op *ast)
+{
+  return magic_operand_finder.has_magic_operand(ast);
+}
 
-    bool known = Jittable_Ops.find(op->get_op_type()) != Jittable_Ops.end();
+ASTVisitor::visit_control_t
+MagicOperandFinder::visit_term_pre(Term *node)
+{
+  if ((node->get_type() == pj_ttype_lexical || node->get_type() == pj_ttype_variabledeclaration) &&
+          node->get_value_type()->is_opaque())
+    return VISIT_ABORT;
 
-    if (!known || !op->may_have_explicit_overload())
-      continue;
+  if (node->get_type() != pj_ttype_op)
+    return VISIT_SKIP;
+  Op *op = static_cast<Op *>(node);
 
-    std::vector<Term *> kids = node->get_kids();
-    nodes.insert(nodes.end(), kids.begin(), kids.end());
-  }
+  bool known = Jittable_Ops.find(op->get_op_type()) != Jittable_Ops.end();
 
-  return false;
+  return known && op->may_have_explicit_overload() ? VISIT_CONT : VISIT_SKIP;
 }
 
-void
-Emitter::_jit_clear_op_next(OP *op)
+Value *
+Emitter::_jit_load_op(OP *op)
 {
-  // in most cases, the exit point for an optree is the op_next
-  // pointer of the root op, but conditional operators have interesting
-  // control flows
-  switch (op->op_type) {
-  case OP_COND_EXPR: {
-    LOGOP *logop = cLOGOPx(op);
+  GlobalVariable *slot = new GlobalVariable(
+    *module, pa.op_type(), false, GlobalValue::InternalLinkage,
+    ConstantPointerNull::get(cast<PointerType>(pa.op_type())), "op_slot");
 
-    _jit_clear_op_next(logop->op_first->op_sibling);
-    _jit_clear_op_next(logop->op_first->op_sibling->op_sibling);
-  }
-    break;
-  case OP_AND:
-  case OP_ANDASSIGN:
-  case OP_OR:
-  case OP_ORASSIGN:
-  case OP_DOR:
-  case OP_DORASSIGN: {
-    LOGOP *logop = cLOGOPx(op);
+  op_slots.push_back(std::make_pair(slot, op));
 
-    _jit_clear_op_next(logop->op_first->op_sibling);
-    op->op_next = NULL;
-  }
-    break;
-  default:
-    op->op_next = NULL;
-    break;
-  }
+  return MY_CXT.builder.CreateLoad(slot);
 }
 
 EmitValue
-Emitter::_jit_emit_optree(Term *ast)
+Emitter::_jit_emit_optree(Term *ast, const PerlJIT::AST::Type *type)
 {
   // unfortunately there is (currently) no way to clone an optree,
   // so just detach the ops from the root tree
   detach_tree(ast->get_perl_op(), true);
-  _jit_clear_op_next(ast->get_perl_op());
+  output->exits.push_back(ast->get_perl_op());
   subtrees.push_back(ast->get_perl_op());
 
-  pa.emit_call_runloop(ast->start_op());
+  // the subtree runs on the Perl stack, and leaves its result there
+  _jit_store_sp();
+  pa.emit_call_runloop(_jit_load_op(ast->start_op()));
+  sp_state = sp_unloaded;
 
   if (ast->context() == pj_context_caller) {
-    set_error("Caller-determined context not implemented");
+    set_error(pj_bailout_caller_context, ast, "Caller-determined context not implemented");
     return EmitValue::invalid();
   }
   if (ast->context() != pj_context_scalar)
     return EmitValue(NULL, NULL);
 
-  pa.alloc_sp();
+  _jit_load_sp();
   llvm::Value *res = pa.emit_POPs();
-  pa.emit_PUTBACK();
+  sp_state = sp_modified;
+
+  return _jit_opaque_result(ast, res, type);
+}
+
+// The result of an op executed by the interpreter; when the op always
+// returns a plain number, and the consumer does not need the SV, the
+// value is read without invoking magic and passed on natively
+EmitValue
+Emitter::_jit_opaque_result(Term *ast, Value *sv, const PerlJIT::AST::Type *type)
+{
+  Op *op = dynamic_cast<Op *>(ast);
+
+  if (!op || op->may_have_explicit_overload() ||
+      !type || type->equals(&SCALAR_T) || type->equals(&ANY_T))
+    return EmitValue(sv, &SCALAR_T);
 
-  return EmitValue(res, &SCALAR_T);
+  switch (op->return_type()) {
+  case pj_ret_integer:
+    return EmitValue(pa.emit_SvIV_nomg(sv), &INT_T);
+  case pj_ret_double:
+    return EmitValue(pa.emit_SvNV_nomg(sv), &DOUBLE_T);
+  default:
+    return EmitValue(sv, &SCALAR_T);
+  }
 }
 
 bool
@@ -556,88 +1948,418 @@ Emitter::_jit_emit_return(Term *ast, pj_op_context context, Value *value, const
   // below
 
   if (context == pj_context_caller) {
-    set_error("Caller-determined context not implemented");
+    set_error(pj_bailout_caller_context, ast, "Caller-determined context not implemented");
     return false;
   }
 
   if (context != pj_context_scalar)
     return true;
 
-  Op *op = dynamic_cast<Op *>(ast);
-  Value *res;
-
-  switch (op->op_class()) {
-  case pj_opc_binop: {
-    // the assumption here is that the OPf_STACKED assignment
-    // has been handled by _jit_emit below, and here we only need
-    // to handle cases like '$x = $y += 7'
-    if (op->get_op_type() == pj_binop_sassign) {
-      if (type->equals(&SCALAR_T)) {
-        res = value;
-      } else {
-        // TODO suboptimal, but correct, need to ask for SCALAR
-        // in the call to _jit_emit() above
-        res = pa.emit_sv_newmortal();
-      }
-    } else {
-      if (!op->get_perl_op()->op_targ && type->equals(&SCALAR_T)) {
-        res = value;
-      } else {
-        if (!op->get_perl_op()->op_targ) {
-          set_error("Binary OP without target");
-          return false;
-        }
-        res = pa.emit_OP_targ();
-      }
-    }
+  Value *res = _jit_result_sv(ast, value, type);
+  if (!res)
+    return false;
+
+  // the space was reserved on region entry
+  _jit_load_sp();
+  pa.emit_PUSHs(res);
+  sp_state = sp_modified;
+
+  return true;
+}
+
+// The SV holding the result of ast for the interpreter: value itself
+// when it is an SV, otherwise the SV perl would store it in
+Value *
+Emitter::_jit_result_sv(Term *ast, Value *value, const PerlJIT::AST::Type *type)
+{
+  if (type->equals(&SCALAR_T))
+    return value;
+
+  Value *res = _jit_emit_home_sv(ast);
+
+  if (!res || !_jit_assign_sv(res, value, type))
+    return NULL;
+
+  return res;
+}
+
+// The SV perl itself keeps the value of ast in: the pad entry of a
+// lexical (region-local ones still have it, unused), the TARG of an op
+// or the target of an assignment; unlike new pad entries, these exist
+// in every clone of a closure and in the pads of recursive calls
+Value *
+Emitter::_jit_emit_home_sv(Term *ast)
+{
+  switch (ast->get_type()) {
+  case pj_ttype_lexical:
+    return pa.emit_pad_sv(static_cast<Lexical *>(ast)->get_pad_index());
+  case pj_ttype_variabledeclaration:
+    return pa.emit_pad_sv(static_cast<VariableDeclaration *>(ast)->get_pad_index());
+  case pj_ttype_op: {
+    Op *op = static_cast<Op *>(ast);
+    OP *o = op->get_perl_op();
+
+    if (op->get_op_type() == pj_binop_sassign)
+      return _jit_emit_home_sv(op->get_kid(0));
+    if (o->op_targ && (PL_opargs[o->op_type] & (OA_TARGET | OA_TARGLEX)))
+      return pa.emit_pad_sv(o->op_targ);
+    break;
   }
-  case pj_opc_unop:
-    if (!op->get_perl_op()->op_targ) {
-      set_error("Unary OP without target");
-      return false;
-    }
-    res = pa.emit_OP_targ();
   default:
-    res = pa.emit_sv_newmortal();
     break;
   }
 
-  if (res != value)
-    if (!_jit_assign_sv(res, value, type))
-      return false;
+  set_error(pj_bailout_missing_target, ast, "No SV to store the result in");
+  return NULL;
+}
+
+// Number of values the region pushes on the Perl stack: one for each
+// root in scalar context, plus the operands of direct calls on top of
+// them (the values computed by subtrees are popped right away)
+size_t
+Emitter::region_stack_depth(const std::vector<Term *> &asts)
+{
+  size_t depth = 0, calls = 0;
+
+  for (size_t i = 0, max = asts.size(); i < max; ++i) {
+    Term *root = asts[i];
+
+    if (root->get_type() == pj_ttype_statement)
+      root = static_cast<Statement *>(root)->kids[0];
+    calls = std::max(calls, depth + direct_call_depth(root));
+    if (root->context() == pj_context_scalar)
+      ++depth;
+  }
+
+  return std::max(depth, calls);
+}
+
+// Operands of the widest direct call in the code emitted for ast: a
+// call pops its operands before the next one pushes its own
+size_t
+Emitter::direct_call_depth(Term *ast)
+{
+  if (ast->get_type() != pj_ttype_op)
+    return 0;
+
+  Op *op = static_cast<Op *>(ast);
+  size_t depth = 0;
+
+  if (is_jittable(op)) {
+    if (op->op_class() != pj_opc_binop)
+      return 0;
+  } else if (is_directly_callable(op)) {
+    depth = op->get_kid_count();
+  } else {
+    return 0;
+  }
+
+  for (size_t i = 0, max = op->get_kid_count(); i < max; ++i)
+    if (Term *kid = op->get_kid(i))
+      depth = std::max(depth, direct_call_depth(kid));
+
+  return depth;
+}
+
+// The stack pointer is kept in a local variable (promoted to SSA values)
+// and only synchronized with PL_stack_sp around the code that uses the
+// Perl stack (subtrees run by the interpreter) and on region exit
+void
+Emitter::_jit_load_sp()
+{
+  if (sp_state != sp_unloaded)
+    return;
 
   pa.alloc_sp();
   pa.emit_SPAGAIN();
-  pa.emit_XPUSHs(res);
-  pa.emit_PUTBACK();
+  sp_state = sp_synced;
+}
 
-  return true;
+void
+Emitter::_jit_store_sp()
+{
+  if (sp_state != sp_modified)
+    return;
+
+  pa.emit_PUTBACK();
+  sp_state = sp_synced;
 }
 
 EmitValue
 Emitter::_jit_emit_binop(Binop *ast, const PerlJIT::AST::Type *type)
 {
-  EmitValue lv = _jit_emit(ast->kids[0], &DOUBLE_T);
+  if (ast->get_op_type() == pj_binop_sassign)
+    return _jit_emit_sassign(ast);
+
+  Value *slot = region_local_slot(ast->kids[0]);
+  // the left operand is read after evaluating the right one, like
+  // pp_add does, so it's requested as a scalar (region-local variables
+  // are only loaded then)
+  EmitValue lv = slot ? EmitValue(slot, ast->kids[0]->get_value_type()) :
+                        _jit_emit(ast->kids[0], &SCALAR_T);
   EmitValue rv = _jit_emit(ast->kids[1], &DOUBLE_T);
+  Value *target = NULL;
+
+  if (lv.is_invalid() || rv.is_invalid())
+    return EmitValue::invalid();
+  if (slot) {
+    lv = _jit_get_region_local(slot, lv.type);
+  } else {
+    if (ast->is_assignment_form()) {
+      // TODO proper LVALUE treatment
+      if (!lv.type->equals(&SCALAR_T)) {
+        set_error(pj_bailout_unsupported_assignment, ast,
+                  "Can only assign to perl scalars, got a " + lv.type->to_string());
+        return EmitValue::invalid();
+      }
+      target = lv.value;
+    }
+    if (ast->kids[0]->get_type() == pj_ttype_lexical)
+      lv = _jit_get_lexical_value(lv.value, ast->kids[0]->get_value_type());
+  }
+
+  // Int arithmetic only wraps around under 'use integer' or when the
+  // result goes to an Int variable; otherwise Int and untyped operands
+  // follow perl
+  bool wraps = ast->is_integer_variant() || type->equals(&INT_T) ||
+    (ast->is_assignment_form() && ast->kids[0]->get_value_type()->equals(&INT_T));
+  bool checked = !wraps &&
+    (lv.type->is_integer() || lv.type->equals(&SCALAR_T)) &&
+    (rv.type->is_integer() || rv.type->equals(&SCALAR_T));
+  EmitValue res = checked ?
+    _jit_emit_checked_arithmetic(ast, lv, rv, target) :
+    _jit_emit_arithmetic(ast->get_op_type(), lv, rv);
+
+  if (res.is_invalid())
+    return res;
+  if (slot && ast->is_assignment_form()) {
+    if (!_jit_assign_region_local(slot, res.value, res.type, ast->kids[0]->get_value_type()))
+      return EmitValue::invalid();
+  } else if (target && res.value != target && !_jit_assign_sv(target, res.value, res.type)) {
+    return EmitValue::invalid();
+  }
+
+  return res;
+}
+
+// Int operands give an Int result that wraps around on overflow (for
+// typed Int and 'use integer' code, see _jit_emit_binop), anything else
+// is computed as a Double
+EmitValue
+Emitter::_jit_emit_arithmetic(pj_op_type op_type, const EmitValue &lv, const EmitValue &rv)
+{
+  IRBuilder<> &builder = MY_CXT.builder;
+
+  if (lv.type->equals(&INT_T) && rv.type->equals(&INT_T)) {
+    switch (op_type) {
+    case pj_binop_add:
+      return EmitValue(builder.CreateAdd(lv.value, rv.value), &INT_T);
+    case pj_binop_subtract:
+      return EmitValue(builder.CreateSub(lv.value, rv.value), &INT_T);
+    case pj_binop_multiply:
+      return EmitValue(builder.CreateMul(lv.value, rv.value), &INT_T);
+    default:
+      break;
+    }
+  }
+
   Value *lvv = _to_nv_value(lv.value, lv.type),
         *rvv = _to_nv_value(rv.value, rv.type);
 
   if (!lvv || !rvv)
     return EmitValue::invalid();
 
-  Value *res = MY_CXT.builder.CreateFAdd(lvv, rvv);
+  switch (op_type) {
+  case pj_binop_add:
+    return EmitValue(builder.CreateFAdd(lvv, rvv), &DOUBLE_T);
+  case pj_binop_subtract:
+    return EmitValue(builder.CreateFSub(lvv, rvv), &DOUBLE_T);
+  case pj_binop_multiply:
+    return EmitValue(builder.CreateFMul(lvv, rvv), &DOUBLE_T);
+  default:
+    set_error(pj_bailout_unknown_op, NULL, "Unhandled arithmetic op");
+    return EmitValue::invalid();
+  }
+}
 
-  if (ast->is_assignment_form()) {
-    // TODO proper LVALUE treatment
-    if (!lv.type->equals(&SCALAR_T)) {
-      set_error("Can only assign to perl scalars, got a " + lv.type->to_string());
-      return EmitValue::invalid();
-    }
-    if (!_jit_assign_sv(lv.value, res, &DOUBLE_T))
+// Arithmetic with perl semantics on integer and untyped operands, as
+// in pp_add: IV arithmetic when both values are IVs, and when an
+// operand is a UV or the IV result overflows, a UV result if it is
+// positive and fits, an NV otherwise; NV arithmetic when an operand is
+// not an integer (SvNV loses the precision of integers above 2**53).
+// The result is written to the assignment target, or to the TARG of
+// the op, since its type is only known at runtime
+EmitValue
+Emitter::_jit_emit_checked_arithmetic(Binop *ast, const EmitValue &lv, const EmitValue &rv, Value *target)
+{
+  IRBuilder<> &builder = MY_CXT.builder;
+  LLVMContext &context = module->getContext();
+  pj_op_type op_type = ast->get_op_type();
+  Intrinsic::ID id;
+
+  switch (op_type) {
+  case pj_binop_add:
+    id = Intrinsic::sadd_with_overflow;
+    break;
+  case pj_binop_subtract:
+    id = Intrinsic::ssub_with_overflow;
+    break;
+  case pj_binop_multiply:
+    id = Intrinsic::smul_with_overflow;
+    break;
+  default:
+    return _jit_emit_arithmetic(op_type, lv, rv);
+  }
+
+  // with OPpTARGET_MY, the TARG is the lexical, as in the interpreter
+  Value *sv = target ? target : _jit_emit_home_sv(ast);
+
+  if (!sv)
+    return EmitValue::invalid();
+  Function *function = builder.GetInsertBlock()->getParent();
+  BasicBlock *int_operands = BasicBlock::Create(context, "int_operands", function);
+  BasicBlock *iv_operands = BasicBlock::Create(context, "iv_operands", function);
+  BasicBlock *no_overflow = BasicBlock::Create(context, "no_overflow", function);
+  BasicBlock *uv_operands = BasicBlock::Create(context, "uv_operands", function);
+  BasicBlock *iv_result = BasicBlock::Create(context, "iv_result", function);
+  BasicBlock *not_iv_result = BasicBlock::Create(context, "not_iv_result", function);
+  BasicBlock *uv_result = BasicBlock::Create(context, "uv_result", function);
+  BasicBlock *nv_operands = BasicBlock::Create(context, "nv_operands", function);
+  BasicBlock *done = BasicBlock::Create(context, "done", function);
+  MDNode *unlikely = MDBuilder(context).createBranchWeights(1, 1000);
+  Value *ints = NULL;
+
+  // like pp_add, this upgrades integral NVs and strings to IVs/UVs
+  if (lv.type->equals(&SCALAR_T))
+    ints = builder.CreateIsNotNull(pa.emit_SvIV_please(lv.value));
+  if (rv.type->equals(&SCALAR_T)) {
+    Value *rint = builder.CreateIsNotNull(pa.emit_SvIV_please(rv.value));
+
+    ints = ints ? builder.CreateAnd(ints, rint) : rint;
+  }
+  if (ints)
+    builder.CreateCondBr(ints, int_operands, nv_operands);
+  else
+    builder.CreateBr(int_operands);
+
+  builder.SetInsertPoint(int_operands);
+  Value *l = lv.type->equals(&SCALAR_T) ? pa.emit_SvIV_nomg(lv.value) : lv.value;
+  Value *r = rv.type->equals(&SCALAR_T) ? pa.emit_SvIV_nomg(rv.value) : rv.value;
+  Value *luv = lv.type->equals(&SCALAR_T) ?
+    builder.CreateIsNotNull(pa.emit_SvIsUV(lv.value)) :
+    builder.getInt1(lv.type->equals(&UNSIGNED_INT_T));
+  Value *ruv = rv.type->equals(&SCALAR_T) ?
+    builder.CreateIsNotNull(pa.emit_SvIsUV(rv.value)) :
+    builder.getInt1(rv.type->equals(&UNSIGNED_INT_T));
+  builder.CreateCondBr(builder.CreateOr(luv, ruv), uv_operands, iv_operands, unlikely);
+
+  builder.SetInsertPoint(iv_operands);
+  Function *intrinsic = Intrinsic::getDeclaration(module, id, l->getType());
+  Value *result = builder.CreateCall2(intrinsic, l, r);
+
+  // overflowing is the cold path
+  builder.CreateCondBr(
+    builder.CreateExtractValue(result, 1), uv_operands, no_overflow, unlikely);
+
+  builder.SetInsertPoint(no_overflow);
+  pa.emit_sv_setiv(sv, builder.CreateExtractValue(result, 0));
+  builder.CreateBr(done);
+
+  // the same operands, with the UV flags taken into account
+  builder.SetInsertPoint(uv_operands);
+  Value *res, *fits_iv, *fits_uv;
+
+  if (op_type == pj_binop_multiply) {
+    // sign and magnitude, as in pp_multiply
+    Value *zero = pa.IV_constant(0);
+    Value *lneg = builder.CreateAnd(builder.CreateNot(luv), builder.CreateICmpSLT(l, zero));
+    Value *rneg = builder.CreateAnd(builder.CreateNot(ruv), builder.CreateICmpSLT(r, zero));
+    Value *product = builder.CreateCall2(
+      Intrinsic::getDeclaration(module, Intrinsic::umul_with_overflow, l->getType()),
+      builder.CreateSelect(lneg, builder.CreateNeg(l), l),
+      builder.CreateSelect(rneg, builder.CreateNeg(r), r));
+    Value *magnitude = builder.CreateExtractValue(product, 0);
+    Value *overflow = builder.CreateExtractValue(product, 1);
+    Value *neg = builder.CreateXor(lneg, rneg);
+
+    res = builder.CreateSelect(neg, builder.CreateNeg(magnitude), magnitude);
+    // negative results fit down to IV_MIN, whose magnitude is IV_MAX + 1
+    fits_iv = builder.CreateAnd(
+      builder.CreateNot(overflow),
+      builder.CreateICmpULE(
+        magnitude, builder.CreateSelect(neg, pa.IV_constant(IV_MIN), pa.IV_constant(IV_MAX))));
+    fits_uv = builder.CreateAnd(builder.CreateNot(overflow), builder.CreateNot(neg));
+  } else {
+    // 65 bits are enough for the sum or difference of two 64-bit
+    // integers of either signedness
+    Type *wide_type = IntegerType::get(context, 128);
+    Value *wl = builder.CreateSelect(luv, builder.CreateZExt(l, wide_type),
+                                          builder.CreateSExt(l, wide_type));
+    Value *wr = builder.CreateSelect(ruv, builder.CreateZExt(r, wide_type),
+                                          builder.CreateSExt(r, wide_type));
+    Value *wide_res = op_type == pj_binop_add ? builder.CreateAdd(wl, wr) :
+                                                builder.CreateSub(wl, wr);
+
+    res = builder.CreateTrunc(wide_res, l->getType());
+    fits_iv = builder.CreateICmpEQ(builder.CreateSExt(res, wide_type), wide_res);
+    fits_uv = builder.CreateICmpEQ(builder.CreateZExt(res, wide_type), wide_res);
+  }
+  builder.CreateCondBr(fits_iv, iv_result, not_iv_result);
+
+  builder.SetInsertPoint(iv_result);
+  pa.emit_sv_setiv(sv, res);
+  builder.CreateBr(done);
+
+  builder.SetInsertPoint(not_iv_result);
+  builder.CreateCondBr(fits_uv, uv_result, nv_operands);
+
+  builder.SetInsertPoint(uv_result);
+  pa.emit_sv_setuv(sv, res);
+  builder.CreateBr(done);
+
+  builder.SetInsertPoint(nv_operands);
+  Value *ln = lv.type->equals(&SCALAR_T) ? pa.emit_SvNV_nomg(lv.value) : _to_nv_value(lv.value, lv.type);
+  Value *rn = rv.type->equals(&SCALAR_T) ? pa.emit_SvNV_nomg(rv.value) : _to_nv_value(rv.value, rv.type);
+  EmitValue nv = _jit_emit_arithmetic(op_type, EmitValue(ln, &DOUBLE_T), EmitValue(rn, &DOUBLE_T));
+  pa.emit_sv_setnv(sv, nv.value);
+  builder.CreateBr(done);
+
+  builder.SetInsertPoint(done);
+
+  return EmitValue(sv, &SCALAR_T);
+}
+
+EmitValue
+Emitter::_jit_emit_sassign(Binop *ast)
+{
+  Term *target = ast->kids[0];
+  Value *slot = region_local_slot(target);
+  // like pp_sassign, the value is computed before the target is
+  // fetched (and, for 'my $x', cleared at scope exit)
+  EmitValue value = _jit_emit(ast->kids[1], slot ? target->get_value_type() : &ANY_T);
+
+  if (value.is_invalid())
+    return value;
+
+  if (slot) {
+    if (!_jit_assign_region_local(slot, value.value, value.type, target->get_value_type()))
       return EmitValue::invalid();
+    return _jit_get_region_local(slot, target->get_value_type());
   }
 
-  return EmitValue(res, &DOUBLE_T);
+  EmitValue sv = _jit_emit(target, &SCALAR_T);
+
+  if (sv.is_invalid())
+    return sv;
+  if (!sv.type->equals(&SCALAR_T)) {
+    set_error(pj_bailout_unsupported_assignment, ast,
+              "Can only assign to perl scalars, got a " + sv.type->to_string());
+    return EmitValue::invalid();
+  }
+  if (!_jit_assign_sv(sv.value, value.value, value.type))
+    return EmitValue::invalid();
+
+  return sv;
 }
 
 EmitValue
@@ -653,10 +2375,28 @@ Emitter::_jit_get_lexical_declaration_sv(PerlJIT::AST::VariableDeclaration *ast)
 }
 
 EmitValue
-Emitter::_jit_get_lexical_sv(Lexical *ast)
+Emitter::_jit_get_lexical_sv(Lexical *ast, const PerlJIT::AST::Type *type)
 {
   // TODO this value can be cached
-  return EmitValue(pa.emit_pad_sv(ast->get_pad_index()), &SCALAR_T);
+  Value *sv = pa.emit_pad_sv(ast->get_pad_index());
+
+  if (type->equals(&SCALAR_T) || type->equals(&ANY_T))
+    return EmitValue(sv, &SCALAR_T);
+
+  return _jit_get_lexical_value(sv, ast->get_value_type());
+}
+
+// Lexicals declared or inferred as Int/Double have restricted
+// semantics: their value is read without invoking magic
+EmitValue
+Emitter::_jit_get_lexical_value(Value *sv, const PerlJIT::AST::Type *var_type)
+{
+  if (var_type->equals(&INT_T))
+    return EmitValue(pa.emit_SvIV_nomg(sv), &INT_T);
+  if (var_type->equals(&DOUBLE_T))
+    return EmitValue(pa.emit_SvNV_nomg(sv), &DOUBLE_T);
+
+  return EmitValue(sv, &SCALAR_T);
 }
 
 bool
@@ -671,13 +2411,114 @@ Emitter::_jit_assign_sv(Value *sv, Value *value, const PerlJIT::AST::Type *type)
   else if (type->equals(&UNSPECIFIED_T))
     pa.emit_SvSetSV_nosteal(sv, value);
   else {
-    set_error("Unable to assign " + type->to_string() + " to an SV");
+    set_error(pj_bailout_unsupported_assignment, NULL,
+              "Unable to assign " + type->to_string() + " to an SV");
     return false;
   }
 
   return true;
 }
 
+static VariableDeclaration *
+term_declaration(Term *ast)
+{
+  if (ast->get_type() == pj_ttype_lexical)
+    return static_cast<Lexical *>(ast)->declaration;
+  if (ast->get_type() == pj_ttype_variabledeclaration)
+    return static_cast<VariableDeclaration *>(ast);
+  return NULL;
+}
+
+// Escape analysis for the lexicals of a region: when all the uses of an
+// Int/Double lexical that can't escape the ASTs (as found by the type
+// inference) are in the JITted code of the region, the variable never
+// needs its pad entry, and is kept in an LLVM variable instead (mem2reg
+// turns it into SSA values)
+void
+Emitter::find_region_locals(const std::vector<Term *> &asts)
+{
+  unordered_map<VariableDeclaration *, int> uses;
+
+  for (size_t i = 0, max = asts.size(); i < max; ++i)
+    count_jitted_uses(asts[i], uses);
+
+  for (unordered_map<VariableDeclaration *, int>::iterator it = uses.begin(), end = uses.end(); it != end; ++it) {
+    VariableDeclaration *decl = it->first;
+    const PerlJIT::AST::Type *type = decl->get_value_type();
+    llvm::Type *value_type;
+
+    if (!decl->local_uses || decl->local_uses != it->second)
+      continue;
+    if (type->equals(&INT_T))
+      value_type = pa.IV_constant(0)->getType();
+    else if (type->equals(&DOUBLE_T))
+      value_type = pa.NV_constant(0)->getType();
+    else
+      continue;
+
+    region_locals[decl] = pa.alloc_variable(value_type, "lexical");
+  }
+}
+
+// Counts the uses of lexicals in the code emitted by _jit_emit(), as
+// opposed to the subtrees it leaves to the interpreter
+void
+Emitter::count_jitted_uses(Term *ast, unordered_map<VariableDeclaration *, int> &uses)
+{
+  switch (ast->get_type()) {
+  case pj_ttype_lexical:
+  case pj_ttype_variabledeclaration:
+    if (VariableDeclaration *decl = term_declaration(ast))
+      ++uses[decl];
+    break;
+  case pj_ttype_statement:
+    count_jitted_uses(static_cast<Statement *>(ast)->kids[0], uses);
+    break;
+  case pj_ttype_op:
+    if (static_cast<Op *>(ast)->op_class() != pj_opc_binop || !is_jittable(ast))
+      break;
+    for (size_t i = 0, max = ast->get_kid_count(); i < max; ++i)
+      if (Term *kid = ast->get_kid(i))
+        count_jitted_uses(kid, uses);
+    break;
+  default:
+    break;
+  }
+}
+
+// NULL when the term is not a region-local variable
+Value *
+Emitter::region_local_slot(Term *ast)
+{
+  VariableDeclaration *decl = term_declaration(ast);
+
+  if (!decl)
+    return NULL;
+
+  unordered_map<VariableDeclaration *, Value *>::iterator it = region_locals.find(decl);
+
+  return it == region_locals.end() ? NULL : it->second;
+}
+
+EmitValue
+Emitter::_jit_get_region_local(Value *slot, const PerlJIT::AST::Type *var_type)
+{
+  return EmitValue(MY_CXT.builder.CreateLoad(slot), var_type);
+}
+
+bool
+Emitter::_jit_assign_region_local(Value *slot, Value *value, const PerlJIT::AST::Type *type, const PerlJIT::AST::Type *var_type)
+{
+  Value *converted = var_type->equals(&DOUBLE_T) ?
+    _to_nv_value(value, type) : _to_iv_value(value, type);
+
+  if (!converted)
+    return false;
+  MY_CXT.builder.CreateStore(converted, slot);
+
+  return true;
+}
+
 EmitValue
 Emitter::_jit_emit_const(PerlJIT::AST::Constant *ast, const PerlJIT::AST::Type *type)
 {
@@ -695,7 +2536,7 @@ Emitter::_jit_emit_const(PerlJIT::AST::Constant *ast, const PerlJIT::AST::Type *
       pa.UV_constant(static_cast<NumericConstant *>(ast)->uint_value),
       &UNSIGNED_INT_T);
   default:
-    set_error("Unable to emit this type of constant");
+    set_error(pj_bailout_unsupported_constant, ast, "Unable to emit this type of constant");
     return EmitValue::invalid();
   }
 }
@@ -705,13 +2546,29 @@ Emitter::_to_nv_value(Value *value, const PerlJIT::AST::Type *type)
 {
   if (type->equals(&DOUBLE_T))
     return value;
-  if (type->is_integer())
-    // TODO cache type
-    return MY_CXT.builder.CreateFPCast(value, llvm::Type::getDoubleTy(module->getContext()));
+  // TODO cache type
+  if (type->equals(&INT_T))
+    return MY_CXT.builder.CreateSIToFP(value, llvm::Type::getDoubleTy(module->getContext()));
+  if (type->equals(&UNSIGNED_INT_T))
+    return MY_CXT.builder.CreateUIToFP(value, llvm::Type::getDoubleTy(module->getContext()));
   if (type->equals(&SCALAR_T) || type->equals(&UNSPECIFIED_T))
     return pa.emit_SvNV(value);
 
-  set_error("Handle more NV coercion cases");
+  set_error(pj_bailout_unsupported_coercion, NULL, "Handle more NV coercion cases");
+  return NULL;
+}
+
+Value *
+Emitter::_to_iv_value(Value *value, const PerlJIT::AST::Type *type)
+{
+  if (type->equals(&INT_T) || type->equals(&UNSIGNED_INT_T))
+    return value;
+  if (type->equals(&DOUBLE_T))
+    return MY_CXT.builder.CreateFPToSI(value, pa.IV_constant(0)->getType());
+  if (type->equals(&SCALAR_T) || type->equals(&UNSPECIFIED_T))
+    return pa.emit_SvIV(value);
+
+  set_error(pj_bailout_unsupported_coercion, NULL, "Handle more IV coercion cases");
   return NULL;
 }
 
@@ -722,9 +2579,26 @@ op_2sv(pTHX_ OP *op)
 }
 
 void
-Emitter::set_error(const std::string &error)
+Emitter::set_error(pj_bailout_reason reason, Term *ast, const std::string &error)
 {
   error_message = error;
+  record_bailout(reason, ast);
+}
+
+void
+Emitter::record_bailout(pj_bailout_reason reason, Term *ast)
+{
+  OP *op = ast ? ast->get_perl_op() : NULL;
+  int op_type = -1;
+
+  if (reason == pj_bailout_none)
+    return;
+  if (op)
+    op_type = op->op_type == OP_NULL && op->op_targ ? op->op_targ : op->op_type;
+
+  MUTEX_LOCK(bailouts_mutex);
+  ++bailouts[std::make_pair(reason, op_type)];
+  MUTEX_UNLOCK(bailouts_mutex);
 }
 
 std::string
@@ -745,7 +2619,7 @@ Emitter::replace_sequence(OP *first, OP *last, OP *op, bool keep)
   av_push(item, op_2sv(aTHX_ op));
   av_push(item, keep ? &PL_sv_yes : &PL_sv_no);
 
-  av_push(ops, newRV_noinc((SV *) item));
+  av_push(output->ops, newRV_noinc((SV *) item));
 }
 
 void
@@ -758,5 +2632,5 @@ Emitter::detach_tree(OP *op, bool keep)
   av_push(item, op_2sv(aTHX_ op));
   av_push(item, keep ? &PL_sv_yes : &PL_sv_no);
 
-  av_push(ops, newRV_noinc((SV *) item));
+  av_push(output->ops, newRV_noinc((SV *) item));
 }
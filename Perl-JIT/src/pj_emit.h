@@ -7,24 +7,122 @@
 #undef Copy
 
 #include "pj_optree.h"
+#include "pj_ast_visitor.h"
 #include "pj_perlapi.h"
 #include "pj_types.h"
+#include "pj_compile_queue.h"
 // thx_member.h also defines the CXT_ARG_/DECL_CXT_MEMBER macros
 #include "thx_member.h"
 
 #include <llvm/IR/Module.h>
 #include <llvm/PassManager.h>
-#include <llvm/ExecutionEngine/ExecutionEngine.h>
 
 #include <tr1/memory>
+#include <tr1/unordered_map>
+
+// Optimization levels for JITted code, mirroring the usual -O0..-O3
+// compiler switches; trade compile time against code quality
+typedef enum {
+  pj_opt_none,
+  pj_opt_basic,
+  pj_opt_default,
+  pj_opt_aggressive
+} pj_opt_level;
+
+// Instrumentation of JITted regions, reported by Perl::JIT::stats()
+typedef enum {
+  pj_profile_none,
+  // count region executions
+  pj_profile_calls,
+  // also accumulate the CPU cycles spent in the region
+  pj_profile_cycles
+} pj_profile_level;
+
+// Why a term is left to the interpreter, or why JITting failed;
+// aggregated per process by pj_bailouts()
+typedef enum {
+  pj_bailout_none,
+  // op type not in the list of JITtable ops
+  pj_bailout_unknown_op,
+  // operand with an opaque (non-typed) value that might have magic
+  pj_bailout_opaque_operand,
+  // ops the AST builder could not represent
+  pj_bailout_optree,
+  // AST term kind the emitter does not handle (globals, loops, ...)
+  pj_bailout_unsupported_term,
+  // statement sequence with too few JITtable statements
+  pj_bailout_sparse_sequence,
+  pj_bailout_caller_context,
+  pj_bailout_unsupported_constant,
+  pj_bailout_missing_target,
+  pj_bailout_unsupported_assignment,
+  pj_bailout_unsupported_coercion,
+  pj_bailout_count
+} pj_bailout_reason;
 
 namespace PerlJIT {
   void pj_init_emitter(pTHX);
 
-  SV *pj_jit_sub(SV *coderef);
+  SV *pj_jit_sub(SV *coderef, HV *options);
+  void pj_wait_for_compilation();
+  SV *pj_code_memory();
+  SV *pj_region_stats();
+  SV *pj_bailouts();
+  void pj_reset_bailouts();
 
   class Cxt;
 
+  struct EmitterOptions {
+    pj_opt_level opt_level;
+    // when non-zero, regions are recompiled at the highest optimization
+    // level once they have been executed this many times
+    UV tier_up_calls;
+    // optimize and generate code on the background thread; the op tree
+    // is patched on the first call to the sub after all code is ready
+    bool async;
+    // only optimize and generate code for a region when it is first
+    // executed; takes precedence over async
+    bool lazy;
+    // optimized code is looked up in/written to this cache, when set
+    std::tr1::shared_ptr<CodeCache> cache;
+    // emit the use tracking needed to evict code under a code budget
+    bool track_use;
+    pj_profile_level profile;
+    // attach the source line of each statement to the code
+    bool debug_info;
+
+    EmitterOptions() :
+      opt_level(pj_opt_default), tier_up_calls(0), async(false),
+      lazy(false), track_use(false), profile(pj_profile_none),
+      debug_info(false) { }
+  };
+
+  // Module and machine code of the regions created by a jit_sub call,
+  // freed together with the last JIT op using them
+  struct CompilationUnit {
+    std::tr1::shared_ptr<JITLayer> jit;
+    llvm::Module *module;
+
+    CompilationUnit(const std::tr1::shared_ptr<JITLayer> &jit, llvm::Module *module);
+    ~CompilationUnit();
+  };
+
+  // The results of JITting a sub
+  struct EmitterOutput {
+    // op-tree edits, applied by Perl::JIT::Emit
+    AV *ops;
+    // exit points of the subtrees called by JITted code, their op_next
+    // is cleared when the edits are applied
+    std::vector<OP *> exits;
+    std::vector<std::tr1::shared_ptr<CompileJob> > jobs;
+    // released once all the regions have been created
+    std::tr1::shared_ptr<CompilationUnit> unit;
+    // number of regions created so far, to name them
+    size_t regions;
+
+    EmitterOutput(AV *_ops) : ops(_ops), regions(0) { }
+  };
+
   struct EmitValue {
     llvm::Value *value;
     const PerlJIT::AST::Type *type;
@@ -36,9 +134,19 @@ namespace PerlJIT {
     static EmitValue invalid() { return EmitValue(0, 0); }
   };
 
-  class Emitter {
+  // Looks for operands with opaque values (that might have magic)
+  // below JITtable ops that may be overloaded
+  class MagicOperandFinder : public ASTVisitor {
+  public:
+    bool has_magic_operand(PerlJIT::AST::Op *ast) { return !visit(ast); }
+
+  protected:
+    visit_control_t visit_term_pre(PerlJIT::AST::Term *term);
+  };
+
+  class Emitter : private ASTVisitor {
   public:
-    Emitter(pTHX_ CXT_ARG_(Cxt) CV *cv, AV *ops);
+    Emitter(pTHX_ CXT_ARG_(Cxt) CV *cv, EmitterOutput *output, const EmitterOptions &options);
     Emitter(pTHX_ CXT_ARG_(Cxt) const Emitter &other);
     ~Emitter();
 
@@ -46,39 +154,81 @@ namespace PerlJIT {
     std::string error() const;
 
   private:
+    visit_control_t visit_term_pre(PerlJIT::AST::Term *ast);
+
     void replace_sequence(OP *first, OP *last, OP *ok, bool keep);
     void detach_tree(OP *op, bool keep);
-    void set_error(const std::string &error);
+    void set_error(pj_bailout_reason reason, PerlJIT::AST::Term *ast, const std::string &error);
+    void record_bailout(pj_bailout_reason reason, PerlJIT::AST::Term *ast);
 
     bool jit_statement_sequence(const std::vector<PerlJIT::AST::Term *> &asts);
     bool jit_tree(PerlJIT::AST::Term *ast);
     OP *_jit_trees(const std::vector<PerlJIT::AST::Term *> &asts);
     bool _jit_emit_root(PerlJIT::AST::Term *ast);
+    void _jit_emit_tier_up_check();
+    void _jit_emit_use_tracking(llvm::GlobalVariable *&last_use, llvm::GlobalVariable *&active);
+    void _jit_emit_use_tracking_exit(llvm::GlobalVariable *active);
+    llvm::MDNode *_jit_emit_debug_scope(const std::string &name, const COP *cop);
+    void _jit_emit_profile(llvm::GlobalVariable *&calls, llvm::GlobalVariable *&cycles, llvm::Value *&start);
+    void _jit_emit_profile_exit(llvm::GlobalVariable *cycles, llvm::Value *start);
     bool _jit_emit_return(PerlJIT::AST::Term *ast, pj_op_context context, llvm::Value *value, const PerlJIT::AST::Type *type);
+    llvm::Value *_jit_result_sv(PerlJIT::AST::Term *ast, llvm::Value *value, const PerlJIT::AST::Type *type);
+    size_t region_stack_depth(const std::vector<PerlJIT::AST::Term *> &asts);
+    size_t direct_call_depth(PerlJIT::AST::Term *ast);
+    llvm::Value *_jit_emit_home_sv(PerlJIT::AST::Term *ast);
+    void _jit_load_sp();
+    void _jit_store_sp();
     bool is_jittable(PerlJIT::AST::Term *ast);
+    pj_bailout_reason jittability(PerlJIT::AST::Term *ast);
+    pj_bailout_reason assignment_jittability(PerlJIT::AST::Binop *ast);
     bool needs_excessive_magic(PerlJIT::AST::Op *ast);
     EmitValue _jit_emit(PerlJIT::AST::Term *ast, const PerlJIT::AST::Type *type);
     EmitValue _jit_emit_op(PerlJIT::AST::Op *ast, const PerlJIT::AST::Type *type);
     EmitValue _jit_emit_binop(PerlJIT::AST::Binop *ast, const PerlJIT::AST::Type *type);
+    EmitValue _jit_emit_sassign(PerlJIT::AST::Binop *ast);
+    EmitValue _jit_emit_arithmetic(pj_op_type op_type, const EmitValue &lv, const EmitValue &rv);
+    EmitValue _jit_emit_checked_arithmetic(PerlJIT::AST::Binop *ast, const EmitValue &lv, const EmitValue &rv, llvm::Value *target);
     EmitValue _jit_emit_optree_jit_kids(PerlJIT::AST::Term *ast, const PerlJIT::AST::Type *Type);
-    EmitValue _jit_emit_optree(PerlJIT::AST::Term *ast);
+    EmitValue _jit_emit_optree(PerlJIT::AST::Term *ast, const PerlJIT::AST::Type *type);
+    bool is_directly_callable(PerlJIT::AST::Op *ast);
+    EmitValue _jit_emit_direct_call(PerlJIT::AST::Op *ast, const PerlJIT::AST::Type *type);
+    EmitValue _jit_opaque_result(PerlJIT::AST::Term *ast, llvm::Value *sv, const PerlJIT::AST::Type *type);
+    llvm::Value *_jit_load_op(OP *op);
 
-    void _jit_clear_op_next(OP *op);
     EmitValue _jit_emit_const(PerlJIT::AST::Constant *ast, const PerlJIT::AST::Type *type);
-    EmitValue _jit_get_lexical_sv(PerlJIT::AST::Lexical *ast);
+    EmitValue _jit_get_lexical_sv(PerlJIT::AST::Lexical *ast, const PerlJIT::AST::Type *type);
+    EmitValue _jit_get_lexical_value(llvm::Value *sv, const PerlJIT::AST::Type *var_type);
     EmitValue _jit_get_lexical_declaration_sv(PerlJIT::AST::VariableDeclaration *ast);
     bool _jit_assign_sv(llvm::Value *sv, llvm::Value *value, const PerlJIT::AST::Type *type);
 
+    void find_region_locals(const std::vector<PerlJIT::AST::Term *> &asts);
+    void count_jitted_uses(PerlJIT::AST::Term *ast, std::tr1::unordered_map<PerlJIT::AST::VariableDeclaration *, int> &uses);
+    llvm::Value *region_local_slot(PerlJIT::AST::Term *ast);
+    EmitValue _jit_get_region_local(llvm::Value *slot, const PerlJIT::AST::Type *var_type);
+    bool _jit_assign_region_local(llvm::Value *slot, llvm::Value *value, const PerlJIT::AST::Type *type, const PerlJIT::AST::Type *var_type);
+
     llvm::Value *_to_nv_value(llvm::Value *value, const PerlJIT::AST::Type *type);
+    llvm::Value *_to_iv_value(llvm::Value *value, const PerlJIT::AST::Type *type);
 
     CV *cv;
-    AV *ops;
+    EmitterOutput *output;
+    EmitterOptions options;
     std::vector<OP *> subtrees;
+    // ops are not embedded in the code, so it can be cached: JITted
+    // code loads them from these slots, filled in after compilation
+    std::vector<std::pair<llvm::GlobalVariable *, OP *> > op_slots;
+    // lexicals of the current region that don't need a pad entry, and
+    // the LLVM variables holding their value
+    std::tr1::unordered_map<PerlJIT::AST::VariableDeclaration *, llvm::Value *> region_locals;
+    // the copy of PL_stack_sp in the current region: not loaded yet,
+    // equal to PL_stack_sp, or with values pushed/popped since
+    enum { sp_unloaded, sp_synced, sp_modified } sp_state;
     llvm::Module *module;
     llvm::FunctionPassManager *fpm;
-    std::tr1::shared_ptr<llvm::ExecutionEngine> execution_engine;
+    std::tr1::shared_ptr<JITLayer> jit;
     PerlJIT::PerlAPI &pa;
     std::string error_message;
+    MagicOperandFinder magic_operand_finder;
     DECL_CXT_MEMBER(Cxt)
     DECL_THX_MEMBER
   };
@@ -3,6 +3,7 @@
 #include "pj_debug.h"
 #include "pj_ast_terms.h"
 #include "pj_keyword_plugin.h"
+#include "pj_tiering.h"
 
 //XOP PJ_xop_jitop;
 //Perl_ophook_t PJ_orig_opfreehook;
@@ -143,4 +144,6 @@ void pj_define_constants(pTHX)
   INT_CONST(pj_uint_type);
 
   STRING_CONST(PJ_KEYWORD_PLUGIN_HINT);
+  STRING_CONST(PJ_TIER_CALLS_HINT);
+  STRING_CONST(PJ_TIER_HOT_CALLS_HINT);
 }
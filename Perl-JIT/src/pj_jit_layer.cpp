@@ -0,0 +1,88 @@
+#include "pj_jit_layer.h"
+
+#include <llvm/ExecutionEngine/JIT.h>
+
+using namespace PerlJIT;
+using namespace llvm;
+
+JITLayer *
+JITLayer::create(Module *module, std::string &error)
+{
+  ExecutionEngine *engine = EngineBuilder(module).setErrorStr(&error).create();
+
+  return engine ? new JITLayer(engine) : NULL;
+}
+
+JITLayer::JITLayer(ExecutionEngine *_engine) :
+  engine(_engine)
+{
+}
+
+JITLayer::~JITLayer()
+{
+  delete engine;
+}
+
+const DataLayout *
+JITLayer::data_layout() const
+{
+  return engine->getDataLayout();
+}
+
+void
+JITLayer::add_module(Module *module)
+{
+  engine->addModule(module);
+}
+
+void
+JITLayer::remove_module(Module *module)
+{
+  for (Module::iterator it = module->begin(), end = module->end(); it != end; ++it)
+    if (!it->isDeclaration())
+      engine->freeMachineCodeForFunction(it);
+
+  engine->removeModule(module);
+}
+
+void *
+JITLayer::function_code(Function *function)
+{
+  return engine->getPointerToFunction(function);
+}
+
+void
+JITLayer::free_function_code(Function *function)
+{
+  engine->freeMachineCodeForFunction(function);
+}
+
+void *
+JITLayer::global_address(const GlobalValue *global)
+{
+  return engine->getPointerToGlobal(global);
+}
+
+void *
+JITLayer::mapped_address(const GlobalValue *global)
+{
+  return engine->getPointerToGlobalIfAvailable(global);
+}
+
+void
+JITLayer::map_global(const GlobalValue *global, void *address)
+{
+  engine->addGlobalMapping(global, address);
+}
+
+void
+JITLayer::add_listener(JITEventListener *listener)
+{
+  engine->RegisterJITEventListener(listener);
+}
+
+void
+JITLayer::remove_listener(JITEventListener *listener)
+{
+  engine->UnregisterJITEventListener(listener);
+}
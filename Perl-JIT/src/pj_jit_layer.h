@@ -0,0 +1,52 @@
+#ifndef PJ_JIT_LAYER_H_
+#define PJ_JIT_LAYER_H_
+
+#include <llvm/IR/Module.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/JITEventListener.h>
+
+#include <string>
+
+namespace PerlJIT {
+  // The code generation backend: hands out machine code for the
+  // functions of the modules added to it, compiling each function
+  // separately, on first request, and allows removing modules.
+  //
+  // LLVM 3.3/3.4 has no ORC layers; this wraps the legacy JIT, which
+  // already generates code function by function. Lazy compilation of
+  // JITted regions (on their first execution) is built on top of it by
+  // the emitter. All methods must be called with the LLVM lock held.
+  class JITLayer {
+  public:
+    // the layer owns the module
+    static JITLayer *create(llvm::Module *module, std::string &error);
+    ~JITLayer();
+
+    const llvm::DataLayout *data_layout() const;
+
+    void add_module(llvm::Module *module);
+    // frees the machine code of the module; the caller deletes it
+    void remove_module(llvm::Module *module);
+
+    // generates code for a function, if needed
+    void *function_code(llvm::Function *function);
+    void free_function_code(llvm::Function *function);
+
+    // address of a global, allocating variables on first use
+    void *global_address(const llvm::GlobalValue *global);
+    // address of a global, if it has one yet
+    void *mapped_address(const llvm::GlobalValue *global);
+    void map_global(const llvm::GlobalValue *global, void *address);
+
+    void add_listener(llvm::JITEventListener *listener);
+    void remove_listener(llvm::JITEventListener *listener);
+
+  private:
+    JITLayer(llvm::ExecutionEngine *engine);
+
+    llvm::ExecutionEngine *engine;
+  };
+}
+
+#endif // PJ_JIT_LAYER_H_
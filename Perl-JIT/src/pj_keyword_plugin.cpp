@@ -197,6 +197,8 @@ S_get_or_makedeclaration_map(pTHX)
 STATIC void
 S_parse_typed_declaration(pTHX_ OP **op_ptr)
 {
+  // Get existing declarations or create new container
+  pj_declaration_map_t *decl_map = S_get_or_makedeclaration_map(aTHX);
   AST::Type *type = S_parse_type(aTHX);
 
   // Skip space (which we know to exist from S_lex_to_whitespace in S_parse_type)
@@ -216,21 +218,12 @@ S_parse_typed_declaration(pTHX_ OP **op_ptr)
   extractor.visit(aTHX_ parsed_optree, NULL);
   const vector<OP *> &declaration_ops = extractor.get_padsv_ops();
 
-  // Get existing declarations or create new container
-  pj_declaration_map_t *decl_map = S_get_or_makedeclaration_map(aTHX);
-
-  // Add to the declaration map
+  // Add to the declaration map; the declarations share the type
   const unsigned int ndecl = declaration_ops.size();
   for (unsigned int i = 0; i < ndecl; ++i) {
     (*decl_map)[declaration_ops[i]->op_targ] = TypedPadSvOp(type, declaration_ops[i]);
   }
 
-  // Delete any unowned type or set ownership [FIXME this is terrible]
-  if (decl_map->size() == 0)
-    delete type;
-  else
-    (*decl_map)[declaration_ops.back()->op_targ].set_type_ownership(true);
-
   // Actually output the OP tree that Perl constructed for us.
   *op_ptr = parsed_optree;
 }
@@ -238,6 +231,8 @@ S_parse_typed_declaration(pTHX_ OP **op_ptr)
 STATIC void
 S_parse_typed_loop(pTHX_ OP **op_ptr)
 {
+  // Get existing declarations or create new container
+  pj_declaration_map_t *decl_map = S_get_or_makedeclaration_map(aTHX);
   AST::Type *type = S_parse_type(aTHX);
 
   // Skip space (which we know to exist from S_lex_to_whitespace in S_parse_type)
@@ -266,12 +261,8 @@ S_parse_typed_loop(pTHX_ OP **op_ptr)
   assert(o->op_targ); // "my" variable
   assert(o->op_private & OPpLVAL_INTRO); // for my $x (...)
 
-  // Get existing declarations or create new container
-  pj_declaration_map_t *decl_map = S_get_or_makedeclaration_map(aTHX);
-
   // Add to the declaration map
   (*decl_map)[o->op_targ] = TypedPadSvOp(type, o);
-  (*decl_map)[o->op_targ].set_type_ownership(true);
 
   // Actually output the OP tree that Perl constructed for us.
   *op_ptr = parsed_optree;
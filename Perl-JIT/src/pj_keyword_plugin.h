@@ -13,23 +13,18 @@ namespace PerlJIT {
   class TypedPadSvOp {
   public:
     TypedPadSvOp()
-      : fType(NULL), fDeclaration(NULL), fOwnsType(false) {}
+      : fType(NULL), fDeclaration(NULL) {}
     TypedPadSvOp(AST::Type *t, OP *decl)
-      : fType(t), fDeclaration(decl), fOwnsType(false) {}
-
-    ~TypedPadSvOp()
-      { if (fOwnsType) delete fType; }
+      : fType(t), fDeclaration(decl) {}
 
     AST::Type *get_type() const    { return fType; }
     OP *get_declaration() const    { return fDeclaration; }
     void set_declaration(OP *decl) { fDeclaration = decl; }
-    void set_type(AST::Type *t)    { fType = t; fOwnsType = false; }
-    void set_type_ownership(bool own) { fOwnsType = own; }
+    void set_type(AST::Type *t)    { fType = t; }
 
   private:
     AST::Type *fType;
     OP *fDeclaration;
-    bool fOwnsType;
   };
 }
 
@@ -12,6 +12,8 @@
 #include "pj_ast_terms.h"
 #include "pj_global_state.h"
 #include "pj_keyword_plugin.h"
+#include "pj_phase_timer.h"
+#include "pj_type_inference.h"
 
 #include <vector>
 #include <list>
@@ -99,8 +101,8 @@ namespace PerlJIT {
   class OPTreeJITCandidateFinder : public OPTreeVisitor
   {
   public:
-    OPTreeJITCandidateFinder(pTHX_ CV *cv)
-      : containing_cv(cv), last_nextstate(NULL), current_sequence(NULL),
+    OPTreeJITCandidateFinder(pTHX_ CV *cv, AST::Arena &_arena)
+      : arena(_arena), containing_cv(cv), last_nextstate(NULL), current_sequence(NULL),
         skip_next_leaveloop(false)
     {
       // typed_declarations may end up being NULL!
@@ -162,12 +164,12 @@ namespace PerlJIT {
     void
     create_statement(pTHX_ AST::Term *expression)
     {
-      AST::Statement *stmt = new AST::Statement(last_nextstate, expression);
+      AST::Statement *stmt = new (arena) AST::Statement(last_nextstate, expression);
 
       if (!current_sequence ||
           !current_sequence->kids.back()->get_perl_op()->op_sibling ||
           current_sequence->kids.back()->get_perl_op()->op_sibling->op_sibling != last_nextstate) {
-        current_sequence = new AST::StatementSequence();
+        current_sequence = new (arena) AST::StatementSequence();
         candidates.push_back(current_sequence);
       }
 
@@ -203,7 +205,7 @@ namespace PerlJIT {
           croak("Unrecognized sigil");
       }
 
-      decl = new AST::VariableDeclaration(declaration, variables.size(), sigil);
+      decl = new (arena) AST::VariableDeclaration(declaration, variables.size(), sigil);
       if (typed_declarations) {
         pj_declaration_map_t::iterator it = typed_declarations->find(reference->op_targ);
 
@@ -211,7 +213,7 @@ namespace PerlJIT {
           set_declaration_type(decl, it->second.get_type());
       }
       if (!decl->get_value_type())
-        set_declaration_type(decl, new AST::Scalar(pj_unspecified_type));
+        set_declaration_type(decl, AST::Scalar::get(pj_unspecified_type));
 
       variables[reference->op_targ] = decl;
 
@@ -223,9 +225,9 @@ namespace PerlJIT {
     {
       if (type->is_scalar()) {
         if (decl->sigil == pj_sigil_array)
-          decl->set_value_type(new AST::Array(type));
+          decl->set_value_type(AST::Array::get(type));
         else if (decl->sigil == pj_sigil_hash)
-          decl->set_value_type(new AST::Hash(type));
+          decl->set_value_type(AST::Hash::get(type));
         else
           decl->set_value_type(type);
       }
@@ -249,6 +251,9 @@ namespace PerlJIT {
     LoopCtlTracker &get_loop_control_tracker()
     { return loop_control_tracker; }
 
+    AST::Arena &get_arena()
+    { return arena; }
+
     OP *get_last_nextstate() const
     { return last_nextstate; }
 
@@ -256,6 +261,7 @@ namespace PerlJIT {
     { last_nextstate = nextstate_op; }
 
   private:
+    AST::Arena &arena;
     vector<PerlJIT::AST::Term *> candidates;
     CV *containing_cv;
     pj_declaration_map_t *typed_declarations;
@@ -269,17 +275,6 @@ namespace PerlJIT {
 }
 
 
-static void
-pj_free_term_vector(pTHX_ vector<PerlJIT::AST::Term *> &kids)
-{
-  vector<PerlJIT::AST::Term *>::iterator it = kids.begin();
-  for (; it != kids.end(); ++it) {
-    if (*it != NULL)
-      delete *it;
-  }
-}
-
-
 static int
 pj_build_kid_terms(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor, vector<AST::Term *> &kid_terms)
 {
@@ -317,14 +312,13 @@ pj_build_kid_terms(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor, vector<AST::T
 
       // Handle a few special kid cases
       if (kid_term == NULL) {
-        // Failed to build sub-AST, free ASTs build thus far before bailing
+        // Failed to build sub-AST; the ASTs built thus far are
+        // released with the arena
         PJ_DEBUG("pj_build_kid_terms failed to build sub-AST - unwinding.\n");
-        pj_free_term_vector(aTHX_ kid_terms);
         return 1;
       }
       else if (kid_term->get_type() == pj_ttype_op && ((AST::Op *)kid_term)->get_op_type() == pj_baseop_empty) {
         // empty list is not really a kid, don't include in child list
-        delete kid_term;
         kid_term = NULL;
       }
       else {
@@ -342,6 +336,8 @@ pj_build_kid_terms(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor, vector<AST::T
 static PerlJIT::AST::Term *
 pj_build_targmy_assignment(PerlJIT::AST::Term *term, OPTreeJITCandidateFinder &visitor)
 {
+  AST::Arena &arena = visitor.get_arena();
+
   OP *o = term->get_perl_op();
 
   if (!(PL_opargs[o->op_type] & OA_TARGLEX))
@@ -349,19 +345,21 @@ pj_build_targmy_assignment(PerlJIT::AST::Term *term, OPTreeJITCandidateFinder &v
   if (!(o->op_private & OPpTARGET_MY))
     return term;
 
-  AST::Lexical *var = new AST::Lexical(o, visitor.get_declaration(0, o));
+  AST::Lexical *var = new (arena) AST::Lexical(o, visitor.get_declaration(0, o));
 
-  return new AST::Binop(o, pj_binop_sassign, var, term);
+  return new (arena) AST::Binop(o, pj_binop_sassign, var, term);
 }
 
 static PerlJIT::AST::Term *
 pj_build_block_or_term(pTHX_ OP *start, OPTreeJITCandidateFinder &visitor)
 {
+  AST::Arena &arena = visitor.get_arena();
+
   if (start->op_type != OP_NEXTSTATE &&
       (start->op_type != OP_NULL || start->op_flags & OPf_KIDS))
     return pj_build_ast(aTHX_ start, visitor);
 
-  AST::StatementSequence *seq = new AST::StatementSequence();
+  AST::StatementSequence *seq = new (arena) AST::StatementSequence();
 
   // Consider this:
   // perl author_tools/jit_ast_dump.pl -c -e '$x = do {1;1;1;1;1}'
@@ -390,7 +388,7 @@ pj_build_block_or_term(pTHX_ OP *start, OPTreeJITCandidateFinder &visitor)
     AST::Term *expression = pj_build_ast(aTHX_ start, visitor);
     if (expression->get_type() == pj_ttype_empty)
       continue;
-    AST::Statement *stmt = new AST::Statement(nextstate, expression);
+    AST::Statement *stmt = new (arena) AST::Statement(nextstate, expression);
 
     seq->kids.push_back(stmt);
     start = start->op_sibling;
@@ -400,15 +398,16 @@ pj_build_block_or_term(pTHX_ OP *start, OPTreeJITCandidateFinder &visitor)
     return seq;
 
   // empty sequence, return an empty statement
-  delete seq;
-  return new AST::Empty();
+  return new (arena) AST::Empty();
 }
 
 static PerlJIT::AST::Term *
 pj_build_body(pTHX_ OP *body, OPTreeJITCandidateFinder &visitor)
 {
+  AST::Arena &arena = visitor.get_arena();
+
   if (!body)
-    return new PerlJIT::AST::Empty();
+    return new (arena) PerlJIT::AST::Empty();
 
   if (body->op_type == OP_SCOPE) {
     if (cUNOPx(body)->op_first->op_type != OP_STUB) {
@@ -423,29 +422,33 @@ pj_build_body(pTHX_ OP *body, OPTreeJITCandidateFinder &visitor)
   } else if (body->op_type != OP_STUB)
     return pj_build_block_or_term(aTHX_ body, visitor);
 
-  return new PerlJIT::AST::Empty();
+  return new (arena) PerlJIT::AST::Empty();
 }
 
 static PerlJIT::AST::For *
 pj_build_for(pTHX_ OP *start, PerlJIT::AST::Term *init, LOGOP *condition, OP *step, OP *body, OPTreeJITCandidateFinder &visitor)
 {
+  AST::Arena &arena = visitor.get_arena();
+
   PerlJIT::AST::Term *ast_condition = NULL, *ast_step = NULL, *ast_body = NULL;
   OP *start_op = init ? init->get_perl_op() : start;
   if (!init)
-    init = new PerlJIT::AST::Empty();
+    init = new (arena) PerlJIT::AST::Empty();
 
   ast_condition = condition ? pj_build_ast(aTHX_ condition->op_first, visitor) :
-                              new PerlJIT::AST::Empty();
+                              new (arena) PerlJIT::AST::Empty();
   ast_body = pj_build_body(aTHX_ body, visitor);
   ast_step = step ? pj_build_ast(aTHX_ step, visitor) :
-                    new PerlJIT::AST::Empty();
+                    new (arena) PerlJIT::AST::Empty();
 
-  return new PerlJIT::AST::For(start_op, init, ast_condition, ast_step, ast_body);
+  return new (arena) PerlJIT::AST::For(start_op, init, ast_condition, ast_step, ast_body);
 }
 
 static PerlJIT::AST::While *
 pj_build_while(pTHX_ OP *start, LOGOP *condition, OP *body, OP *cont, OPTreeJITCandidateFinder &visitor)
 {
+  AST::Arena &arena = visitor.get_arena();
+
   PerlJIT::AST::Term *ast_condition = NULL, *ast_body = NULL, *ast_cont = NULL;
   bool is_until = false;
   bool is_do = false;
@@ -460,30 +463,34 @@ pj_build_while(pTHX_ OP *start, LOGOP *condition, OP *body, OP *cont, OPTreeJITC
     } else
       ast_condition = pj_build_ast(aTHX_ condition->op_first, visitor);
   } else
-    ast_condition = new PerlJIT::AST::Empty();
+    ast_condition = new (arena) PerlJIT::AST::Empty();
 
   ast_body = pj_build_body(aTHX_ body, visitor);
   ast_cont = pj_build_body(aTHX_ cont, visitor);
 
-  return new PerlJIT::AST::While(start, ast_condition, is_until, is_do,
+  return new (arena) PerlJIT::AST::While(start, ast_condition, is_until, is_do,
                                  ast_body, ast_cont);
 }
 
 static PerlJIT::AST::BareBlock *
 pj_build_block(pTHX_ OP *start, OP *body, OP *cont, OPTreeJITCandidateFinder &visitor)
 {
+  AST::Arena &arena = visitor.get_arena();
+
   PerlJIT::AST::Term *ast_body = NULL, *ast_cont = NULL;
 
   ast_body = pj_build_body(aTHX_ body, visitor);
   ast_cont = pj_build_body(aTHX_ cont, visitor);
 
-  return new PerlJIT::AST::BareBlock(start, ast_body, ast_cont);
+  return new (arena) PerlJIT::AST::BareBlock(start, ast_body, ast_cont);
 }
 
 
 static AST::Term *
 pj_build_foreach(pTHX_ OP *start, OP *body, OP *cont, OPTreeJITCandidateFinder &visitor)
 {
+  AST::Arena &arena = visitor.get_arena();
+
   AST::Term *ast_body = NULL, *ast_cont = NULL, *ast_iterator = NULL, *ast_expression = NULL;
   LOOP *enter = cLOOPx(cBINOPx(start)->op_first);
   OP *args = cUNOPx(enter->op_first->op_sibling)->op_first->op_sibling;
@@ -493,12 +500,12 @@ pj_build_foreach(pTHX_ OP *start, OP *body, OP *cont, OPTreeJITCandidateFinder &
     if (enter->op_private & OPpLVAL_INTRO)
       ast_iterator = visitor.get_declaration((OP *) enter, (OP *) enter);
     else
-      ast_iterator = new AST::Lexical((OP *) enter, visitor.get_declaration(0, (OP *) enter));
+      ast_iterator = new (arena) AST::Lexical((OP *) enter, visitor.get_declaration(0, (OP *) enter));
   } else {
     OP *iterator = enter->op_first->op_sibling->op_sibling;
 
     if (iterator->op_type == OP_GV)
-      ast_iterator = new AST::Global(iterator, pj_sigil_glob);
+      ast_iterator = new (arena) AST::Global(iterator, pj_sigil_glob);
     else
       ast_iterator = pj_build_ast(aTHX_ iterator, visitor);
   }
@@ -510,7 +517,7 @@ pj_build_foreach(pTHX_ OP *start, OP *body, OP *cont, OPTreeJITCandidateFinder &
     OP *second = first->op_sibling;
 
     if (second)
-      ast_expression = new AST::Binop(enter->op_first->op_sibling, pj_binop_range,
+      ast_expression = new (arena) AST::Binop(enter->op_first->op_sibling, pj_binop_range,
                                       pj_build_ast(aTHX_ first, visitor),
                                       pj_build_ast(aTHX_ second, visitor));
     else
@@ -531,18 +538,20 @@ pj_build_foreach(pTHX_ OP *start, OP *body, OP *cont, OPTreeJITCandidateFinder &
 
     kids.resize(1);
     kids[0] = ast_expression;
-    ast_expression = new AST::Listop(enter->op_first->op_sibling, pj_listop_reverse, kids);
+    ast_expression = new (arena) AST::Listop(enter->op_first->op_sibling, pj_listop_reverse, kids);
   }
 
   ast_body = pj_build_body(aTHX_ body, visitor);
   ast_cont = pj_build_body(aTHX_ cont, visitor);
 
-  return new AST::Foreach(start, ast_iterator, ast_expression, ast_body, ast_cont);
+  return new (arena) AST::Foreach(start, ast_iterator, ast_expression, ast_body, ast_cont);
 }
 
 static PerlJIT::AST::Term *
 pj_build_loop(pTHX_ OP *start, PerlJIT::AST::Term *init, OPTreeJITCandidateFinder &visitor)
 {
+  AST::Arena &arena = visitor.get_arena();
+
   LOOP *enter = cLOOPx(cBINOPx(start)->op_first);
   LOGOP *cond = NULL;
   LISTOP *lineseq = NULL;
@@ -553,7 +562,7 @@ pj_build_loop(pTHX_ OP *start, PerlJIT::AST::Term *init, OPTreeJITCandidateFinde
     cond = cLOGOPx(cUNOPx(enter->op_sibling)->op_first);
     lineseq = cLISTOPx(cond->op_first->op_sibling);
   } else if (enter->op_sibling->op_type == OP_STUB) {
-    return new AST::Empty();
+    return new (arena) AST::Empty();
   } else if (enter->op_sibling->op_type == OP_LINESEQ) {
     lineseq = cLISTOPx(enter->op_sibling);
   } else {
@@ -620,6 +629,8 @@ pj_build_loop(pTHX_ OP *start, PerlJIT::AST::Term *init, OPTreeJITCandidateFinde
 static PerlJIT::AST::Term *
 pj_build_given_when_default(pTHX_ UNOP *leaveop, OPTreeJITCandidateFinder &visitor)
 {
+  AST::Arena &arena = visitor.get_arena();
+
   // These Binop types could some day become their own Term subclasses instead.
   // A default block is just a given block without condition.
   // Consider: should this make the default block a separate Op type?
@@ -638,13 +649,13 @@ pj_build_given_when_default(pTHX_ UNOP *leaveop, OPTreeJITCandidateFinder &visit
   if (blockop == NULL) {
     // This is a default{} block
     blockop = valueop;
-    return new AST::Unop((OP *)leaveop,
+    return new (arena) AST::Unop((OP *)leaveop,
                          pj_unop_default,
                          pj_build_ast(aTHX_ blockop, visitor));
   }
   else {
     assert(OP_CLASS(blockop) == OA_LISTOP);
-    return new AST::Binop((OP *)leaveop,
+    return new (arena) AST::Binop((OP *)leaveop,
                           (is_given ? pj_binop_given : pj_binop_when),
                           pj_build_ast(aTHX_ valueop, visitor),
                           pj_build_ast(aTHX_ blockop, visitor));
@@ -654,6 +665,8 @@ pj_build_given_when_default(pTHX_ UNOP *leaveop, OPTreeJITCandidateFinder &visit
 static PerlJIT::AST::Term *
 pj_build_grep_or_map(pTHX_ OP *start, OPTreeJITCandidateFinder &visitor)
 {
+  AST::Arena &arena = visitor.get_arena();
+
   assert(start->op_type == OP_MAPWHILE || start->op_type == OP_GREPWHILE);
 
   // grep and map used almost interchangably here
@@ -669,7 +682,7 @@ pj_build_grep_or_map(pTHX_ OP *start, OPTreeJITCandidateFinder &visitor)
   // Convert map body
   AST::Term *map_body_term = pj_build_ast(aTHX_ impl, visitor);
   if (map_body_term == NULL)
-    map_body_term = new AST::Optree(impl);
+    map_body_term = new (arena) AST::Optree(impl);
 
   // Convert the map input list
   vector<AST::Term *> param_vec;
@@ -677,7 +690,7 @@ pj_build_grep_or_map(pTHX_ OP *start, OPTreeJITCandidateFinder &visitor)
   while (arg != NULL) {
     PerlJIT::AST::Term *term = pj_build_ast(aTHX_ arg, visitor);
     if (term == NULL)
-      term = new AST::Optree(arg);
+      term = new (arena) AST::Optree(arg);
 
     param_vec.push_back(term);
 
@@ -685,13 +698,15 @@ pj_build_grep_or_map(pTHX_ OP *start, OPTreeJITCandidateFinder &visitor)
   }
 
   return start->op_type == OP_MAPWHILE
-         ? (AST::Term *)new AST::Map(start, map_body_term, new AST::List(param_vec))
-         : (AST::Term *)new AST::Grep(start, map_body_term, new AST::List(param_vec));
+         ? (AST::Term *)new (arena) AST::Map(start, map_body_term, new (arena) AST::List(param_vec))
+         : (AST::Term *)new (arena) AST::Grep(start, map_body_term, new (arena) AST::List(param_vec));
 }
 
 static PerlJIT::AST::Term *
 pj_build_logical_assign(pTHX_ BINOP *bo, OPTreeJITCandidateFinder &visitor)
 {
+  AST::Arena &arena = visitor.get_arena();
+
   //  6        <|> orassign(other->7) vK/1 ->9
   //  5           <0> padsv[$x:1,2] sRM ->6
   //  8           <1> sassign sK/BKWARD,1 ->9
@@ -709,7 +724,7 @@ pj_build_logical_assign(pTHX_ BINOP *bo, OPTreeJITCandidateFinder &visitor)
                      : otype == OP_ORASSIGN  ? pj_binop_bool_or
                      :                         pj_binop_definedor;
 
-  PerlJIT::AST::Binop *retval = new AST::Binop((OP *)bo, ttype, left, right);
+  PerlJIT::AST::Binop *retval = new (arena) AST::Binop((OP *)bo, ttype, left, right);
   retval->set_assignment_form(true);
 
   return (PerlJIT::AST::Term *)retval;
@@ -718,6 +733,8 @@ pj_build_logical_assign(pTHX_ BINOP *bo, OPTreeJITCandidateFinder &visitor)
 static PerlJIT::AST::Term *
 pj_build_array_slice(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
 {
+  AST::Arena &arena = visitor.get_arena();
+
 #ifndef NDEBUG
   {
     assert(o->op_flags & OPf_KIDS);
@@ -739,20 +756,21 @@ pj_build_array_slice(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
       && ((AST::Op *)kid_term)->get_op_type() == pj_listop_list2scalar)
   {
     AST::Listop *listop = (AST::Listop *)kid_term;
-    AST::List *tmp = new AST::List(listop->kids);
+    AST::List *tmp = new (arena) AST::List(listop->kids);
     listop->kids.clear();
-    delete kid_term;
     kid_term = (AST::Term *)tmp;
   }
 
   // array
   AST::Term *kid_term2 = pj_build_ast(aTHX_ kid->op_sibling, visitor);
-  return new AST::Binop(o, pj_binop_array_slice, kid_term, kid_term2);
+  return new (arena) AST::Binop(o, pj_binop_array_slice, kid_term, kid_term2);
 }
 
 static PerlJIT::AST::Term *
 pj_build_list_slice(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
 {
+  AST::Arena &arena = visitor.get_arena();
+
 #ifndef NDEBUG
   assert(o->op_flags & OPf_KIDS);
   // Paranoid: Assert two children
@@ -766,25 +784,24 @@ pj_build_list_slice(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
 
   vector<AST::Term *> tmp;
   if (pj_build_kid_terms(aTHX_ ((BINOP *)o)->op_first, visitor, tmp)) {
-    pj_free_term_vector(aTHX_ tmp);
     return NULL;
   }
-  AST::Term *kid1 = new AST::List(tmp);
+  AST::Term *kid1 = new (arena) AST::List(tmp);
 
   tmp.clear();
   if (pj_build_kid_terms(aTHX_ ((BINOP *)o)->op_last, visitor, tmp)) {
-    pj_free_term_vector(aTHX_ tmp);
-    delete kid1;
     return NULL;
   }
 
-  return new AST::Binop(o, pj_binop_list_slice, kid1, new AST::List(tmp));
+  return new (arena) AST::Binop(o, pj_binop_list_slice, kid1, new (arena) AST::List(tmp));
 }
 
 // This handles building SubCall and MethodCall AST nodes
 static PerlJIT::AST::Term *
 pj_build_sub_call(pTHX_ LISTOP *entersub, OPTreeJITCandidateFinder &visitor)
 {
+  AST::Arena &arena = visitor.get_arena();
+
   PerlJIT::AST::Term *retval;
 
   // Fill args array with all entersub kids at first, disassemble later.
@@ -800,7 +817,6 @@ pj_build_sub_call(pTHX_ LISTOP *entersub, OPTreeJITCandidateFinder &visitor)
   }
 
   if (pj_build_kid_terms(aTHX_ parent, visitor, args)) {
-    pj_free_term_vector(aTHX_ args);
     return NULL;
   }
 
@@ -818,10 +834,10 @@ pj_build_sub_call(pTHX_ LISTOP *entersub, OPTreeJITCandidateFinder &visitor)
 
     PerlJIT::AST::Term *invocant = args.front();
     args.erase(args.begin());
-    retval = (PerlJIT::AST::Term *)new PerlJIT::AST::MethodCall((OP *)entersub, cv_source, invocant, args);
+    retval = (PerlJIT::AST::Term *)new (arena) PerlJIT::AST::MethodCall((OP *)entersub, cv_source, invocant, args);
   }
   else {
-    retval = (PerlJIT::AST::Term *)new PerlJIT::AST::SubCall((OP *)entersub, cv_source, args);
+    retval = (PerlJIT::AST::Term *)new (arena) PerlJIT::AST::SubCall((OP *)entersub, cv_source, args);
   }
 
   // Supported construct example dumps following (abbreviated).
@@ -864,6 +880,8 @@ pj_build_sub_call(pTHX_ LISTOP *entersub, OPTreeJITCandidateFinder &visitor)
 static PerlJIT::AST::Term *
 pj_build_sort(pTHX_ OP *sort, OPTreeJITCandidateFinder &visitor)
 {
+  AST::Arena &arena = visitor.get_arena();
+
   PerlJIT::AST::Sort *retval = NULL;
   assert(sort);
 
@@ -871,7 +889,6 @@ pj_build_sort(pTHX_ OP *sort, OPTreeJITCandidateFinder &visitor)
 
   vector<AST::Term *> kid_terms;
   if (pj_build_kid_terms(aTHX_ sort, visitor, kid_terms)) {
-    pj_free_term_vector(aTHX_ kid_terms);
     return NULL;
   }
 
@@ -905,7 +922,7 @@ pj_build_sort(pTHX_ OP *sort, OPTreeJITCandidateFinder &visitor)
   }
   assert(sort_cb);
 
-  retval = new AST::Sort(sort, sort_cb, args);
+  retval = new (arena) AST::Sort(sort, sort_cb, args);
   retval->set_reverse_sort(is_reverse);
   retval->set_std_numeric_sort(is_std_numeric);
   retval->set_in_place_sort(sort->op_private & OPpSORT_INPLACE);
@@ -922,6 +939,8 @@ pj_build_sort(pTHX_ OP *sort, OPTreeJITCandidateFinder &visitor)
 static PerlJIT::AST::Term *
 pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
 {
+  AST::Arena &arena = visitor.get_arena();
+
   PerlJIT::AST::Term *retval = NULL;
 
   assert(o);
@@ -932,7 +951,7 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
     // Can't represent OP with AST. So instead, recursively scan for
     // separate candidates and treat as subtree.
     PJ_DEBUG_1("Cannot represent this OP with AST. Emitting OP tree term in AST (Perl OP=%s).\n", OP_NAME(o));
-    retval = new AST::Optree(o);
+    retval = new (arena) AST::Optree(o);
     pj_find_jit_candidates_internal(aTHX_ o, visitor);
     if (PJ_DEBUGGING)
       retval->dump();
@@ -946,7 +965,6 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
 #define MAKE_DEFAULT_KID_VECTOR                           \
   vector<AST::Term *> kid_terms;                          \
   if (pj_build_kid_terms(aTHX_ o, visitor, kid_terms)) {  \
-    pj_free_term_vector(aTHX_ kid_terms);                 \
     return NULL;                                          \
   }                                                       \
 
@@ -954,7 +972,7 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
   case perl_op_type: {                                        \
       MAKE_DEFAULT_KID_VECTOR                                 \
       assert(kid_terms.size() == 0);                          \
-      retval = new AST::Baseop(o, pj_op_type);                \
+      retval = new (arena) AST::Baseop(o, pj_op_type);                \
       retval = pj_build_targmy_assignment(retval, visitor);   \
       break;                                                  \
     }
@@ -963,7 +981,7 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
   case perl_op_type: {                                        \
       MAKE_DEFAULT_KID_VECTOR                                 \
       assert(kid_terms.size() == 1);                          \
-      retval = new AST::Unop(o, pj_op_type, kid_terms[0]);    \
+      retval = new (arena) AST::Unop(o, pj_op_type, kid_terms[0]);    \
       retval = pj_build_targmy_assignment(retval, visitor);   \
       break;                                                  \
     }
@@ -973,9 +991,9 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
       MAKE_DEFAULT_KID_VECTOR                                 \
       assert(kid_terms.size() == 1 || kid_terms.size() == 0); \
       if (kid_terms.size() == 1)                              \
-        retval = new AST::Unop(o, pj_op_type, kid_terms[0]);  \
+        retval = new (arena) AST::Unop(o, pj_op_type, kid_terms[0]);  \
       else /* no kids */                                      \
-        retval = new AST::Unop(o, pj_op_type, NULL);          \
+        retval = new (arena) AST::Unop(o, pj_op_type, NULL);          \
       retval = pj_build_targmy_assignment(retval, visitor);   \
       break;                                                  \
     }
@@ -985,9 +1003,9 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
       MAKE_DEFAULT_KID_VECTOR                                 \
       assert(kid_terms.size() == 1 || kid_terms.size() == 0); \
       if (kid_terms.size() == 1)                              \
-        retval = new AST::Unop(o, pj_op_type, kid_terms[0]);  \
+        retval = new (arena) AST::Unop(o, pj_op_type, kid_terms[0]);  \
       else /* no kids */                                      \
-        retval = new AST::Unop(o, pj_op_type, NULL);          \
+        retval = new (arena) AST::Unop(o, pj_op_type, NULL);          \
       ((AST::Op *)retval)->set_integer_variant(true);         \
       retval = pj_build_targmy_assignment(retval, visitor);   \
       break;                                                  \
@@ -997,7 +1015,7 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
   case perl_op_type: {                                                    \
       MAKE_DEFAULT_KID_VECTOR                                             \
       assert(kid_terms.size() == 2);                                      \
-      retval = new AST::Binop(o, pj_op_type, kid_terms[0], kid_terms[1]); \
+      retval = new (arena) AST::Binop(o, pj_op_type, kid_terms[0], kid_terms[1]); \
       retval = pj_build_targmy_assignment(retval, visitor);               \
       break;                                                              \
     }
@@ -1006,7 +1024,7 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
   case perl_op_type: {                                                    \
       MAKE_DEFAULT_KID_VECTOR                                             \
       assert(kid_terms.size() == 2);                                      \
-      retval = new AST::Binop(o, pj_op_type, kid_terms[0], kid_terms[1]); \
+      retval = new (arena) AST::Binop(o, pj_op_type, kid_terms[0], kid_terms[1]); \
       ((AST::Op *)retval)->set_integer_variant(true);                     \
       retval = pj_build_targmy_assignment(retval, visitor);               \
       break;                                                              \
@@ -1018,7 +1036,7 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
       assert(kid_terms.size() <= 2);                                      \
       if (kid_terms.size() < 2)                                           \
         kid_terms.push_back(NULL);                                        \
-      retval = new AST::Binop(o, pj_op_type, kid_terms[0], kid_terms[1]); \
+      retval = new (arena) AST::Binop(o, pj_op_type, kid_terms[0], kid_terms[1]); \
       retval = pj_build_targmy_assignment(retval, visitor);               \
       break;                                                              \
     }
@@ -1026,7 +1044,7 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
 #define EMIT_LISTOP_CODE(perl_op_type, pj_op_type)        \
   case perl_op_type: {                                    \
       MAKE_DEFAULT_KID_VECTOR                             \
-      retval = new AST::Listop(o, pj_op_type, kid_terms); \
+      retval = new (arena) AST::Listop(o, pj_op_type, kid_terms); \
       break;                                              \
     }
 
@@ -1035,23 +1053,23 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
       // FIXME OP_CONST can also be who-knows-what-else
       SV *constsv = cSVOPx_sv(o);
       if (SvIOK(constsv)) {
-        retval = new AST::NumericConstant(o, (IV)SvIV(constsv));
+        retval = new (arena) AST::NumericConstant(o, (IV)SvIV(constsv));
       }
       else if (SvUOK(constsv)) {
-        retval = new AST::NumericConstant(o, (UV)SvUV(constsv));
+        retval = new (arena) AST::NumericConstant(o, (UV)SvUV(constsv));
       }
       else if (SvNOK(constsv)) {
-        retval = new AST::NumericConstant(o, (NV)SvNV(constsv));
+        retval = new (arena) AST::NumericConstant(o, (NV)SvNV(constsv));
       }
       else if (SvPOK(constsv)) {
-        retval = new AST::StringConstant(aTHX_ o, constsv);
+        retval = new (arena) AST::StringConstant(aTHX_ o, constsv);
       }
       else { // FAIL. Cast to NV
         if (PJ_DEBUGGING) {
           PJ_DEBUG("Casting OP_CONST's SV to an NV since type is unclear. SV dump follows:");
           sv_dump(constsv);
         }
-        retval = new AST::NumericConstant(o, (NV)SvNV(constsv));
+        retval = new (arena) AST::NumericConstant(o, (NV)SvNV(constsv));
       }
 
       break;
@@ -1063,25 +1081,23 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
     if (o->op_private & OPpLVAL_INTRO)
       retval = visitor.get_declaration(o, o);
     else
-      retval = new AST::Lexical(o, visitor.get_declaration(0, o));
+      retval = new (arena) AST::Lexical(o, visitor.get_declaration(0, o));
     break;
 
   case OP_GVSV:
     // FIXME OP_GVSV with OPpLVAL_INTRO is "local $x"
-    retval = new AST::Global(o, pj_sigil_scalar);
-    pj_free_term_vector(aTHX_ kid_terms);
+    retval = new (arena) AST::Global(o, pj_sigil_scalar);
     break;
 
   case OP_GV:
-    retval = new AST::Global(o, pj_sigil_glob);
-    pj_free_term_vector(aTHX_ kid_terms);
+    retval = new (arena) AST::Global(o, pj_sigil_glob);
     break;
 
   case OP_RV2CV: {
       if (cUNOPo->op_first->op_type == OP_GV)
-        retval = new AST::Global(o, pj_sigil_code);
+        retval = new (arena) AST::Global(o, pj_sigil_code);
       else
-        retval = new AST::Unop(o, pj_unop_cv_deref, pj_build_ast(aTHX_ cUNOPo->op_first, visitor));
+        retval = new (arena) AST::Unop(o, pj_unop_cv_deref, pj_build_ast(aTHX_ cUNOPo->op_first, visitor));
 
       break;
     }
@@ -1089,35 +1105,35 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
   case OP_RV2AV: {
       OP *kid = cUNOPo->op_first;
       if (kid->op_type == OP_GV)
-        retval = new AST::Global(o, pj_sigil_array);
+        retval = new (arena) AST::Global(o, pj_sigil_array);
       else if (kid->op_type == OP_CONST) {
         // It's a constant array such as in: $x = [1..3]
         // TODO consider whether we want to represent this differently in the AST
         SV *rv = cSVOPx_sv(kid);
         assert(SvROK(rv));
         assert(SvTYPE(SvRV(rv)) == SVt_PVAV);
-        retval = new AST::ArrayConstant(kid, (AV *)SvRV(rv));
+        retval = new (arena) AST::ArrayConstant(kid, (AV *)SvRV(rv));
       }
       else
-        retval = new AST::Unop(o, pj_unop_av_deref, pj_build_ast(aTHX_ kid, visitor));
+        retval = new (arena) AST::Unop(o, pj_unop_av_deref, pj_build_ast(aTHX_ kid, visitor));
 
       break;
     }
 
   case OP_RV2HV: {
       if (cUNOPo->op_first->op_type == OP_GV)
-        retval = new AST::Global(o, pj_sigil_hash);
+        retval = new (arena) AST::Global(o, pj_sigil_hash);
       else
-        retval = new AST::Unop(o, pj_unop_hv_deref, pj_build_ast(aTHX_ cUNOPo->op_first, visitor));
+        retval = new (arena) AST::Unop(o, pj_unop_hv_deref, pj_build_ast(aTHX_ cUNOPo->op_first, visitor));
 
       break;
     }
 
   case OP_RV2GV: {
       if (cUNOPo->op_first->op_type == OP_GV)
-        retval = new AST::Global(o, pj_sigil_glob);
+        retval = new (arena) AST::Global(o, pj_sigil_glob);
       else
-        retval = new AST::Unop(o, pj_unop_gv_deref, pj_build_ast(aTHX_ cUNOPo->op_first, visitor));
+        retval = new (arena) AST::Unop(o, pj_unop_gv_deref, pj_build_ast(aTHX_ cUNOPo->op_first, visitor));
 
       break;
     }
@@ -1133,7 +1149,7 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
         l->kids.pop_back();
         kid_terms.push_back(rep);
       }
-      retval = new AST::Listop(o, pj_listop_repeat, kid_terms);
+      retval = new (arena) AST::Listop(o, pj_listop_repeat, kid_terms);
       break;
     }
 
@@ -1146,11 +1162,9 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
         // AELEMFASTified aelem!
         PJ_DEBUG("Passing through kid of ex-aelem\n");
         retval = kid_terms[0];
-        if (kid_terms.size() > 1)
-          delete kid_terms[1];
       }
       else if (targ_otype == OP_LIST) {
-        retval = new AST::List(kid_terms);
+        retval = new (arena) AST::List(kid_terms);
       }
       else if (targ_otype == OP_REVERSE
                && kid_terms.size() == 1
@@ -1181,8 +1195,7 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
           default:
             PJ_DEBUG_1("Cannot represent this NULL OP with AST. Emitting OP tree term in AST. (%s)\n", OP_NAME(o));
             pj_find_jit_candidates_internal(aTHX_ o, visitor);
-            retval = new AST::Optree(o);
-            pj_free_term_vector(aTHX_ kid_terms);
+            retval = new (arena) AST::Optree(o);
             break;
           }
         }
@@ -1190,8 +1203,7 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
       else {
         PJ_DEBUG_1("Cannot represent this NULL OP with AST. Emitting OP tree term in AST. (%s)\n", OP_NAME(o));
         pj_find_jit_candidates_internal(aTHX_ o, visitor);
-        retval = new AST::Optree(o);
-        pj_free_term_vector(aTHX_ kid_terms);
+        retval = new (arena) AST::Optree(o);
       }
       break;
     }
@@ -1211,29 +1223,29 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
       if (otype == OP_AELEMFAST_LEX) {
 #endif
         // lexical
-        array = new AST::Lexical(o, visitor.get_declaration(0, o));
+        array = new (arena) AST::Lexical(o, visitor.get_declaration(0, o));
       }
       else {
         // package var
-        array = new AST::Global(o, pj_sigil_array);
+        array = new (arena) AST::Global(o, pj_sigil_array);
       }
       // aelemfast trick: embed array index in private flag space m(
-      AST::Term *constant = new AST::NumericConstant(o, (IV)o->op_private);
-      retval = new AST::Binop(o, pj_binop_aelem, array, constant);
+      AST::Term *constant = new (arena) AST::NumericConstant(o, (IV)o->op_private);
+      retval = new (arena) AST::Binop(o, pj_binop_aelem, array, constant);
       break;
   }
 
   case OP_SASSIGN: {
       MAKE_DEFAULT_KID_VECTOR
       assert(kid_terms.size() == 2);
-      retval = new AST::Binop(o, pj_binop_sassign, kid_terms[1], kid_terms[0]);
+      retval = new (arena) AST::Binop(o, pj_binop_sassign, kid_terms[1], kid_terms[0]);
       break;
     }
 
   case OP_AASSIGN: {
       MAKE_DEFAULT_KID_VECTOR
       assert(kid_terms.size() == 2);
-      retval = new AST::Binop(o, pj_binop_aassign, kid_terms[1], kid_terms[0]);
+      retval = new (arena) AST::Binop(o, pj_binop_aassign, kid_terms[1], kid_terms[0]);
       break;
     }
 
@@ -1245,14 +1257,14 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
 
       // Truly empty block
       if (!sibling && OP_TYPE_IS_NN(kid, OP_STUB)) {
-        retval = new AST::Empty();
+        retval = new (arena) AST::Empty();
       }
       else {
         // Else build a Block/Scope node around the result of recursing
         // Some OP_SCOPEs ("foo when 2") don't even have a nextstate.
         retval = pj_build_ast(aTHX_ sibling ? sibling : kid, visitor);
         if (retval->get_type() != pj_ttype_empty)
-          retval = new AST::Block(o, retval);
+          retval = new (arena) AST::Block(o, retval);
       }
       break;
     }
@@ -1279,7 +1291,7 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
       // assume a do{} block without modifier
       if (!retval) {
         AST::Term *statements = pj_build_block_or_term(aTHX_ start, visitor);
-        retval = new AST::Block(o, statements);
+        retval = new (arena) AST::Block(o, statements);
       }
 
       break;
@@ -1322,7 +1334,7 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
       pj_op_type ttype = otype == OP_DELETE
                          ? pj_binop_delete
                          : pj_binop_exists;
-      retval = new AST::Binop(o, ttype, hash_or_array, key);
+      retval = new (arena) AST::Binop(o, ttype, hash_or_array, key);
       break;
     }
 
@@ -1330,15 +1342,15 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
       const int gimme = OP_GIMME(o, 0);
       if (gimme) {
         if (gimme == OPf_WANT_SCALAR) {
-          retval = new AST::UndefConstant();
+          retval = new (arena) AST::UndefConstant();
         }
         else { // list or void context
           // FIXME really, empty list
-          retval = new AST::Baseop(o, pj_baseop_empty);
+          retval = new (arena) AST::Baseop(o, pj_baseop_empty);
         }
       }
       else { // undecidable yet
-        retval = new AST::Baseop(o, pj_baseop_empty);
+        retval = new (arena) AST::Baseop(o, pj_baseop_empty);
       }
       break;
     }
@@ -1349,11 +1361,11 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
         retval = kid_terms[0];
       else if (pj_op_context(OP_GIMME(o, pj_context_caller)) == pj_context_list) {
         // FIXME this can often be flattened into the parent list!?
-        retval = new AST::List(kid_terms);
+        retval = new (arena) AST::List(kid_terms);
         retval->set_perl_op(NULL); // likely unnecessary, but just in case
       }
       else
-        retval = new AST::Listop(o, pj_listop_list2scalar, kid_terms);
+        retval = new (arena) AST::Listop(o, pj_listop_list2scalar, kid_terms);
       break;
     }
 
@@ -1379,7 +1391,7 @@ pj_build_ast(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
       MAKE_DEFAULT_KID_VECTOR
       assert(kid_terms.size() == 1 || kid_terms.size() == 0);
       AST::LoopControlStatement *lcs
-        = new AST::LoopControlStatement(aTHX_ o, kid_terms.empty() ? NULL : kid_terms[0]);
+        = new (arena) AST::LoopControlStatement(aTHX_ o, kid_terms.empty() ? NULL : kid_terms[0]);
       retval = lcs;
       if (!lcs->label_is_dynamic())
         visitor.get_loop_control_tracker().add_loop_control_node(aTHX_ lcs);
@@ -1473,6 +1485,7 @@ pj_attempt_jit(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
   if (PJ_DEBUGGING)
     printf("Attempting JIT on %s (%p, %p)\n", OP_NAME(o), (void*)o, (void*)o->op_next);
 
+  PhaseTimer timer(pj_phase_build_ast);
   ast = pj_build_ast(aTHX_ o, visitor);
 
   return ast;
@@ -1490,7 +1503,7 @@ pj_find_jit_candidates_internal(pTHX_ OP *o, OPTreeJITCandidateFinder &visitor)
 }
 
 vector<PerlJIT::AST::Term *>
-pj_find_jit_candidates(pTHX_ SV *coderef)
+pj_find_jit_candidates(pTHX_ SV *coderef, PerlJIT::AST::Arena &arena)
 {
   if (!SvROK(coderef) || SvTYPE(SvRV(coderef)) != SVt_PVCV)
     croak("Need a code reference");
@@ -1502,8 +1515,15 @@ pj_find_jit_candidates(pTHX_ SV *coderef)
   PL_comppad = PadlistARRAY(CvPADLIST(cv))[1];
   PL_curpad = AvARRAY(PL_comppad);
 
-  OPTreeJITCandidateFinder visitor(aTHX_ cv);
-  vector<PerlJIT::AST::Term *> tmp = pj_find_jit_candidates_internal(aTHX_ CvROOT(cv), visitor);
+  OPTreeJITCandidateFinder visitor(aTHX_ cv, arena);
+  vector<PerlJIT::AST::Term *> tmp;
+  {
+    PhaseTimer timer(pj_phase_find_candidates);
+
+    tmp = pj_find_jit_candidates_internal(aTHX_ CvROOT(cv), visitor);
+  }
+  pj_infer_lexical_types(aTHX_ cv, tmp);
+
   if (PJ_DEBUGGING) {
     printf("%i JIT candidate ASTs:\n", (int)tmp.size());
     for (unsigned int i = 0; i < (unsigned int)tmp.size(); ++i) {
@@ -14,7 +14,7 @@
  * and perform actual replacement if at all. */
 /* This function will internally call pj_attempt_jit on candidates,
  * which will, in turn, call this function on subtrees that it cannot
- * JIT. */
-std::vector<PerlJIT::AST::Term *> pj_find_jit_candidates(pTHX_ SV *coderef);
+ * JIT. The ASTs are allocated in arena. */
+std::vector<PerlJIT::AST::Term *> pj_find_jit_candidates(pTHX_ SV *coderef, PerlJIT::AST::Arena &arena);
 
 #endif
@@ -0,0 +1,118 @@
+#include "pj_perf_counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+
+using namespace PerlJIT;
+
+#ifdef __linux__
+
+#define HW_CACHE_MISS(cache) \
+  ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+  const char *name;
+  uint32_t type;
+  uint64_t config;
+} events[] = {
+  { "cycles",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { "instructions",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+  { "l1d_misses",    PERF_TYPE_HW_CACHE, HW_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D) },
+  { "llc_misses",    PERF_TYPE_HW_CACHE, HW_CACHE_MISS(PERF_COUNT_HW_CACHE_LL) },
+  { "itlb_misses",   PERF_TYPE_HW_CACHE, HW_CACHE_MISS(PERF_COUNT_HW_CACHE_ITLB) },
+};
+
+PerfCounters::PerfCounters()
+{
+  for (size_t i = 0; i < sizeof(events) / sizeof(events[0]); ++i) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[i].type;
+    attr.config = events[i].config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd == -1)
+      continue;
+
+    Counter counter = { events[i].name, fd };
+    counters.push_back(counter);
+  }
+}
+
+PerfCounters::~PerfCounters()
+{
+  for (size_t i = 0, max = counters.size(); i < max; ++i)
+    close(counters[i].fd);
+}
+
+void
+PerfCounters::start()
+{
+  for (size_t i = 0, max = counters.size(); i < max; ++i) {
+    ioctl(counters[i].fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(counters[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+void
+PerfCounters::stop()
+{
+  for (size_t i = 0, max = counters.size(); i < max; ++i)
+    ioctl(counters[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+}
+
+SV *
+PerfCounters::counts() const
+{
+  dTHX;
+  HV *counts = newHV();
+
+  for (size_t i = 0, max = counters.size(); i < max; ++i) {
+    // value, time enabled, time running
+    uint64_t values[3];
+
+    if (read(counters[i].fd, values, sizeof(values)) != sizeof(values) || !values[2])
+      continue;
+
+    double scaled = values[2] < values[1] ? (double) values[0] * values[1] / values[2] : values[0];
+    hv_store(counts, counters[i].name, strlen(counters[i].name), newSVnv(scaled), 0);
+  }
+
+  return newRV_noinc((SV *) counts);
+}
+
+#else
+
+PerfCounters::PerfCounters() { }
+PerfCounters::~PerfCounters() { }
+void PerfCounters::start() { }
+void PerfCounters::stop() { }
+
+SV *
+PerfCounters::counts() const
+{
+  dTHX;
+
+  return newRV_noinc((SV *) newHV());
+}
+
+#endif
+
+bool
+PerfCounters::is_available() const
+{
+  return !counters.empty();
+}
@@ -0,0 +1,42 @@
+#ifndef PJ_PERF_COUNTERS_H_
+#define PJ_PERF_COUNTERS_H_
+
+/* Hardware performance counters, for benchmarks */
+
+#include <EXTERN.h>
+#include <perl.h>
+
+#include <vector>
+
+namespace PerlJIT {
+  // Counts cycles, instructions, branch misses, L1 data/LLC/iTLB
+  // misses of the calling thread (user space only) using
+  // perf_event_open; counters the CPU or the kernel don't support are
+  // skipped, and all of them are on Linux only. When there are more
+  // events than hardware counters the kernel multiplexes them, and the
+  // counts are scaled to the whole measurement.
+  class PerfCounters {
+  public:
+    PerfCounters();
+    ~PerfCounters();
+
+    bool is_available() const;
+
+    // resets and enables the counters
+    void start();
+    void stop();
+
+    // hash of event name => count, for the supported events
+    SV *counts() const;
+
+  private:
+    struct Counter {
+      const char *name;
+      int fd;
+    };
+
+    std::vector<Counter> counters;
+  };
+}
+
+#endif // PJ_PERF_COUNTERS_H_
@@ -0,0 +1,301 @@
+#include "pj_perf_map.h"
+
+#include <llvm/IR/Function.h>
+#include <llvm/DebugInfo.h>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <vector>
+
+using namespace PerlJIT;
+using namespace llvm;
+using namespace std;
+
+// see tools/perf/Documentation/jitdump-specification.txt in the Linux
+// sources
+#define JITDUMP_MAGIC       0x4A695444
+#define JITDUMP_VERSION     1
+#define JIT_CODE_LOAD       0
+#define JIT_CODE_DEBUG_INFO 2
+
+#if defined(__x86_64__)
+#  define JITDUMP_ELF_MACH EM_X86_64
+#elif defined(__i386__)
+#  define JITDUMP_ELF_MACH EM_386
+#elif defined(__aarch64__)
+#  define JITDUMP_ELF_MACH EM_AARCH64
+#elif defined(__arm__)
+#  define JITDUMP_ELF_MACH EM_ARM
+#else
+#  define JITDUMP_ELF_MACH EM_NONE
+#endif
+
+namespace {
+  struct JitdumpHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t total_size;
+    uint32_t elf_mach;
+    uint32_t pad1;
+    uint32_t pid;
+    uint64_t timestamp;
+    uint64_t flags;
+  };
+
+  struct JitdumpCodeLoad {
+    uint32_t id;
+    uint32_t total_size;
+    uint64_t timestamp;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t vma;
+    uint64_t code_addr;
+    uint64_t code_size;
+    uint64_t code_index;
+    // followed by the NUL-terminated name and the code
+  };
+
+  struct JitdumpDebugInfo {
+    uint32_t id;
+    uint32_t total_size;
+    uint64_t timestamp;
+    uint64_t code_addr;
+    uint64_t nr_entry;
+    // followed by the entries
+  };
+
+  struct JitdumpDebugEntry {
+    uint64_t addr;
+    int32_t lineno;
+    int32_t discrim;
+    // followed by the NUL-terminated file name
+  };
+
+  pthread_mutex_t perf_mutex = PTHREAD_MUTEX_INITIALIZER;
+  // the process the files below belong to
+  pid_t perf_pid = 0;
+  FILE *map_file = NULL;
+  int dump_fd = -1;
+  // perf finds the jitdump file through this (executable) mapping
+  void *dump_marker = NULL;
+  size_t dump_marker_size = 0;
+  uint64_t code_index = 0;
+}
+
+// jitdump timestamps must match the perf record clock (-k mono)
+static uint64_t
+timestamp()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void
+close_files()
+{
+  if (map_file)
+    fclose(map_file);
+  if (dump_marker)
+    munmap(dump_marker, dump_marker_size);
+  if (dump_fd != -1)
+    close(dump_fd);
+
+  map_file = NULL;
+  dump_marker = NULL;
+  dump_fd = -1;
+}
+
+static void
+open_jitdump()
+{
+  ostringstream path;
+
+  path << "/tmp/jit-" << perf_pid << ".dump";
+  dump_fd = open(path.str().c_str(), O_CREAT | O_TRUNC | O_RDWR, 0666);
+  if (dump_fd == -1)
+    return;
+
+  dump_marker_size = sysconf(_SC_PAGESIZE);
+  dump_marker = mmap(NULL, dump_marker_size, PROT_READ | PROT_EXEC, MAP_PRIVATE, dump_fd, 0);
+  if (dump_marker == MAP_FAILED) {
+    dump_marker = NULL;
+    close(dump_fd);
+    dump_fd = -1;
+    return;
+  }
+
+  JitdumpHeader header;
+
+  memset(&header, 0, sizeof(header));
+  header.magic = JITDUMP_MAGIC;
+  header.version = JITDUMP_VERSION;
+  header.total_size = sizeof(header);
+  header.elf_mach = JITDUMP_ELF_MACH;
+  header.pid = perf_pid;
+  header.timestamp = timestamp();
+
+  if (write(dump_fd, &header, sizeof(header)) != sizeof(header))
+    close_files();
+}
+
+// must be called with perf_mutex held
+static void
+open_files(int outputs)
+{
+  if (perf_pid != getpid()) {
+    // inherited from the parent process
+    close_files();
+    perf_pid = getpid();
+    code_index = 0;
+  }
+
+  if ((outputs & pj_perf_map) && !map_file) {
+    ostringstream path;
+
+    path << "/tmp/perf-" << perf_pid << ".map";
+    map_file = fopen(path.str().c_str(), "a");
+  }
+
+  if ((outputs & pj_perf_jitdump) && dump_fd == -1)
+    open_jitdump();
+}
+
+template<class T>
+static void
+append_bytes(vector<char> &buffer, const T &value)
+{
+  buffer.insert(buffer.end(), (const char *) &value, (const char *) &value + sizeof(value));
+}
+
+// Line table of a function, from the debug locations of its code; must
+// precede the code load record
+static void
+write_jitdump_lines(const Function &function, void *code,
+                    const JITEvent_EmittedFunctionDetails &details)
+{
+  const vector<JITEvent_EmittedFunctionDetails::LineStart> &lines = details.LineStarts;
+  JitdumpDebugInfo record;
+  vector<char> entries;
+
+  if (lines.empty())
+    return;
+
+  for (size_t i = 0, max = lines.size(); i < max; ++i) {
+    DIScope scope(lines[i].Loc.getScope(function.getContext()));
+    string file = scope.getFilename().str();
+    JitdumpDebugEntry entry;
+
+    entry.addr = lines[i].Address;
+    entry.lineno = lines[i].Loc.getLine();
+    entry.discrim = 0;
+    append_bytes(entries, entry);
+    entries.insert(entries.end(), file.c_str(), file.c_str() + file.size() + 1);
+  }
+
+  record.id = JIT_CODE_DEBUG_INFO;
+  record.total_size = sizeof(record) + entries.size();
+  record.timestamp = timestamp();
+  record.code_addr = (uint64_t) (uintptr_t) code;
+  record.nr_entry = lines.size();
+
+  vector<char> buffer;
+
+  buffer.reserve(record.total_size);
+  append_bytes(buffer, record);
+  buffer.insert(buffer.end(), entries.begin(), entries.end());
+
+  if (write(dump_fd, &buffer[0], buffer.size()) != (ssize_t) buffer.size())
+    close_files();
+}
+
+static void
+write_jitdump(const string &name, void *code, size_t size)
+{
+  JitdumpCodeLoad record;
+  vector<char> buffer;
+
+  record.id = JIT_CODE_LOAD;
+  record.total_size = sizeof(record) + name.size() + 1 + size;
+  record.timestamp = timestamp();
+  record.pid = perf_pid;
+  record.tid = syscall(SYS_gettid);
+  record.vma = record.code_addr = (uint64_t) (uintptr_t) code;
+  record.code_size = size;
+  record.code_index = code_index++;
+
+  // a single write, so records are never interleaved
+  buffer.reserve(record.total_size);
+  append_bytes(buffer, record);
+  buffer.insert(buffer.end(), name.c_str(), name.c_str() + name.size() + 1);
+  buffer.insert(buffer.end(), (char *) code, (char *) code + size);
+
+  if (write(dump_fd, &buffer[0], buffer.size()) != (ssize_t) buffer.size())
+    close_files();
+}
+
+bool
+PerlJIT::pj_parse_perf_outputs(const string &spec, int &outputs)
+{
+  istringstream names(spec);
+  string name;
+
+  outputs = 0;
+  while (getline(names, name, ',')) {
+    if (name == "map")
+      outputs |= pj_perf_map;
+    else if (name == "jitdump")
+      outputs |= pj_perf_jitdump;
+    else if (!name.empty())
+      return false;
+  }
+
+  return true;
+}
+
+PerfMapListener::PerfMapListener() :
+  outputs(0)
+{
+}
+
+void
+PerfMapListener::enable(int _outputs)
+{
+  outputs |= _outputs;
+}
+
+void
+PerfMapListener::NotifyFunctionEmitted(const Function &function, void *code, size_t size,
+                                       const EmittedFunctionDetails &details)
+{
+  if (!outputs)
+    return;
+
+  string name = function.hasName() ? function.getName().str() : "Perl::JIT region";
+
+  pthread_mutex_lock(&perf_mutex);
+  open_files(outputs);
+
+  if ((outputs & pj_perf_map) && map_file) {
+    fprintf(map_file, "%lx %lx %s\n", (unsigned long) code, (unsigned long) size, name.c_str());
+    fflush(map_file);
+  }
+  if ((outputs & pj_perf_jitdump) && dump_fd != -1) {
+    write_jitdump_lines(function, code, details);
+    if (dump_fd != -1)
+      write_jitdump(name, code, size);
+  }
+
+  pthread_mutex_unlock(&perf_mutex);
+}
@@ -0,0 +1,40 @@
+#ifndef PJ_PERF_MAP_H_
+#define PJ_PERF_MAP_H_
+
+#include <llvm/ExecutionEngine/JITEventListener.h>
+
+#include <string>
+
+namespace PerlJIT {
+  // Symbol files for Linux perf, bitmask
+  enum {
+    // /tmp/perf-<pid>.map, read by perf report
+    pj_perf_map = 1,
+    // /tmp/jit-<pid>.dump, for perf inject --jit; includes the code,
+    // so samples in freed and reused code are attributed correctly
+    pj_perf_jitdump = 2
+  };
+
+  // Parses a comma-separated list of outputs ("map", "jitdump");
+  // returns false for unknown names
+  bool pj_parse_perf_outputs(const std::string &spec, int &outputs);
+
+  // Describes the machine code of JITted functions to perf, using the
+  // function names; the files are shared by all interpreters in the
+  // process, and reopened after a fork
+  class PerfMapListener : public llvm::JITEventListener {
+  public:
+    PerfMapListener();
+
+    // outputs are only ever added
+    void enable(int outputs);
+
+    virtual void NotifyFunctionEmitted(const llvm::Function &function, void *code, size_t size,
+                                       const EmittedFunctionDetails &details);
+
+  private:
+    int outputs;
+  };
+}
+
+#endif // PJ_PERF_MAP_H_
@@ -1,5 +1,6 @@
 #include "pj_perlapi.h"
 
+#include <llvm/Config/llvm-config.h>
 #include <llvm/IR/Constants.h>
 
 using namespace PerlJIT;
@@ -12,33 +13,56 @@ using namespace llvm;
 #define jit_aTHX  arg_thx
 #define jit_aTHX_ arg_thx,
 
-static void
-_pa_call_runloop(pTHX_ OP *op)
-{
-  OP *oldop = PL_op;
-  PL_op = op;
-  CALLRUNOPS(aTHX);
-  PL_op = oldop;
-}
-
-PerlAPI::PerlAPI(Module *_module, IRBuilder<> *_builder, ExecutionEngine *ee) :
+// Perl API functions the snippets only call on their slow paths:
+// magic, conversion of non-numeric values and stack reallocation
+static const char *cold_functions[] = {
+  "Perl_mg_get",
+  "Perl_mg_set",
+  "Perl_sv_2iv",
+  "Perl_sv_2iv_flags",
+  "Perl_sv_2nv",
+  "Perl_sv_2nv_flags",
+  "Perl_stack_grow",
+  NULL
+};
+
+PerlAPI::PerlAPI(Module *_module, IRBuilder<> *_builder) :
   PerlAPIBase(_module, _builder)
 {
-  llvm::Type *void_type = Type::getVoidTy(module->getContext());
-  llvm::Type *op_ptr_type = module->getTypeByName("struct.op")->getPointerTo();
-
+  op_ptr_type = module->getTypeByName("struct.op")->getPointerTo();
   interpreter_type = module->getTypeByName("struct.interpreter")->getPointerTo();
   ptr_sv_type = module->getTypeByName("struct.sv")->getPointerTo();
 
   ptr_type = IntegerType::get(module->getContext(), 8)->getPointerTo();
   ptr_ptr_sv_type = ptr_sv_type->getPointerTo();
   pp_type = function_type(op_ptr_type, jit_tTHX_ NULL);
+#ifdef USE_ITHREADS
+  void_thx_type = function_type(Type::getVoidTy(module->getContext()), jit_tTHX_ NULL);
+#else
+  void_thx_type = function_type(Type::getVoidTy(module->getContext()), NULL);
+#endif
+
+  // The snippets are expanded inline, so the only calls left in JITted
+  // code are to the Perl API itself; none of them unwinds (croak uses
+  // longjmp), which lets LLVM drop the exception edges
+  for (Module::iterator it = module->begin(), end = module->end(); it != end; ++it)
+    if (it->isDeclaration())
+      it->addFnAttr(Attribute::NoUnwind);
+
+  for (const char **name = cold_functions; *name; ++name)
+    if (Function *function = module->getFunction(*name))
+      mark_cold(function);
+}
 
-  // TODO autogenerate
-  pa_call_runloop = Function::Create(
-      function_type(void_type, jit_tTHX_ ptr_type, NULL),
-      GlobalValue::ExternalLinkage, "_pa_call_runloop", module);
-  ee->addGlobalMapping(pa_call_runloop, (void *) _pa_call_runloop);
+// Branches leading to calls of cold functions are predicted not
+// taken, and the blocks containing them are moved out of the hot
+// path by block placement (the attribute is new in LLVM 3.4)
+void
+PerlAPI::mark_cold(Function *function)
+{
+#if LLVM_VERSION_MAJOR > 3 || LLVM_VERSION_MINOR >= 4
+  function->addFnAttr(Attribute::Cold);
+#endif
 }
 
 void
@@ -49,9 +73,19 @@ PerlAPI::alloc_sp()
 }
 
 void
-PerlAPI::emit_call_runloop(OP *op)
+PerlAPI::emit_call_runloop(Value *op)
+{
+  emit_CALLRUNOPS(op);
+}
+
+void
+PerlAPI::emit_call_helper(Function *helper)
 {
-  builder->CreateCall2(pa_call_runloop, jit_aTHX_ UV_constant(PTR2UV(op)));
+#ifdef USE_ITHREADS
+  builder->CreateCall(helper, jit_aTHX);
+#else
+  builder->CreateCall(helper);
+#endif
 }
 
 Value *
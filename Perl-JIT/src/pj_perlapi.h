@@ -5,18 +5,22 @@
 
 #undef Copy
 
-#include <llvm/ExecutionEngine/ExecutionEngine.h>
-
 namespace PerlJIT {
   class PerlAPI : public PerlAPIBase {
   public:
-    PerlAPI(llvm::Module *module, llvm::IRBuilder<> *builder, llvm::ExecutionEngine *ee);
+    PerlAPI(llvm::Module *module, llvm::IRBuilder<> *builder);
 
     void alloc_sp();
+    void mark_cold(llvm::Function *function);
 
     llvm::FunctionType *ppaddr_type() const { return pp_type; }
+    // type for void (pTHX) helper functions
+    llvm::FunctionType *helper_type() const { return void_thx_type; }
+
+    llvm::Type *op_type() const { return op_ptr_type; }
 
-    void emit_call_runloop(OP *op);
+    void emit_call_runloop(llvm::Value *op);
+    void emit_call_helper(llvm::Function *helper);
 
     llvm::Value *emit_pad_sv(UV padix);
     llvm::Value *emit_pad_sv_address(UV padix);
@@ -28,12 +32,9 @@ namespace PerlJIT {
     llvm::Value *interp_value(unsigned int offset, llvm::Type *type, const llvm::Twine &name);
     llvm::FunctionType *function_type(llvm::Type *ret, ...);
 
-    llvm::Type *ptr_type;
+    llvm::Type *ptr_type, *op_ptr_type;
     llvm::Type *interpreter_type, *ptr_sv_type, *ptr_ptr_sv_type;
-    llvm::FunctionType *pp_type;
-
-    // TODO autogenerate
-    llvm::Function *pa_call_runloop;
+    llvm::FunctionType *pp_type, *void_thx_type;
   };
 }
 
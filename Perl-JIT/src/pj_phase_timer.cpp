@@ -0,0 +1,91 @@
+#include "pj_phase_timer.h"
+
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+using namespace PerlJIT;
+
+static const char *phase_names[] = {
+  "find_candidates",
+  "build_ast",
+  "infer_types",
+  "emit",
+  "optimize",
+  "codegen",
+  "cache",
+};
+
+// updated atomically, timers also run on the compile thread
+static uint64_t phase_ns[pj_phase_count];
+static uint64_t phase_calls[pj_phase_count];
+
+// exclusive time of all the timers completed on this thread
+static __thread uint64_t thread_timed_ns;
+
+static uint64_t
+now_ns()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+PhaseTimer::PhaseTimer(pj_phase _phase) :
+  phase(_phase), start(now_ns()), nested_start(thread_timed_ns)
+{
+}
+
+PhaseTimer::~PhaseTimer()
+{
+  uint64_t elapsed = now_ns() - start;
+  uint64_t nested = thread_timed_ns - nested_start;
+  uint64_t exclusive = elapsed > nested ? elapsed - nested : 0;
+
+  thread_timed_ns += exclusive;
+  __sync_fetch_and_add(&phase_ns[phase], exclusive);
+  __sync_fetch_and_add(&phase_calls[phase], 1);
+}
+
+SV *
+PerlJIT::pj_phase_times()
+{
+  dTHX;
+  HV *times = newHV();
+
+  for (int i = 0; i < pj_phase_count; ++i) {
+    HV *phase = newHV();
+
+    hv_stores(phase, "seconds", newSVnv(__sync_fetch_and_add(&phase_ns[i], 0) / 1e9));
+    hv_stores(phase, "count", newSVuv(__sync_fetch_and_add(&phase_calls[i], 0)));
+    hv_store(times, phase_names[i], strlen(phase_names[i]), newRV_noinc((SV *) phase), 0);
+  }
+
+  return newRV_noinc((SV *) times);
+}
+
+void
+PerlJIT::pj_reset_phase_times()
+{
+  for (int i = 0; i < pj_phase_count; ++i) {
+    __sync_fetch_and_and(&phase_ns[i], 0);
+    __sync_fetch_and_and(&phase_calls[i], 0);
+  }
+}
+
+UV
+PerlJIT::pj_peak_rss()
+{
+  struct rusage usage;
+
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  // kilobytes
+  return (UV) usage.ru_maxrss * 1024;
+#endif
+}
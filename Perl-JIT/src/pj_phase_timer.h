@@ -0,0 +1,50 @@
+#ifndef PJ_PHASE_TIMER_H_
+#define PJ_PHASE_TIMER_H_
+
+/* Time spent in each phase of the compilation pipeline */
+
+#include <EXTERN.h>
+#include <perl.h>
+
+#include <stdint.h>
+
+typedef enum {
+  // walking the op tree to find JIT candidates (without building ASTs)
+  pj_phase_find_candidates,
+  pj_phase_build_ast,
+  // inferring the types of untyped lexicals
+  pj_phase_infer_types,
+  // generating LLVM IR
+  pj_phase_emit,
+  // running the function pass manager
+  pj_phase_optimize,
+  // generating machine code
+  pj_phase_codegen,
+  // loading from and writing to the code cache
+  pj_phase_cache,
+  pj_phase_count
+} pj_phase;
+
+namespace PerlJIT {
+  // Adds the time elapsed in its scope to a phase, excluding the
+  // time of the timers nested in it on the same thread, so phases
+  // never count twice. A croak loses the time of the timers it
+  // unwinds, which is then charged to the enclosing one.
+  class PhaseTimer {
+  public:
+    PhaseTimer(pj_phase phase);
+    ~PhaseTimer();
+
+  private:
+    pj_phase phase;
+    uint64_t start, nested_start;
+  };
+
+  // { phase => { seconds => ..., count => ... } }
+  SV *pj_phase_times();
+  void pj_reset_phase_times();
+  // peak resident set size of the process, in bytes
+  UV pj_peak_rss();
+}
+
+#endif // PJ_PHASE_TIMER_H_
@@ -22,8 +22,31 @@ Snippets::set_current_function(Function *_function)
   arg_sp = NULL;
 }
 
+Snippets::FunctionState
+Snippets::get_function_state() const
+{
+  FunctionState state;
+
+  state.function = function;
+  state.arg_sp = arg_sp;
+
+  return state;
+}
+
+void
+Snippets::restore_function_state(const FunctionState &state)
+{
+  set_current_function(state.function);
+  arg_sp = state.arg_sp;
+}
+
 Value *
 Snippets::alloc_variable(llvm::Type *type, const Twine &name)
 {
-  return new AllocaInst(type, 0, name, &function->front().front());
+  BasicBlock *entry = &function->front();
+
+  // variables can be allocated before any code is emitted
+  if (entry->empty())
+    return new AllocaInst(type, 0, name, entry);
+  return new AllocaInst(type, 0, name, &entry->front());
 }
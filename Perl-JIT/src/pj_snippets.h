@@ -13,7 +13,16 @@ namespace PerlJIT {
   public:
     Snippets(llvm::Module *module, llvm::IRBuilder<> *builder);
 
+    // what is tied to the function being emitted, saved while the
+    // code of another function is emitted
+    struct FunctionState {
+      llvm::Function *function;
+      llvm::Value *arg_sp;
+    };
+
     void set_current_function(llvm::Function *function);
+    FunctionState get_function_state() const;
+    void restore_function_state(const FunctionState &state);
     llvm::Value *alloc_variable(llvm::Type *type, const llvm::Twine &name);
 
   protected:
@@ -0,0 +1,211 @@
+#include "pj_tbaa.h"
+
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Operator.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/Support/InstIterator.h>
+
+#include <sstream>
+
+using namespace PerlJIT;
+using namespace llvm;
+using namespace std;
+using namespace std::tr1;
+
+#define OFF(STRUCT, NAME) PTR2IV(&((STRUCT *)0)->NAME)
+#define IOFF(NAME) PTR2IV(&((PerlInterpreter *)0)->I##NAME)
+
+#ifdef USE_ITHREADS
+#  define INTERP_FIELD(access, NAME) \
+    is_interpreter_field(access, IOFF(NAME), NULL)
+#else
+#  define INTERP_FIELD(access, NAME) \
+    is_interpreter_field(access, 0, "PL_" #NAME)
+#endif
+
+TBAA::TBAA(Module *module) :
+  data_layout(module), md_builder(module->getContext()), thx(NULL)
+{
+  root = md_builder.createTBAARoot("Perl::JIT TBAA");
+  interpreter = md_builder.createTBAANode("interpreter", root);
+  // bodyless IVs/NVs keep their body inside the head, so body accesses
+  // must alias every head field, while head fields don't alias each other
+  sv = md_builder.createTBAANode("sv", root);
+  sv_body = md_builder.createTBAANode("sv body", sv);
+  // the pad and the argument stack are the arrays of AVs (PL_comppad
+  // and PL_curstack), so their slots alias other array slots, but not
+  // each other
+  array_slot = md_builder.createTBAANode("array slot", root);
+  pad_slot = md_builder.createTBAANode("pad slot", array_slot);
+  stack_slot = md_builder.createTBAANode("stack slot", array_slot);
+}
+
+void
+TBAA::annotate(Function *function)
+{
+#ifdef USE_ITHREADS
+  thx = function->arg_begin();
+#endif
+
+  for (inst_iterator it = inst_begin(function), end = inst_end(function); it != end; ++it) {
+    Value *address;
+
+    if (LoadInst *load = dyn_cast<LoadInst>(&*it))
+      address = load->getPointerOperand();
+    else if (StoreInst *store = dyn_cast<StoreInst>(&*it))
+      address = store->getPointerOperand();
+    else
+      continue;
+
+    if (MDNode *node = node_for(classify(address)))
+      it->setMetadata(LLVMContext::MD_tbaa, node);
+  }
+}
+
+static bool
+is_sv_head_type(StringRef name)
+{
+  return name == "struct.sv" || name == "struct.av" ||
+         name == "struct.hv" || name == "struct.cv" ||
+         name == "struct.gv";
+}
+
+static bool
+is_sv_body_type(StringRef name)
+{
+  return name.startswith("struct.xpv");
+}
+
+TBAA::Access
+TBAA::classify(Value *address)
+{
+  // walk back to the base pointer, accumulating the constant offset and
+  // remembering the outermost struct type that was indexed
+  APInt offset(data_layout.getPointerSizeInBits(), 0);
+  bool constant_offset = true;
+  StructType *base_struct = NULL;
+
+  for (;;) {
+    if (BitCastOperator *cast = dyn_cast<BitCastOperator>(address)) {
+      address = cast->getOperand(0);
+    } else if (GEPOperator *gep = dyn_cast<GEPOperator>(address)) {
+      Type *source = cast<PointerType>(gep->getPointerOperandType())->getElementType();
+
+      if (gep->getNumIndices() > 1)
+        if (StructType *st = dyn_cast<StructType>(source))
+          base_struct = st;
+      if (constant_offset) {
+        APInt gep_offset(offset.getBitWidth(), 0);
+
+        if (gep->accumulateConstantOffset(data_layout, gep_offset))
+          offset += gep_offset;
+        else
+          constant_offset = false;
+      }
+      address = gep->getPointerOperand();
+    } else {
+      break;
+    }
+  }
+
+  if (base_struct && base_struct->hasName()) {
+    StringRef name = base_struct->getName();
+
+    if (is_sv_head_type(name)) {
+      Access access(constant_offset ? access_sv_head : access_unknown);
+
+      access.offset = offset.getSExtValue();
+      access.array = name == "struct.av";
+      return access;
+    }
+    if (is_sv_body_type(name))
+      return Access(access_sv_body);
+  }
+
+  if (thx && address == thx && constant_offset) {
+    Access access(access_interpreter);
+
+    access.offset = offset.getSExtValue();
+    return access;
+  }
+
+  if (GlobalVariable *gv = dyn_cast<GlobalVariable>(address)) {
+    if (gv->getName().startswith("PL_") && constant_offset && !offset) {
+      Access access(access_interpreter);
+
+      access.global = gv->getName();
+      return access;
+    }
+  }
+
+  // pointers loaded from known locations
+  if (LoadInst *load = dyn_cast<LoadInst>(address)) {
+    Access source = classify(load->getPointerOperand());
+
+    if (source.kind == access_interpreter) {
+      if (INTERP_FIELD(source, curpad))
+        return Access(access_pad_slot);
+      if (INTERP_FIELD(source, stack_sp) || INTERP_FIELD(source, stack_base))
+        return Access(access_stack_slot);
+    }
+    // sv_u is a union, only known to be AvARRAY for AVs (it's also
+    // SvPVX, SvRV, GvGP, ...)
+    if (source.kind == access_sv_head && source.offset == OFF(SV, sv_u) && source.array)
+      return Access(access_array_slot);
+    if (source.kind == access_sv_head && source.offset == OFF(SV, sv_any))
+      return Access(access_sv_body);
+  }
+
+  return Access(access_unknown);
+}
+
+bool
+TBAA::is_interpreter_field(const Access &access, int64_t offset, const char *name) const
+{
+  if (name)
+    return access.global == name;
+  else
+    return access.global.empty() && access.offset == offset;
+}
+
+MDNode *
+TBAA::node_for(const Access &access)
+{
+  switch (access.kind) {
+  case access_interpreter:
+    if (!access.global.empty()) {
+      MDNode *&node = fields[access.global];
+
+      if (!node)
+        node = md_builder.createTBAANode(access.global, interpreter);
+      return node;
+    }
+    return field_node(interpreter, "interpreter+", access.offset);
+  case access_sv_head:
+    return field_node(sv_body, "sv head+", access.offset);
+  case access_sv_body:
+    return sv_body;
+  case access_pad_slot:
+    return pad_slot;
+  case access_stack_slot:
+    return stack_slot;
+  case access_array_slot:
+    return array_slot;
+  default:
+    return NULL;
+  }
+}
+
+MDNode *
+TBAA::field_node(MDNode *parent, const char *prefix, int64_t offset)
+{
+  ostringstream name;
+
+  name << prefix << offset;
+
+  MDNode *&node = fields[name.str()];
+  if (!node)
+    node = md_builder.createTBAANode(name.str(), parent);
+
+  return node;
+}
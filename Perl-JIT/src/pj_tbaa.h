@@ -0,0 +1,69 @@
+#ifndef PJ_TBAA_H_
+#define PJ_TBAA_H_
+
+#include <EXTERN.h>
+#include <perl.h>
+
+#undef Copy
+
+#include <llvm/IR/Module.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/MDBuilder.h>
+
+#include <string>
+#include <tr1/unordered_map>
+
+namespace PerlJIT {
+  // Attaches type-based alias analysis metadata to the loads and stores
+  // emitted through PerlAPI and the generated snippets.
+  //
+  // Accesses are classified by looking at how their address is
+  // computed: interpreter fields (one node per field), SV heads (one node
+  // per head field), SV bodies, and the SV * slots of AvARRAY (with the
+  // pad and the argument stack as more specific arrays). Anything not
+  // recognized is left alone, and may alias with everything else.
+  class TBAA {
+  public:
+    TBAA(llvm::Module *module);
+
+    void annotate(llvm::Function *function);
+
+  private:
+    enum access_kind {
+      access_unknown,
+      access_interpreter,
+      access_sv_head,
+      access_sv_body,
+      access_pad_slot,
+      access_stack_slot,
+      access_array_slot
+    };
+
+    struct Access {
+      access_kind kind;
+      // byte offset into the interpreter struct or SV head; for
+      // non-threaded perls, interpreter fields are identified by name
+      int64_t offset;
+      std::string global;
+      // SV head accesses through an AV *
+      bool array;
+
+      Access(access_kind _kind) : kind(_kind), offset(0), array(false) { }
+    };
+
+    Access classify(llvm::Value *address);
+    llvm::MDNode *node_for(const Access &access);
+    llvm::MDNode *field_node(llvm::MDNode *parent, const char *prefix, int64_t offset);
+
+    bool is_interpreter_field(const Access &access, int64_t offset, const char *name) const;
+
+    llvm::DataLayout data_layout;
+    llvm::MDBuilder md_builder;
+    llvm::Value *thx;
+    llvm::MDNode *root, *interpreter, *sv, *sv_body;
+    llvm::MDNode *pad_slot, *stack_slot, *array_slot;
+    std::tr1::unordered_map<std::string, llvm::MDNode *> fields;
+  };
+}
+
+#endif // PJ_TBAA_H_
@@ -0,0 +1,231 @@
+#include "pj_tiering.h"
+#include "pj_emit.h"
+#include "pj_debug.h"
+#include "OPTreeVisitor.h"
+
+#include <vector>
+#include <tr1/unordered_map>
+
+using namespace PerlJIT;
+using namespace std;
+using namespace std::tr1;
+
+namespace {
+  struct PerlMutex {
+    PerlMutex() { MUTEX_INIT(&mutex); }
+    ~PerlMutex() { MUTEX_DESTROY(&mutex); }
+
+    operator perl_mutex *() { return &mutex; }
+
+  private:
+    perl_mutex mutex;
+  };
+
+  // Both entry ops and back-edges have a counter; back-edges add their
+  // counts to the one of the entry op
+  struct TierCounter {
+    OP *(*ppaddr)(pTHX);
+    OP *entry;
+    UV calls, threshold, hot_calls;
+    vector<OP *> back_edges;
+  };
+
+  // op trees are shared between ithreads
+  PerlMutex counters_mutex;
+  unordered_map<OP *, TierCounter> counters;
+
+  class BackEdgeFinder : public OPTreeVisitor {
+  public:
+    OPTreeVisitor::visit_control_t visit_op(pTHX_ OP *o, OP *parentop)
+    {
+      if (o->op_type == OP_UNSTACK)
+        back_edges.push_back(o);
+      return VISIT_CONT;
+    }
+
+    vector<OP *> back_edges;
+  };
+}
+
+static Perl_ophook_t previous_free_hook = NULL;
+static peep_t previous_peep = NULL;
+
+static OP *pj_pp_tier_entry(pTHX);
+static OP *pj_pp_tier_back_edge(pTHX);
+
+// Restores the original PP functions; counters_mutex must be held
+static void
+S_remove_counters(pTHX_ unordered_map<OP *, TierCounter>::iterator entry)
+{
+  const vector<OP *> &back_edges = entry->second.back_edges;
+
+  for (size_t i = 0, max = back_edges.size(); i < max; ++i) {
+    unordered_map<OP *, TierCounter>::iterator it = counters.find(back_edges[i]);
+
+    if (it == counters.end())
+      continue;
+    it->first->op_ppaddr = it->second.ppaddr;
+    counters.erase(it);
+  }
+
+  entry->first->op_ppaddr = entry->second.ppaddr;
+  counters.erase(entry);
+}
+
+STATIC void
+S_compile_sub(pTHX_ CV *cv, UV hot_calls)
+{
+  dSP;
+
+  ENTER;
+  SAVETMPS;
+  // failing to compile is not an error, and must not clobber $@
+  save_scalar(PL_errgv);
+
+  PUSHMARK(SP);
+  XPUSHs(sv_2mortal(newRV_inc((SV *) cv)));
+  XPUSHs(sv_2mortal(newSVpvs("opt_level")));
+  XPUSHs(sv_2mortal(newSViv(pj_opt_basic)));
+  XPUSHs(sv_2mortal(newSVpvs("tier_up_calls")));
+  XPUSHs(sv_2mortal(newSVuv(hot_calls)));
+  // don't stall the program while generating code
+  XPUSHs(sv_2mortal(newSVpvs("async")));
+  XPUSHs(sv_2mortal(newSViv(1)));
+  PUTBACK;
+
+  call_pv("Perl::JIT::Emit::jit_sub", G_VOID | G_DISCARD | G_EVAL);
+  if (SvTRUE(ERRSV))
+    PJ_DEBUG_1("Tiered compilation failed: %s", SvPV_nolen(ERRSV));
+
+  FREETMPS;
+  LEAVE;
+}
+
+static OP *
+pj_pp_tier_entry(pTHX)
+{
+  OP *(*ppaddr)(pTHX);
+  CV *cv = NULL;
+  UV hot_calls = 0;
+
+  MUTEX_LOCK(counters_mutex);
+  unordered_map<OP *, TierCounter>::iterator it = counters.find(PL_op);
+  assert(it != counters.end());
+  TierCounter &counter = it->second;
+
+  ppaddr = counter.ppaddr;
+  // only compile when no other frame of this sub is running, because
+  // compilation rewrites the op tree
+  if (++counter.calls >= counter.threshold) {
+    CV *runcv = find_runcv(NULL);
+
+    if (CvDEPTH(runcv) == 1) {
+      cv = runcv;
+      hot_calls = counter.hot_calls;
+      S_remove_counters(aTHX_ it);
+    }
+  }
+  MUTEX_UNLOCK(counters_mutex);
+
+  if (!cv)
+    return ppaddr(aTHX);
+
+  S_compile_sub(aTHX_ cv, hot_calls);
+
+  // start over from the (possibly replaced) first op of the sub
+  return CvSTART(cv);
+}
+
+// Compiling from inside a running loop would require patching ops
+// that are executing, so back-edges only contribute to the call count
+// and the sub is compiled on the next call
+static OP *
+pj_pp_tier_back_edge(pTHX)
+{
+  OP *(*ppaddr)(pTHX);
+
+  MUTEX_LOCK(counters_mutex);
+  unordered_map<OP *, TierCounter>::iterator back_edge = counters.find(PL_op);
+  assert(back_edge != counters.end());
+  unordered_map<OP *, TierCounter>::iterator entry = counters.find(back_edge->second.entry);
+
+  ppaddr = back_edge->second.ppaddr;
+  if (entry != counters.end())
+    ++entry->second.calls;
+  MUTEX_UNLOCK(counters_mutex);
+
+  return ppaddr(aTHX);
+}
+
+static UV
+S_hint_uv(pTHX_ const char *key)
+{
+  SV *hint = cop_hints_fetch_pv(&PL_compiling, key, 0, 0);
+
+  return hint && SvOK(hint) ? SvUV(hint) : 0;
+}
+
+STATIC void
+S_add_counter(pTHX_ OP *op, OP *(*ppaddr)(pTHX), OP *entry, UV threshold, UV hot_calls)
+{
+  TierCounter &counter = counters[op];
+
+  counter.ppaddr = op->op_ppaddr;
+  counter.entry = entry;
+  counter.calls = 0;
+  counter.threshold = threshold;
+  counter.hot_calls = hot_calls;
+
+  op->op_ppaddr = ppaddr;
+}
+
+static void
+pj_tiering_peep(pTHX_ OP *o)
+{
+  previous_peep(aTHX_ o);
+
+  // only sub bodies, not the main program or string evals
+  if (!PL_compcv || CvEVAL(PL_compcv) || CvSTART(PL_compcv) != o)
+    return;
+
+  UV threshold = S_hint_uv(aTHX_ PJ_TIER_CALLS_HINT);
+  if (!threshold)
+    return;
+  UV hot_calls = S_hint_uv(aTHX_ PJ_TIER_HOT_CALLS_HINT);
+
+  BackEdgeFinder finder;
+  finder.visit(aTHX_ CvROOT(PL_compcv), NULL);
+
+  MUTEX_LOCK(counters_mutex);
+  if (counters.find(o) == counters.end()) {
+    S_add_counter(aTHX_ o, pj_pp_tier_entry, o, threshold, hot_calls);
+    counters[o].back_edges = finder.back_edges;
+
+    for (size_t i = 0, max = finder.back_edges.size(); i < max; ++i)
+      S_add_counter(aTHX_ finder.back_edges[i], pj_pp_tier_back_edge, o, 0, 0);
+  }
+  MUTEX_UNLOCK(counters_mutex);
+}
+
+static void
+pj_tiering_free_op(pTHX_ OP *op)
+{
+  if (op->op_ppaddr == pj_pp_tier_entry || op->op_ppaddr == pj_pp_tier_back_edge) {
+    MUTEX_LOCK(counters_mutex);
+    counters.erase(op);
+    MUTEX_UNLOCK(counters_mutex);
+  }
+
+  if (previous_free_hook)
+    previous_free_hook(aTHX_ op);
+}
+
+void
+PerlJIT::pj_init_tiering(pTHX)
+{
+  previous_peep = PL_peepp;
+  PL_peepp = pj_tiering_peep;
+
+  previous_free_hook = PL_opfreehook;
+  PL_opfreehook = pj_tiering_free_op;
+}
@@ -0,0 +1,21 @@
+#ifndef PJ_TIERING_H_
+#define PJ_TIERING_H_
+
+/* Automatic compilation of hot subs */
+
+#include <EXTERN.h>
+#include <perl.h>
+
+// Subs compiled with these hints set start out interpreted: their entry
+// op and loop back-edges count executions, and the sub is passed to
+// Perl::JIT::Emit::jit_sub once the count reaches the value of the
+// first hint. Regions that then execute as many times as the second
+// hint says are recompiled at the highest optimization level.
+#define PJ_TIER_CALLS_HINT "PJIT:tier"
+#define PJ_TIER_HOT_CALLS_HINT "PJIT:tierhot"
+
+namespace PerlJIT {
+  void pj_init_tiering(pTHX);
+}
+
+#endif
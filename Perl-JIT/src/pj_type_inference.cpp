@@ -0,0 +1,541 @@
+#include "pj_type_inference.h"
+#include "pj_ast_visitor.h"
+#include "pj_phase_timer.h"
+#include "OPTreeVisitor.h"
+
+#include <tr1/unordered_map>
+#include <tr1/unordered_set>
+
+using namespace PerlJIT;
+using namespace PerlJIT::AST;
+using namespace std;
+using namespace std::tr1;
+
+// pad names before 5.18/5.22
+#ifndef PadlistARRAY
+# define PadlistARRAY(pl)       ((PAD **)AvARRAY(pl))
+# define PadlistNAMES(pl)       (*PadlistARRAY(pl))
+#endif
+#ifndef PadnamelistARRAY
+typedef SV PADNAME;
+# define PadnamelistARRAY(pnl)  AvARRAY(pnl)
+#endif
+#ifndef PadnameOUTER
+# define PadnameOUTER(pn)       SvFAKE(pn)
+#endif
+#ifndef PadnameIsSTATE
+# define PadnameIsSTATE(pn)     SvPAD_STATE(pn)
+#endif
+
+namespace {
+  // Counts the ops referring to each pad entry
+  class PadReferenceCounter : public OPTreeVisitor {
+  public:
+    PadReferenceCounter() : has_closures(false) {}
+
+    virtual visit_control_t visit_op(pTHX_ OP *o, OP *parentop);
+
+    // pad index => number of ops having it as op_targ
+    unordered_map<PADOFFSET, int> references;
+    // entries introduced by an OP_PADRANGE, which also refers to them
+    unordered_set<PADOFFSET> in_padrange;
+    // closures and string evals can refer to any lexical
+    bool has_closures;
+  };
+
+  struct LexicalInfo {
+    LexicalInfo() : pad_index(0), uses(0), eligible(true), type(NULL) {}
+
+    PADOFFSET pad_index;
+    // uses in the ASTs the inference understands
+    int uses;
+    bool eligible;
+    // covering type of the values assigned so far, NULL before the
+    // first one
+    Type *type;
+  };
+
+  class TypeInferrer : public ASTVisitor {
+  public:
+    TypeInferrer(bool _lvalue_sub);
+
+    // finds the untyped scalar lexicals and counts their uses
+    void collect_uses(const vector<Term *> &asts);
+    // drops the lexicals some op outside the ASTs refers to
+    void check_references(pTHX_ CV *cv, const PadReferenceCounter &counter);
+    // joins the types assigned to the lexicals until they don't change
+    void propagate_types(const vector<Term *> &asts);
+    // types the declarations of the Int/Double lexicals
+    void set_declaration_types();
+    // records the uses of the lexicals that can't escape the ASTs
+    void set_declaration_uses();
+
+    bool has_lexicals() const { return !lexicals.empty(); }
+
+  protected:
+    virtual visit_control_t visit_term_pre(Term *term);
+    virtual visit_control_t visit_term_post(Term *term);
+
+  private:
+    LexicalInfo *lexical_info(Term *term);
+    bool is_understood_use(Term *parent, Term *kid, size_t i) const;
+    Type *kid_type(Term *term, size_t i);
+    Type *term_type(Term *term);
+    Type *op_result_type(Op *op);
+    Type *loop_variable_type(Term *expression);
+    void assign(Term *target, Type *type);
+
+    typedef unordered_map<VariableDeclaration *, LexicalInfo> lexical_map_t;
+
+    lexical_map_t lexicals;
+    // types of the terms visited so far in the current pass
+    unordered_map<Term *, Type *> types;
+    bool lvalue_sub, collecting, changed;
+  };
+}
+
+OPTreeVisitor::visit_control_t
+PadReferenceCounter::visit_op(pTHX_ OP *o, OP *parentop)
+{
+  switch (o->op_type) {
+  case OP_NULL:
+    // op_targ is the type of the optimized-out op
+    return VISIT_CONT;
+  case OP_ANONCODE:
+  case OP_ENTEREVAL:
+    has_closures = true;
+    return VISIT_ABORT;
+#if PERL_VERSION >= 18
+  case OP_PADRANGE:
+    for (int i = 0, max = o->op_private & OPpPADRANGE_COUNTMASK; i < max; ++i)
+      in_padrange.insert(o->op_targ + i);
+    return VISIT_CONT;
+#endif
+  default:
+    break;
+  }
+
+  if (o->op_targ)
+    ++references[o->op_targ];
+
+  return VISIT_CONT;
+}
+
+// Unlike covering_type(), an unspecified value can be anything, so it
+// makes the variable unspecified as well
+static Type *
+join_types(Type *left, Type *right)
+{
+  if (!left)
+    return right;
+  if (!right || left == right)
+    return left;
+  if (left->is_unspecified() || right->is_unspecified())
+    return Scalar::get(pj_unspecified_type);
+
+  Type *covering = covering_type(left, right);
+
+  return covering ? covering : Scalar::get(pj_unspecified_type);
+}
+
+// values of these types can't be overloaded or tied
+static bool
+is_restricted(Type *type)
+{
+  return type->is_numeric() || type->tag() == pj_string_type;
+}
+
+// Outside 'use integer', Perl turns the result of integer arithmetic
+// into a double when it overflows, so it can't be given an integer
+// type (typed Int code can use C semantics, untyped code can't)
+static Type *
+overflowing_type(Type *type)
+{
+  return type->is_integer() ? Scalar::get(pj_unspecified_type) : type;
+}
+
+TypeInferrer::TypeInferrer(bool _lvalue_sub) :
+  lvalue_sub(_lvalue_sub), collecting(true), changed(false)
+{
+}
+
+void
+TypeInferrer::collect_uses(const vector<Term *> &asts)
+{
+  collecting = true;
+  visit(asts);
+}
+
+void
+TypeInferrer::check_references(pTHX_ CV *cv, const PadReferenceCounter &counter)
+{
+  PADNAME **names = PadnamelistARRAY(PadlistNAMES(CvPADLIST(cv)));
+
+  for (lexical_map_t::iterator it = lexicals.begin(), end = lexicals.end(); it != end; ++it) {
+    LexicalInfo &info = it->second;
+
+    if (!info.eligible)
+      continue;
+
+    unordered_map<PADOFFSET, int>::const_iterator references =
+      counter.references.find(info.pad_index);
+    PADNAME *name = names[info.pad_index];
+
+    // a closed-over variable can be changed by the outer sub, and state
+    // variables keep their value across calls
+    if (references == counter.references.end() ||
+        references->second != info.uses ||
+        counter.in_padrange.count(info.pad_index) ||
+        !name || PadnameOUTER(name) || PadnameIsSTATE(name))
+      info.eligible = false;
+  }
+}
+
+void
+TypeInferrer::propagate_types(const vector<Term *> &asts)
+{
+  collecting = false;
+  // types only go up in a finite lattice, so this terminates
+  do {
+    changed = false;
+    types.clear();
+    visit(asts);
+  } while (changed);
+}
+
+void
+TypeInferrer::set_declaration_types()
+{
+  for (lexical_map_t::iterator it = lexicals.begin(), end = lexicals.end(); it != end; ++it) {
+    LexicalInfo &info = it->second;
+
+    if (!info.eligible || !info.type)
+      continue;
+    // the emitter does not handle anything else yet
+    if (info.type->tag() == pj_int_type || info.type->tag() == pj_double_type)
+      it->first->set_value_type(info.type);
+  }
+}
+
+void
+TypeInferrer::set_declaration_uses()
+{
+  for (lexical_map_t::iterator it = lexicals.begin(), end = lexicals.end(); it != end; ++it)
+    if (it->second.eligible)
+      it->first->local_uses = it->second.uses;
+}
+
+LexicalInfo *
+TypeInferrer::lexical_info(Term *term)
+{
+  VariableDeclaration *decl;
+
+  if (term->get_type() == pj_ttype_lexical)
+    decl = static_cast<Lexical *>(term)->declaration;
+  else if (term->get_type() == pj_ttype_variabledeclaration)
+    decl = static_cast<VariableDeclaration *>(term);
+  else
+    return NULL;
+
+  if (collecting && !lexicals.count(decl)) {
+    if (decl->sigil != pj_sigil_scalar || !decl->get_value_type()->is_unspecified())
+      return NULL;
+    lexicals[decl];
+  }
+
+  lexical_map_t::iterator it = lexicals.find(decl);
+
+  return it == lexicals.end() ? NULL : &it->second;
+}
+
+// Whether the lexical kid i of parent is used in a way that can't
+// change its value, other than by the assignments seen by assign()
+bool
+TypeInferrer::is_understood_use(Term *parent, Term *kid, size_t i) const
+{
+  if (parent->get_type() == pj_ttype_foreach)
+    // the loop variable (the list elements are aliased)
+    return i == 0;
+  if (parent->get_type() != pj_ttype_op)
+    return false;
+
+  Op *op = static_cast<Op *>(parent);
+
+  // 'my $x' is only understood as the target of an assignment
+  if (kid->get_type() == pj_ttype_variabledeclaration)
+    return op->get_op_type() == pj_binop_sassign && i == 0;
+
+  switch (op->get_op_type()) {
+  case pj_binop_sassign:
+  case pj_binop_range:
+  case pj_unop_preinc:
+  case pj_unop_postinc:
+  case pj_unop_predec:
+  case pj_unop_postdec:
+    return true;
+  case pj_binop_aelem:
+  case pj_binop_helem:
+    // the index
+    return i == 1;
+  case pj_listop_ternary:
+    // the condition, the branches can be assigned to
+    return i == 0;
+  case pj_listop_return:
+    return !lvalue_sub;
+  case pj_listop_chop:
+  case pj_listop_chomp:
+  case pj_listop_vec:
+  case pj_listop_sysselect:
+    // modify their operands
+    return false;
+  case pj_listop_reverse:
+    // returns its operands in list context
+    return false;
+  default:
+    break;
+  }
+
+  if (op->op_class() == pj_opc_binop && static_cast<Binop *>(op)->is_assignment_form() && i == 0)
+    return true;
+
+  // ops returning new values only read their operands
+  return op->return_type() != pj_ret_any;
+}
+
+Type *
+TypeInferrer::kid_type(Term *term, size_t i)
+{
+  Term *kid = term->get_kid(i);
+
+  // a missing kid defaults to $_
+  if (!kid)
+    return Scalar::get(pj_unspecified_type);
+
+  unordered_map<Term *, Type *>::iterator it = types.find(kid);
+
+  return it == types.end() ? Scalar::get(pj_unspecified_type) : it->second;
+}
+
+Type *
+TypeInferrer::term_type(Term *term)
+{
+  switch (term->get_type()) {
+  case pj_ttype_constant:
+    return term->get_value_type();
+  case pj_ttype_lexical:
+  case pj_ttype_variabledeclaration: {
+    LexicalInfo *info = lexical_info(term);
+
+    return info && info->eligible ? info->type : term->get_value_type();
+  }
+  case pj_ttype_op:
+    return op_result_type(static_cast<Op *>(term));
+  default:
+    return Scalar::get(pj_unspecified_type);
+  }
+}
+
+// NULL when it depends on a lexical with no assigned type yet
+Type *
+TypeInferrer::op_result_type(Op *op)
+{
+  switch (op->get_op_type()) {
+  case pj_binop_sassign:
+    return kid_type(op, 1);
+  case pj_unop_preinc:
+  case pj_unop_postinc:
+  case pj_unop_predec:
+  case pj_unop_postdec: {
+    if (op->is_integer_variant())
+      return Scalar::get(pj_int_type);
+
+    Type *type = kid_type(op, 0);
+
+    // ++ on strings is magic, and on integers it can overflow to a
+    // double
+    if (!type)
+      return NULL;
+    return type->is_numeric() ? overflowing_type(type) : Scalar::get(pj_unspecified_type);
+  }
+  default:
+    break;
+  }
+
+  pj_op_return_type return_type = op->return_type();
+  size_t kid_count = op->get_kid_count();
+  bool has_unknown = false;
+
+  // pp_divide (with PERL_TRY_UV_DIVIDE) and pp_pow give an exact
+  // integer result for integer operands when there is one, so they
+  // only return Doubles for Double operands
+  if (op->get_op_type() == pj_binop_divide || op->get_op_type() == pj_binop_pow)
+    return_type = pj_ret_numeric;
+
+  switch (return_type) {
+  case pj_ret_numeric: {
+    if (op->is_integer_variant())
+      return Scalar::get(pj_int_type);
+    if (kid_count == 0)
+      return Scalar::get(pj_unspecified_type);
+
+    Type *result = NULL;
+
+    for (size_t i = 0; i < kid_count; ++i) {
+      Type *type = kid_type(op, i);
+
+      if (!type)
+        has_unknown = true;
+      else if (!type->is_numeric())
+        return Scalar::get(pj_unspecified_type);
+      else
+        result = result ? covering_type(result, type) : type;
+    }
+
+    return has_unknown ? NULL : overflowing_type(result);
+  }
+  case pj_ret_integer:
+  case pj_ret_unsigned_integer:
+  case pj_ret_double:
+  case pj_ret_string:
+    if (op->may_have_explicit_overload()) {
+      for (size_t i = 0; i < kid_count; ++i) {
+        Type *type = kid_type(op, i);
+
+        if (!type)
+          has_unknown = true;
+        else if (!is_restricted(type))
+          return Scalar::get(pj_unspecified_type);
+      }
+      if (has_unknown)
+        return NULL;
+    }
+
+    return Scalar::get(return_type == pj_ret_integer          ? pj_int_type :
+                       return_type == pj_ret_unsigned_integer ? pj_uint_type :
+                       return_type == pj_ret_double           ? pj_double_type :
+                                                                pj_string_type);
+  default:
+    return Scalar::get(pj_unspecified_type);
+  }
+}
+
+// Perl ranges always produce integers (or die)
+Type *
+TypeInferrer::loop_variable_type(Term *expression)
+{
+  if (expression->get_type() != pj_ttype_op ||
+      static_cast<Op *>(expression)->get_op_type() != pj_binop_range)
+    return Scalar::get(pj_unspecified_type);
+
+  for (size_t i = 0; i < 2; ++i) {
+    Type *type = kid_type(expression, i);
+
+    if (!type)
+      return NULL;
+    if (!type->is_numeric())
+      return Scalar::get(pj_unspecified_type);
+  }
+
+  return Scalar::get(pj_int_type);
+}
+
+void
+TypeInferrer::assign(Term *target, Type *type)
+{
+  LexicalInfo *info = lexical_info(target);
+
+  if (!info || !info->eligible || !type)
+    return;
+
+  Type *joined = join_types(info->type, type);
+
+  if (joined != info->type) {
+    info->type = joined;
+    changed = true;
+  }
+}
+
+ASTVisitor::visit_control_t
+TypeInferrer::visit_term_pre(Term *term)
+{
+  if (!collecting)
+    return VISIT_CONT;
+
+  for (size_t i = 0, max = term->get_kid_count(); i < max; ++i) {
+    Term *kid = term->get_kid(i);
+    LexicalInfo *info = kid ? lexical_info(kid) : NULL;
+
+    if (!info || !info->eligible)
+      continue;
+
+    OP *o = kid->get_perl_op();
+
+    // declarations first seen through a reference have no op
+    if (!o || !is_understood_use(term, kid, i)) {
+      info->eligible = false;
+      continue;
+    }
+
+    info->pad_index = o->op_targ;
+    ++info->uses;
+  }
+
+  return VISIT_CONT;
+}
+
+ASTVisitor::visit_control_t
+TypeInferrer::visit_term_post(Term *term)
+{
+  if (collecting)
+    return VISIT_CONT;
+
+  Type *type = term_type(term);
+
+  types[term] = type;
+
+  if (term->get_type() == pj_ttype_foreach) {
+    Foreach *loop = static_cast<Foreach *>(term);
+
+    assign(loop->iterator, loop_variable_type(loop->expression));
+  } else if (term->get_type() == pj_ttype_op) {
+    Op *op = static_cast<Op *>(term);
+
+    switch (op->get_op_type()) {
+    case pj_binop_sassign:
+    case pj_unop_preinc:
+    case pj_unop_postinc:
+    case pj_unop_predec:
+    case pj_unop_postdec:
+      assign(op->kids[0], type);
+      break;
+    default:
+      if (op->op_class() == pj_opc_binop && static_cast<Binop *>(op)->is_assignment_form())
+        assign(op->kids[0], type);
+      break;
+    }
+  }
+
+  return VISIT_CONT;
+}
+
+void
+pj_infer_lexical_types(pTHX_ CV *cv, const vector<Term *> &asts)
+{
+  PhaseTimer timer(pj_phase_infer_types);
+  TypeInferrer inferrer(CvLVALUE(cv));
+
+  inferrer.collect_uses(asts);
+  if (!inferrer.has_lexicals())
+    return;
+
+  PadReferenceCounter counter;
+
+  counter.visit(aTHX_ CvROOT(cv), NULL);
+  if (counter.has_closures)
+    return;
+
+  inferrer.check_references(aTHX_ cv, counter);
+  inferrer.propagate_types(asts);
+  inferrer.set_declaration_types();
+  inferrer.set_declaration_uses();
+}
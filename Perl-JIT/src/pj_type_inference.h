@@ -0,0 +1,25 @@
+#ifndef PJ_TYPE_INFERENCE_H_
+#define PJ_TYPE_INFERENCE_H_
+
+#include <EXTERN.h>
+#include <perl.h>
+
+#include "pj_ast_terms.h"
+
+#include <vector>
+
+/* Inference of the types of lexicals without a type declaration */
+
+// Gives the untyped scalar lexicals of cv that are only ever assigned
+// Int or Double values (constants, typed variables, loop counters,
+// arithmetic that can't overflow to a double, ...) the covering type of
+// those values, as described in
+// doc/types.txt. A lexical is only considered when all the ops of cv
+// referring to it are in the ASTs, in places where its value can't
+// change behind the JIT's back; everything else stays unspecified.
+// The number of uses of those lexicals is stored in their declaration
+// (VariableDeclaration::local_uses), for the escape analysis of the
+// emitter.
+void pj_infer_lexical_types(pTHX_ CV *cv, const std::vector<PerlJIT::AST::Term *> &asts);
+
+#endif // PJ_TYPE_INFERENCE_H_
@@ -1,10 +1,10 @@
 #include "pj_types.h"
 
+#include <pthread.h>
 #include <stdio.h>
 #include <cstdlib>
 #include <string.h>
 #include <tr1/unordered_map>
-#include <typeinfo>
 
 using namespace std;
 using namespace std::tr1;
@@ -15,6 +15,8 @@ const Scalar PerlJIT::AST::OPAQUE_T(pj_opaque_type);
 const Scalar PerlJIT::AST::DOUBLE_T(pj_double_type);
 const Scalar PerlJIT::AST::INT_T(pj_int_type);
 const Scalar PerlJIT::AST::UNSIGNED_INT_T(pj_uint_type);
+const Scalar PerlJIT::AST::STRING_T(pj_string_type);
+const Scalar PerlJIT::AST::GV_T(pj_gv_type);
 const Scalar PerlJIT::AST::UNSPECIFIED_T(pj_unspecified_type);
 const Scalar PerlJIT::AST::ANY_T(pj_any_type);
 const Scalar PerlJIT::AST::SCALAR_T(pj_scalar_type);
@@ -26,16 +28,50 @@ const Scalar PerlJIT::AST::SCALAR_T(pj_scalar_type);
 #define INT         "Int"
 #define UINT        "UnsignedInt"
 
+#define TYPE_ID_COUNT (pj_uint_type + 1)
+
+namespace {
+  // element type => composite type; the tables and the types are
+  // never freed, and shared by all interpreters
+  typedef unordered_map<const Type *, Type *> composite_map_t;
+
+  pthread_mutex_t composites_mutex = PTHREAD_MUTEX_INITIALIZER;
+  composite_map_t *arrays = NULL, *hashes = NULL;
+
+  template<class T>
+  Type *
+  intern_composite(composite_map_t *&map, Type *element)
+  {
+    Type *type;
+
+    pthread_mutex_lock(&composites_mutex);
+    if (!map)
+      map = new composite_map_t;
+
+    composite_map_t::iterator it = map->find(element);
+    if (it != map->end()) {
+      type = it->second;
+    } else {
+      type = new T(element);
+      (*map)[element] = type;
+    }
+    pthread_mutex_unlock(&composites_mutex);
+
+    return type;
+  }
+}
+
 Type::~Type()
 {
 }
 
 
+// Only called for distinct types: equal types cover themselves
 static Type *
-minimal_covering_type_internal(const Type &left, const Type &right)
+compute_covering_type(Type *left, Type *right)
 {
-  pj_type_id left_tag = left.tag();
-  pj_type_id right_tag = right.tag();
+  pj_type_id left_tag = left->tag();
+  pj_type_id right_tag = right->tag();
 
   // pj_unspecified_type and pj_any_type are the same for this logic
   if (left_tag == pj_any_type)
@@ -45,68 +81,53 @@ minimal_covering_type_internal(const Type &left, const Type &right)
 
   // short-circuit
   if (left_tag == right_tag) {
-    if (!left.is_composite())
-      return left.clone();
+    if (!left->is_composite())
+      return left;
 
     // Array or Hash
-    Type *left_elem;
-    Type *right_elem;
-
     if (left_tag == pj_array_type) {
-      const Array &left_comp = dynamic_cast<const Array &>(left);
-      const Array &right_comp = dynamic_cast<const Array &>(right);
-      left_elem = left_comp.element();
-      right_elem = right_comp.element();
-    }
-    else {
-      const Hash &left_comp = dynamic_cast<const Hash &>(left);
-      const Hash &right_comp = dynamic_cast<const Hash &>(right);
-      left_elem = left_comp.element();
-      right_elem = right_comp.element();
-    }
-    //printf("# Recursing for %s and %s\n", left_elem->to_string().c_str(), right_elem->to_string().c_str());
-    Type *res = minimal_covering_type_internal(*left_elem, *right_elem);
-    if (res == NULL)
-      return res;
-    if (res->equals(left_elem)) {
-      delete res;
-      return left.clone();
+      Type *element = covering_type(static_cast<Array *>(left)->element(),
+                                    static_cast<Array *>(right)->element());
+
+      return element ? Array::get(element) : NULL;
     }
     else {
-      delete res;
-      return right.clone();
+      Type *element = covering_type(static_cast<Hash *>(left)->element(),
+                                    static_cast<Hash *>(right)->element());
+
+      return element ? Hash::get(element) : NULL;
     }
   }
 
   // incompatible combinations with unique types
-  else if (left.is_array() || right.is_array())
+  else if (left->is_array() || right->is_array())
     return NULL;
-  else if (left.is_hash() || right.is_hash())
+  else if (left->is_hash() || right->is_hash())
     return NULL;
   else if (left_tag == pj_gv_type || right_tag == pj_gv_type)
     return NULL; // FIXME GV relations a bit wobbly.
 
   // short-circuit unspecified type with other scalar type
-  else if (left.is_unspecified())
-    return right.clone();
-  else if (right.is_unspecified())
-    return left.clone();
+  else if (left_tag == pj_unspecified_type)
+    return right;
+  else if (right_tag == pj_unspecified_type)
+    return left;
 
   // Only descendants of opaque (== opaque scalar) left
   else if (left_tag == pj_opaque_type)
-    return left.clone();
+    return left;
   else if (right_tag == pj_opaque_type)
-    return right.clone();
+    return right;
 
   // Only descendants of scalar left
   else if (left_tag == pj_scalar_type)
-    return left.clone();
+    return left;
   else if (right_tag == pj_scalar_type)
-    return right.clone();
+    return right;
 
   // If *one* of them is a string, then upgrade to full scalar type
   else if (left_tag == pj_string_type || right_tag == pj_string_type)
-    return new Scalar(pj_scalar_type);
+    return Scalar::get(pj_scalar_type);
 
   // FIXME this is debatable. Is double really >> Int/UInt?
   // Now, all that should be left is double, int, uint. And we already know
@@ -121,12 +142,12 @@ minimal_covering_type_internal(const Type &left, const Type &right)
             && (   right_tag == pj_double_type
                 || right_tag == pj_int_type
                 || right_tag == pj_uint_type) )
-    return new Scalar(pj_double_type);
+    return Scalar::get(pj_double_type);
 
   else {
     printf("There's types in minimal_covering_type that aren't "
            "handled correctly at all: left=%s right=%s",
-           left.to_string().c_str(), right.to_string().c_str());
+           left->to_string().c_str(), right->to_string().c_str());
     abort();
     return NULL;
   }
@@ -135,45 +156,62 @@ minimal_covering_type_internal(const Type &left, const Type &right)
 }
 
 
-static unordered_map<string, Type *>
-unique_types(const vector<Type *> &types)
-{
-  unordered_map<string, Type *> uniq;
+namespace {
+  // The lattice of scalar types, computed when the module is loaded
+  // (after the type constants above): covering type by pair of tags
+  struct ScalarLattice {
+    Type *covering[TYPE_ID_COUNT][TYPE_ID_COUNT];
 
-  const unsigned int n = types.size();
-  for (unsigned int i = 0; i < n; ++i)
-    uniq[types[i]->to_string()] = types[i];
+    ScalarLattice()
+    {
+      for (int i = 0; i < TYPE_ID_COUNT; ++i) {
+        for (int j = 0; j < TYPE_ID_COUNT; ++j) {
+          Type *left = Scalar::get((pj_type_id) i);
+          Type *right = Scalar::get((pj_type_id) j);
+
+          if (!left || !right)
+            covering[i][j] = NULL;
+          else if (left == right)
+            covering[i][j] = left;
+          else
+            covering[i][j] = compute_covering_type(left, right);
+        }
+      }
+    }
+  };
 
-  return uniq;
+  const ScalarLattice scalar_lattice;
 }
 
 
 namespace PerlJIT {
   namespace AST {
     Type *
-    minimal_covering_type(const vector<Type *> &types)
+    covering_type(Type *left, Type *right)
     {
-      unordered_map<string, Type *> uniq_types = unique_types(types);
+      if (left == right)
+        return left;
+      if (!left->is_composite() && !right->is_composite())
+        return scalar_lattice.covering[left->tag()][right->tag()];
+      if (left->tag() != right->tag())
+        return NULL;
+
+      // the covering type of two arrays/hashes is an array/hash of
+      // the covering type of their elements, recursing to the lattice
+      // once per nesting level
+      return compute_covering_type(left, right);
+    }
 
+    Type *
+    minimal_covering_type(const vector<Type *> &types)
+    {
       Type *minimal_type = NULL;
-      unordered_map<string, Type *>::iterator it = uniq_types.begin();
-      unordered_map<string, Type *>::iterator end = uniq_types.end();
-      for (; it != end; ++it) {
-        Type *t = it->second;
 
-        if (minimal_type == NULL) {
-          minimal_type = t->clone();
-        }
-        else if (!minimal_type->equals(t)) {
-          //printf("Cmp %s and %s\n", minimal_type->to_string().c_str(), t->to_string().c_str());
-          Type *new_type = minimal_covering_type_internal(*minimal_type, *t);
-          //printf("Result: %s\n", new_type == NULL ? "NULL" : new_type->to_string().c_str());
-          if (new_type != minimal_type)
-            delete minimal_type;
-          if (new_type == NULL)
-            return NULL;
-          minimal_type = new_type;
-        }
+      for (size_t i = 0, max = types.size(); i < max; ++i) {
+        if (i == 0)
+          minimal_type = types[i];
+        else if (!(minimal_type = covering_type(minimal_type, types[i])))
+          return NULL;
       }
 
       return minimal_type;
@@ -182,54 +220,63 @@ namespace PerlJIT {
 } // end namespace PerlJIT
 
 
-Scalar::Scalar(pj_type_id tag) :
-  _tag(tag)
-{
-}
-
 Type *
-Scalar::clone() const
+Scalar::get(pj_type_id tag)
 {
-  return new Scalar(_tag);
+  switch (tag) {
+  case pj_unspecified_type:
+    return const_cast<Scalar *>(&UNSPECIFIED_T);
+  case pj_any_type:
+    return const_cast<Scalar *>(&ANY_T);
+  case pj_scalar_type:
+    return const_cast<Scalar *>(&SCALAR_T);
+  case pj_gv_type:
+    return const_cast<Scalar *>(&GV_T);
+  case pj_opaque_type:
+    return const_cast<Scalar *>(&OPAQUE_T);
+  case pj_string_type:
+    return const_cast<Scalar *>(&STRING_T);
+  case pj_double_type:
+    return const_cast<Scalar *>(&DOUBLE_T);
+  case pj_int_type:
+    return const_cast<Scalar *>(&INT_T);
+  case pj_uint_type:
+    return const_cast<Scalar *>(&UNSIGNED_INT_T);
+  default:
+    return NULL;
+  }
 }
 
-pj_type_id Scalar::tag() const
+Scalar::Scalar(pj_type_id tag) :
+  Type(tag)
 {
-  return _tag;
 }
 
 bool Scalar::is_unspecified() const
 {
-  return _tag == pj_unspecified_type;
+  return tag() == pj_unspecified_type;
 }
 
 bool Scalar::is_opaque() const
 {
-  return _tag == pj_opaque_type;
+  return tag() == pj_opaque_type;
 }
 
 bool Scalar::is_xv() const
 {
-  return (_tag == pj_scalar_type || _tag == pj_gv_type);
+  return (tag() == pj_scalar_type || tag() == pj_gv_type);
 }
 
 bool Scalar::is_integer() const
 {
-  return (_tag == pj_int_type || _tag == pj_uint_type);
+  return (tag() == pj_int_type || tag() == pj_uint_type);
 }
 
 bool Scalar::is_numeric() const
 {
-  return (   _tag == pj_int_type
-          || _tag == pj_uint_type
-          || _tag == pj_double_type);
-}
-
-bool Scalar::equals(const Type *other) const
-{
-  const Scalar *o = dynamic_cast<const Scalar *>(other);
-
-  return o && o->_tag == _tag;
+  return (   tag() == pj_int_type
+          || tag() == pj_uint_type
+          || tag() == pj_double_type);
 }
 
 #define PRINT_TYPE(value, string) \
@@ -238,7 +285,7 @@ bool Scalar::equals(const Type *other) const
 
 string Scalar::to_string() const
 {
-  switch (_tag) {
+  switch (tag()) {
     PRINT_TYPE(pj_unspecified_type, "Any"); // FIXME shady
     PRINT_TYPE(pj_any_type, "Any");
     PRINT_TYPE(pj_scalar_type, "Scalar");
@@ -254,20 +301,15 @@ string Scalar::to_string() const
   return "InvalidScalarType";
 }
 
-Array::Array(Type *element) :
-  _element(element)
-{
-}
-
 Type *
-Array::clone() const
+Array::get(Type *element)
 {
-  return new Array(_element->clone());
+  return intern_composite<Array>(arrays, element);
 }
 
-pj_type_id Array::tag() const
+Array::Array(Type *element) :
+  Type(pj_array_type), _element(element)
 {
-  return pj_array_type;
 }
 
 Type *Array::element() const
@@ -275,32 +317,20 @@ Type *Array::element() const
   return _element;
 }
 
-bool Array::equals(const Type *other) const
-{
-  const Array *o = dynamic_cast<const Array *>(other);
-
-  return o && o->_element->equals(_element);
-}
-
 string Array::to_string() const
 {
   return "Array[" + _element->to_string() + "]";
 }
 
-Hash::Hash(Type *element) :
-  _element(element)
-{
-}
-
 Type *
-Hash::clone() const
+Hash::get(Type *element)
 {
-  return new Hash(_element->clone());
+  return intern_composite<Hash>(hashes, element);
 }
 
-pj_type_id Hash::tag() const
+Hash::Hash(Type *element) :
+  Type(pj_hash_type), _element(element)
 {
-  return pj_hash_type;
 }
 
 Type *Hash::element() const
@@ -308,13 +338,6 @@ Type *Hash::element() const
   return _element;
 }
 
-bool Hash::equals(const Type *other) const
-{
-  const Hash *o = dynamic_cast<const Hash *>(other);
-
-  return o && o->_element->equals(_element);
-}
-
 string Hash::to_string() const
 {
   return "Hash[" + _element->to_string() + "]";
@@ -323,7 +346,7 @@ string Hash::to_string() const
 #define PARSE_SCALAR(name, type) \
   if (starts_with(str, name)) { \
     rest = str.substr(strlen(name)); \
-    return new Scalar(type); \
+    return Scalar::get(type); \
   }
 
 #define PARSE_NESTED(name, type) \
@@ -349,10 +372,9 @@ namespace PerlJIT {
 
         if (element && tail.length() && tail[0] == ']') {
           rest = tail.substr(1);
-          return new T(element);
+          return T::get(element);
         }
 
-        delete element;
         return 0;
       }
       return 0;
@@ -377,10 +399,8 @@ namespace PerlJIT {
       string rest;
       Type *type = parse_type_part(str, rest);
 
-      if (rest.size()) {
-        delete type;
+      if (rest.size())
         return 0;
-      }
       else
         return type;
     }
@@ -1,6 +1,7 @@
 #ifndef PJ_TYPES_H_
 #define PJ_TYPES_H_
 
+#include <stddef.h>
 #include <string>
 #include <vector>
 
@@ -25,16 +26,22 @@ namespace PerlJIT {
   namespace AST {
     class Type;
 
+    // Types are interned: there is a single immutable instance of
+    // each distinct type (including nested Array[...]/Hash[...]), which
+    // lives until the end of the process, so types are compared by
+    // address and can be shared freely between ASTs
+
+    // least upper bound of two types, NULL if there's none; constant
+    // time for scalar types
+    Type *covering_type(Type *left, Type *right);
+    // NULL if types is empty or there is no covering type
     Type *minimal_covering_type(const std::vector<Type *> &types);
 
     class Type {
     public:
-      virtual ~Type();
-      virtual Type *clone() const = 0;
-
-      virtual pj_type_id tag() const = 0;
+      pj_type_id tag() const { return _tag; }
 
-      virtual bool equals(const Type *other) const = 0;
+      bool equals(const Type *other) const { return this == other; }
 
       virtual bool is_scalar() const { return false; }
       virtual bool is_array() const { return false; }
@@ -50,16 +57,26 @@ namespace PerlJIT {
       virtual std::string to_string() const = 0;
       virtual const char *perl_class() const
         { return "Perl::JIT::AST::Type"; }
+
+    protected:
+      Type(pj_type_id tag) : _tag(tag) { }
+      // types are never deleted
+      virtual ~Type();
+
+    private:
+      Type(const Type &);
+      Type &operator=(const Type &);
+
+      pj_type_id _tag;
     };
 
     class Scalar : public Type {
     public:
-      Scalar(pj_type_id tag);
-      virtual Type *clone() const;
-
-      virtual pj_type_id tag() const;
+      // NULL for the tags of composite types
+      static Type *get(pj_type_id tag);
 
-      virtual bool equals(const Type *other) const;
+      // only used for the constants below, use get()
+      Scalar(pj_type_id tag);
 
       virtual bool is_scalar() const { return true; }
       virtual bool is_unspecified() const;
@@ -73,20 +90,17 @@ namespace PerlJIT {
       virtual std::string to_string() const;
       virtual const char *perl_class() const
         { return "Perl::JIT::AST::Scalar"; }
-    private:
-      pj_type_id _tag;
     };
 
     class Array : public Type {
     public:
+      static Type *get(Type *element);
+
+      // only used by get()
       Array(Type *element);
-      virtual Type *clone() const;
 
-      virtual pj_type_id tag() const;
       Type *element() const;
 
-      virtual bool equals(const Type *other) const;
-
       virtual bool is_array() const { return true; }
       virtual bool is_composite() const { return true; }
 
@@ -99,14 +113,13 @@ namespace PerlJIT {
 
     class Hash : public Type {
     public:
+      static Type *get(Type *element);
+
+      // only used by get()
       Hash(Type *element);
-      virtual Type *clone() const;
 
-      virtual pj_type_id tag() const;
       Type *element() const;
 
-      virtual bool equals(const Type *other) const;
-
       virtual bool is_hash() const { return true; }
       virtual bool is_composite() const { return true; }
 
@@ -123,6 +136,8 @@ namespace PerlJIT {
     extern const Scalar DOUBLE_T;
     extern const Scalar INT_T;
     extern const Scalar UNSIGNED_INT_T;
+    extern const Scalar STRING_T;
+    extern const Scalar GV_T;
     extern const Scalar UNSPECIFIED_T;
     extern const Scalar ANY_T; // used in code generation
     extern const Scalar SCALAR_T;
@@ -0,0 +1,32 @@
+#!/usr/bin/env perl
+
+use t::lib::Perl::JIT::Test;
+use Perl::JIT qw(:all);
+use Perl::JIT::Types qw(:all);
+
+# types are interned: constructing a type twice gives the same type
+my $int = Perl::JIT::AST::Scalar->new(pj_int_type);
+my $uint = Perl::JIT::AST::Scalar->new(pj_uint_type);
+my $double = Perl::JIT::AST::Scalar->new(pj_double_type);
+
+ok($int->equals(Perl::JIT::AST::Scalar->new(pj_int_type)), "Int is interned");
+ok(!$int->equals($uint), "Int and UnsignedInt differ");
+
+my $ary_hash_int = Perl::JIT::AST::Array->new(Perl::JIT::AST::Hash->new($int));
+ok($ary_hash_int->equals(Perl::JIT::AST::Array->new(Perl::JIT::AST::Hash->new($int))),
+   "Array[Hash[Int]] is interned");
+ok(!$ary_hash_int->equals(Perl::JIT::AST::Array->new(Perl::JIT::AST::Hash->new($double))),
+   "Array[Hash[Int]] and Array[Hash[Double]] differ");
+ok(!$ary_hash_int->equals(Perl::JIT::AST::Hash->new(Perl::JIT::AST::Hash->new($int))),
+   "Array[Hash[Int]] and Hash[Hash[Int]] differ");
+
+# covering types of composites are composites of the covering type
+ok(minimal_covering_type([Perl::JIT::AST::Array->new($int),
+                          Perl::JIT::AST::Array->new($uint)])
+   ->equals(Perl::JIT::AST::Array->new($double)),
+   "Covering for Array[Int] and Array[UnsignedInt] is Array[Double]");
+
+ok(!eval { Perl::JIT::AST::Scalar->new(pj_array_type); 1 },
+   "Array is not a scalar type");
+
+done_testing();
@@ -0,0 +1,78 @@
+#!/usr/bin/env perl
+
+use t::lib::Perl::JIT::Test;
+use Perl::JIT qw(:all);
+
+my @tests = (
+  { name  => 'integer accumulator and loop variable',
+    code  => 'my $sum = 0; for my $i (1 .. 10) { $sum += $i * 2; } return $sum;',
+    types => [pj_int_type, pj_unspecified_type],
+    },
+  { name  => 'integer constants',
+    code  => 'my $x = 1; my $y = $x + 1; $x = 2; return $y;',
+    types => [pj_int_type, pj_unspecified_type],
+    },
+  { name  => 'integer increment',
+    code  => 'my $x = 9223372036854775807; $x++; return $x;',
+    types => [pj_unspecified_type],
+    },
+  { name  => 'integer arithmetic under use integer',
+    code  => 'use integer; my $x = 1; $x += 2; return $x;',
+    types => [pj_int_type],
+    },
+  { name  => 'integers and doubles',
+    code  => 'my $x = 1; $x += 0.5; return $x;',
+    types => [pj_double_type],
+    },
+  { name  => 'division',
+    code  => 'my $x = 6.5; my $y = 0.5; $y = $x / 4; return $y;',
+    types => [pj_double_type],
+    },
+  { name  => 'integer division',
+    code  => 'my $x = 2000000000000000; my $y = 0; $y = $x / 2; return $y;',
+    types => [pj_int_type, pj_unspecified_type],
+    },
+  { name  => 'integer power',
+    code  => 'my $x = 3; my $y = $x ** 40; return $y;',
+    types => [pj_int_type, pj_unspecified_type],
+    },
+  { name  => 'string assignment',
+    code  => 'my $x = 1; $x .= "a"; return $x;',
+    types => [pj_unspecified_type],
+    },
+  { name  => 'untyped value',
+    code  => 'my $x = shift; $x += 1; return $x;',
+    types => [pj_unspecified_type],
+    },
+  { name  => 'comparison',
+    code  => 'my $y = shift; my $x = $y < 2; return $x;',
+    types => [pj_unspecified_type],
+    },
+  { name  => 'reference',
+    code  => 'my $x = 0; my $r = \$x; $x += 1; return $x;',
+    types => [pj_unspecified_type],
+    },
+  { name  => 'closure',
+    code  => 'my $x = 0; my $f = sub { $x++ }; $x += 1; return $x;',
+    types => [pj_unspecified_type],
+    },
+);
+
+plan tests => scalar @tests;
+
+for my $test (@tests) {
+  my $sub = eval "sub { $test->{code} }" or die $@;
+  my @asts = Perl::JIT::find_jit_candidates($sub);
+  my %types;
+
+  while (@asts) {
+    my $ast = pop @asts;
+    push @asts, grep defined, $ast->get_kids;
+    if ($ast->get_type == pj_ttype_lexical && $ast->get_sigil == pj_sigil_scalar) {
+      $types{$ast->get_value_type->tag} = 1;
+    }
+  }
+
+  eq_or_diff([sort { $a <=> $b } keys %types], [sort { $a <=> $b } @{$test->{types}}],
+             "$test->{name}: lexical types match");
+}
@@ -24,10 +24,31 @@ my @tests = (
   { name   => 'add op nested in other ops',
     func   => build_jit_test_sub('$a, $b', 'my $x = abs(abs($a) + abs($b));', '$x'),
     input  => [38, 4], },
+  { name   => 'add-assign to an Int lexical',
+    func   => build_jit_test_sub('$a', 'my $x = 40; $x += 2', '$x'),
+    input  => [0], },
+  { name   => 'add to an inferred Int',
+    func   => build_jit_test_sub('$a', 'my $x = 40; my $y = $x + 2', '$y'),
+    input  => [0], },
+  { name   => 'add to an inferred Int near IV_MAX',
+    func   => build_jit_test_sub('$a', 'my $x = 9223372036854775806; my $y = $x + 1', '$y'),
+    input  => [0],
+    output => 9223372036854775807, },
+  { name   => 'add overflowing an inferred Int',
+    func   => build_jit_test_sub('$a', 'my $x = 9223372036854775807; my $y = $x + 1', '$y'),
+    input  => [0],
+    output => 9223372036854775807 + 1, },
+  { name   => 'add-assign overflowing an Int lexical',
+    func   => build_jit_test_sub('$a', 'my $x = 9223372036854775807; $x += 1', '$x'),
+    input  => [0],
+    output => 9223372036854775807 + 1, },
+  { name   => 'add-assign to an inferred Double',
+    func   => build_jit_test_sub('$a', 'my $x = 40.5; $x += 1.5', '$x'),
+    input  => [0], },
 );
 
 # save typing
-$_->{output} = 42 for @tests;
+$_->{output} //= 42 for @tests;
 $_->{opgrep} = [{ name => 'add' }] for @tests;
 
 plan tests => count_jit_tests(\@tests);
@@ -1,6 +1,6 @@
 #!/usr/bin/env perl
 
-use t::lib::Perl::JIT::Test tests => 2;
+use t::lib::Perl::JIT::Test tests => 8;
 
 sub id {
     my ($a) = @_;
@@ -14,6 +14,36 @@ sub neg {
     return -id($a);
 }
 
+sub mixed {
+    my ($a) = @_;
+
+    return 2 * abs($a - 63);
+}
+
+sub element {
+    my (@a) = @_;
+
+    return 2 * abs($a[0]);
+}
+
+our @b;
+
+sub global_element {
+    return 2 * abs($b[0]);
+}
+
 # neg
 is_jitting(\&neg, [{ name => 'negate'}]);
 is(neg(-42), 42);
+
+# mixed
+is_jitting(\&mixed, [{ name => 'multiply'}]);
+is(mixed(42), 42);
+
+# array elements as operands of a direct call
+is_jitting(\&element, [{ name => 'multiply'}]);
+is(element(-21), 42);
+
+@b = (-21);
+is_jitting(\&global_element, [{ name => 'multiply'}]);
+is(global_element(), 42);
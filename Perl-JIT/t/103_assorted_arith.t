@@ -29,6 +29,56 @@ my @tests = (
     opgrep => [@ops{qw(multiply subtract)}],
     output => sub {approx_eq($_[0], 42)},
     input  => [21, 3, 21], },
+  { name   => 'subtract big integers',
+    func   => build_jit_test_sub('$a, $b', '', '$a - $b'),
+    opgrep => [$ops{subtract}],
+    output => 9007199254740992,
+    input  => [9007199254740993, 1], },
+  { name   => 'multiply big integers',
+    func   => build_jit_test_sub('$a, $b', '', '$a * $b'),
+    opgrep => [$ops{multiply}],
+    output => 9007199254740993,
+    input  => [3002399751580331, 3], },
+  { name   => 'multiply overflowing integers',
+    func   => build_jit_test_sub('$a, $b', '', '$a * $b'),
+    opgrep => [$ops{multiply}],
+    output => 4294967296 * 4294967296,
+    input  => [4294967296, 4294967296], },
+  { name   => 'add UVs',
+    func   => build_jit_test_sub('$a, $b', '', '$a + $b'),
+    opgrep => [$ops{add}],
+    output => 18446744073709551614,
+    input  => [9223372036854775807, 9223372036854775807], },
+  { name   => 'add overflowing UVs',
+    func   => build_jit_test_sub('$a, $b', '', '$a + $b'),
+    opgrep => [$ops{add}],
+    output => 18446744073709551615 + 1,
+    input  => [18446744073709551615, 1], },
+  { name   => 'subtract from a UV',
+    func   => build_jit_test_sub('$a, $b', '', '$a - $b'),
+    opgrep => [$ops{subtract}],
+    output => 18446744073709551614,
+    input  => [18446744073709551615, 1], },
+  { name   => 'subtract a UV down to IV_MIN',
+    func   => build_jit_test_sub('$a, $b', '', '$a - $b'),
+    opgrep => [$ops{subtract}],
+    output => -9223372036854775808,
+    input  => [0, 9223372036854775808], },
+  { name   => 'multiply into the UV range',
+    func   => build_jit_test_sub('$a, $b', '', '$a * $b'),
+    opgrep => [$ops{multiply}],
+    output => 18446744069414584320,
+    input  => [4294967296, 4294967295], },
+  { name   => 'multiply down to IV_MIN',
+    func   => build_jit_test_sub('$a, $b', '', '$a * $b'),
+    opgrep => [$ops{multiply}],
+    output => -9223372036854775808,
+    input  => [-4294967296, 2147483648], },
+  { name   => 'subtract integer strings',
+    func   => build_jit_test_sub('$a, $b', '', '$a - $b'),
+    opgrep => [$ops{subtract}],
+    output => 9007199254740992,
+    input  => ['9007199254740993', '1'], },
   { name   => 'cos(sin())',
     func   => build_jit_test_sub('$a', '', 'cos(sin($a))'),
     opgrep => [@ops{qw(sin cos)}],
@@ -28,6 +28,9 @@ my @tests = (
   { name   => 'assign in scalar context',
     func   => build_jit_test_sub('$a', 'my $y; my $z = srand($y = $a)', '$z + $y'),
     input  => [21], },
+  { name   => 'assign region-local in scalar context',
+    func   => build_jit_test_sub('$a', '', 'abs(my $x = 42)'),
+    input  => [0], },
   { name   => 'assign array element',
     func   => build_jit_test_sub('$a', 'my @x; $x[0] = abs($a)', '$x[0]'),
     input  => [-42], },
@@ -40,6 +43,21 @@ my @tests = (
 $_->{output} //= 42 for @tests;
 $_->{opgrep} ||= [{ name => 'sassign' }] for @tests;
 
-plan tests => count_jit_tests(\@tests);
+plan tests => count_jit_tests(\@tests) + 2;
 
 run_jit_tests(\@tests);
+
+# the JITted code is shared by all the clones of a closure, including
+# the ones created after JITting
+sub make_closure {
+  my ($n) = @_;
+
+  return sub { my $x = $n; abs(my $y = $x + 1) };
+}
+
+my $first = make_closure(1);
+Perl::JIT::Emit::jit_sub($first);
+my $second = make_closure(41);
+
+is($first->(), 2, 'closure JITted directly');
+is($second->(), 42, 'closure cloned after JITting');
@@ -0,0 +1,28 @@
+#!/usr/bin/env perl
+
+use t::lib::Perl::JIT::Test;
+
+# Lexicals declared and only used in JITted code are not stored in the
+# pad, so these check the values still flow correctly
+
+my @tests = (
+  { name   => 'region-local temporaries',
+    func   => build_jit_test_sub('$a', 'my $acc = $a; my $x = 10; my $y = 4; my $d = $x - $y; $acc += $d * $d', '$acc'),
+    opgrep => [{ name => 'subtract' }, { name => 'multiply' }],
+    input  => [6], },
+  { name   => 'region-local in a loop body',
+    func   => build_jit_test_sub('$a', 'my $acc = 0; for my $i (1..3) { my $d = $i - 0.5; $acc += $d * $d }', '$acc + $a'),
+    opgrep => [{ name => 'subtract' }, { name => 'multiply' }],
+    input  => [33.25], },
+  { name   => 'lexical used outside the region',
+    func   => build_jit_test_sub('$a', 'my $x = 40 - $a; srand(1); $x += 2', '$x'),
+    opgrep => [{ name => 'subtract' }],
+    input  => [0], },
+);
+
+# save typing
+$_->{output} = 42 for @tests;
+
+plan tests => count_jit_tests(\@tests);
+
+run_jit_tests(\@tests);
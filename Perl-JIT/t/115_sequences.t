@@ -11,6 +11,10 @@ my @tests = (
     func   => build_jit_test_sub('$x', '$x += 30; srand(1); $x += 5', '$x'),
     opgrep => [{ name => 'nextstate', sibling => { name => 'add' } }],
     input  => [7], },
+  { name   => 'subtrees run by the interpreter',
+    func   => build_jit_test_sub('$x', '$x += abs($x - 37); $x += abs($x - 42)', '$x'),
+    opgrep => [{ name => 'nextstate', sibling => { name => 'add' } }],
+    input  => [7], },
   { name   => 'mixed jittable/non-jittable',
     func   => build_jit_test_sub('$x', 'for (1..35) { $x += 1 }', '$x'),
     opgrep => [{ name => 'nextstate', sibling => { name => 'add' } }],
@@ -0,0 +1,21 @@
+#!/usr/bin/env perl
+
+use t::lib::Perl::JIT::Test;
+
+plan tests => 4 * 2 + 1;
+
+for my $opt_level (0 .. 3) {
+  my $sub = build_jit_test_sub('$x', '$x += 30; $x += 5', '$x');
+  my $res = eval {
+    Perl::JIT::Emit::jit_sub($sub, opt_level => $opt_level);
+    1;
+  };
+
+  ok($res, "JIT at opt level $opt_level")
+    or diag($@);
+  is($sub->(7), 42, "Checking output at opt level $opt_level");
+}
+
+my $sub = build_jit_test_sub('$x', '$x += 1', '$x');
+eval { Perl::JIT::Emit::jit_sub($sub, opt_level => 4) };
+like($@, qr/Invalid optimization level 4/, "out of range opt level");
@@ -0,0 +1,66 @@
+#!/usr/bin/env perl
+
+use t::lib::Perl::JIT::Test;
+
+use Perl::JIT tiered => { calls => 10, hot_calls => 20 };
+
+sub add_one {
+  my ($x) = @_;
+  $x += 1;
+  return $x;
+}
+
+sub add_loop {
+  my ($x) = @_;
+  for (1..35) { $x += 1 }
+  return $x;
+}
+
+# the clones of a closure share the JIT op, so the code replaced by
+# tier-up can still be running in one clone when another one installs
+# the new code
+sub make_adder {
+  my ($step) = @_;
+
+  return sub {
+    my ($x, $inner) = @_;
+    $x += $step + ($inner ? $inner->($x) - $x : 0);
+    return $x;
+  };
+}
+
+no Perl::JIT;
+
+sub add_two {
+  my ($x) = @_;
+  $x += 2;
+  return $x;
+}
+
+plan tests => 34;
+
+is(add_one(41), 42, "interpreted result") for 1..5;
+ok(count_adds(\&add_one), "not compiled before the threshold");
+
+my @res = map add_one(41), 1..100;
+is_deeply(\@res, [(42) x 100], "results across tier transitions");
+# code is generated in the background and installed on the next call
+Perl::JIT::Emit::wait_for_compilation();
+is(add_one(41), 42, "result after installing the code");
+is(count_adds(\&add_one), 0, "compiled after the threshold");
+
+# the loop iterations make the sub hot before the second call
+add_loop(7);
+is(add_loop(7), 42, "loop result");
+Perl::JIT::Emit::wait_for_compilation();
+is(add_loop(7), 42, "loop result after installing the code");
+is(count_adds(\&add_loop), 0, "back-edges count towards the threshold");
+
+is(add_two(40), 42, "result outside tiered scope") for 1..20;
+ok(count_adds(\&add_two), "not compiled outside tiered scope");
+
+my ($outer, $inner) = (make_adder(1), make_adder(1));
+my @nested = map $outer->(40, $inner), 1..100;
+Perl::JIT::Emit::wait_for_compilation();
+push @nested, map $outer->(40, $inner), 1..100;
+is_deeply(\@nested, [(42) x 200], "closure clones across tier transitions");
@@ -0,0 +1,22 @@
+#!/usr/bin/env perl
+
+use t::lib::Perl::JIT::Test;
+
+plan tests => 6;
+
+my $sub = build_jit_test_sub('$x', '$x += 30; $x += 5', '$x');
+
+Perl::JIT::Emit::jit_sub($sub, async => 1);
+is($sub->(7), 42, "result while compiling");
+
+Perl::JIT::Emit::wait_for_compilation();
+ok(count_adds($sub), "op tree untouched until the next call");
+is($sub->(7), 42, "result after installing the code");
+is(count_adds($sub), 0, "op tree patched");
+
+my $pending = build_jit_test_sub('$x', '$x += 1', '$x');
+Perl::JIT::Emit::jit_sub($pending, async => 1);
+eval { Perl::JIT::Emit::jit_sub($pending, async => 1) };
+like($@, qr/Sub is already being compiled/, "no concurrent compilation of a sub");
+Perl::JIT::Emit::wait_for_compilation();
+is($pending->(41), 42, "result after installing the code");
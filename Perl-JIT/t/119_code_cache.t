@@ -0,0 +1,56 @@
+#!/usr/bin/env perl
+
+use t::lib::Perl::JIT::Test;
+use File::Temp qw(tempdir);
+
+plan tests => 10;
+
+my $dir = tempdir(CLEANUP => 1);
+local $Perl::JIT::Emit::CACHE_DIR = $dir;
+
+my $sub = build_jit_test_sub('$x', '$x += 30; $x += 5', '$x');
+Perl::JIT::Emit::jit_sub($sub);
+is($sub->(7), 42, "result with an empty cache");
+
+my $entries = () = glob("$dir/*.pjc");
+ok($entries, "regions written to the cache");
+
+# same code, different sub: served from the cache
+my $same = build_jit_test_sub('$x', '$x += 30; $x += 5', '$x');
+Perl::JIT::Emit::jit_sub($same);
+is($same->(7), 42, "result with code from the cache");
+is(scalar(() = glob("$dir/*.pjc")), $entries, "no new entries for a cache hit");
+
+# different constants must not hit the same entry
+my $other = build_jit_test_sub('$x', '$x += 30; $x += 6', '$x');
+Perl::JIT::Emit::jit_sub($other);
+is($other->(7), 43, "result for different code");
+cmp_ok(scalar(() = glob("$dir/*.pjc")), '>', $entries, "different code, different entries");
+
+# corrupt entries are ignored
+for my $entry (glob("$dir/*.pjc")) {
+  open my $fh, '>', $entry or die "Unable to open '$entry': $!";
+  print $fh "garbage";
+}
+my $corrupt = build_jit_test_sub('$x', '$x += 30; $x += 5', '$x');
+Perl::JIT::Emit::jit_sub($corrupt);
+is($corrupt->(7), 42, "result with a corrupt cache entry");
+
+# the directory is created private, and directories others can write to
+# are not used
+{
+  local $Perl::JIT::Emit::CACHE_DIR = "$dir/created";
+  my $created = build_jit_test_sub('$x', '$x += 30; $x += 5', '$x');
+  Perl::JIT::Emit::jit_sub($created);
+  is((stat "$dir/created")[2] & 0777, 0700, "cache directory created private");
+}
+
+{
+  my $shared = tempdir(CLEANUP => 1);
+  chmod 0777, $shared;
+  local $Perl::JIT::Emit::CACHE_DIR = $shared;
+  my $unsafe = build_jit_test_sub('$x', '$x += 30; $x += 5', '$x');
+  Perl::JIT::Emit::jit_sub($unsafe);
+  is($unsafe->(7), 42, "result with a shared cache directory");
+  is(scalar(() = glob("$shared/*.pjc")), 0, "no entries in a shared cache directory");
+}
@@ -0,0 +1,30 @@
+#!/usr/bin/env perl
+
+use t::lib::Perl::JIT::Test;
+
+plan tests => 3;
+
+# each sub gets its own compilation unit, freed with the sub
+my $ok = 1;
+for my $i (1 .. 200) {
+  my $sub = build_jit_test_sub('$x', "\$x += $i; \$x += 1", '$x');
+  Perl::JIT::Emit::jit_sub($sub);
+  $ok &&= $sub->(0) == $i + 1;
+}
+ok($ok, "results while freeing compiled subs");
+
+# freed while compiling in the background
+for my $i (1 .. 20) {
+  my $sub = build_jit_test_sub('$x', "\$x += $i; \$x += 1", '$x');
+  Perl::JIT::Emit::jit_sub($sub, async => 1);
+}
+Perl::JIT::Emit::wait_for_compilation();
+pass("freeing subs with pending code");
+
+# tiered-up code lives in the same unit as the original
+my $sub = build_jit_test_sub('$x', '$x += 30; $x += 5', '$x');
+Perl::JIT::Emit::jit_sub($sub, opt_level => 1, tier_up_calls => 5);
+my @res = map $sub->(7), 1 .. 10;
+Perl::JIT::Emit::wait_for_compilation();
+undef $sub;
+is_deeply(\@res, [(42) x 10], "results across tier-up, sub freed");
@@ -0,0 +1,27 @@
+#!/usr/bin/env perl
+
+use t::lib::Perl::JIT::Test;
+
+plan tests => 5;
+
+# every compilation exceeds the budget, so each jit_sub evicts the
+# previously compiled regions
+local $Perl::JIT::Emit::CODE_BUDGET = 1;
+
+my @subs = map build_jit_test_sub('$x', "\$x += $_; \$x += 1", '$x'), 1 .. 5;
+Perl::JIT::Emit::jit_sub($_) for @subs;
+
+my $memory = Perl::JIT::Emit::code_memory();
+is($memory->{budget}, 1, "budget");
+cmp_ok($memory->{evictions}, '>', 0, "regions evicted");
+
+my @res = map { my $sub = $_; map $sub->(0), 1 .. 3 } @subs;
+is_deeply(\@res, [map { ($_ + 1) x 3 } 1 .. 5], "evicted regions recompiled on use");
+
+$memory = Perl::JIT::Emit::code_memory();
+cmp_ok($memory->{machine_code}, '>', 0, "machine code accounted");
+
+local $Perl::JIT::Emit::CODE_BUDGET = 0;
+my $sub = build_jit_test_sub('$x', '$x += 30; $x += 5', '$x');
+Perl::JIT::Emit::jit_sub($sub);
+is($sub->(7), 42, "no budget");
@@ -0,0 +1,16 @@
+#!/usr/bin/env perl
+
+use t::lib::Perl::JIT::Test;
+
+plan tests => 5;
+
+my $sub = build_jit_test_sub('$x', '$x += 30; $x += 5', '$x');
+
+my $before = Perl::JIT::Emit::code_memory()->{machine_code};
+Perl::JIT::Emit::jit_sub($sub, lazy => 1);
+is(count_adds($sub), 0, "op tree patched");
+is(Perl::JIT::Emit::code_memory()->{machine_code}, $before, "no code generated before the first call");
+
+is($sub->(7), 42, "result of the first call");
+cmp_ok(Perl::JIT::Emit::code_memory()->{machine_code}, '>', $before, "code generated on the first call");
+is_deeply([map $sub->($_), 1 .. 3], [36, 37, 38], "later calls");
@@ -0,0 +1,35 @@
+#!/usr/bin/env perl
+
+use t::lib::Perl::JIT::Test;
+
+plan tests => 8;
+
+my $counted = build_jit_test_sub('$x', '$x += 30; $x += 5', '$x');
+my $timed = build_jit_test_sub('$x', '$x += 1', '$x');
+my $plain = build_jit_test_sub('$x', '$x += 2', '$x');
+
+Perl::JIT::Emit::jit_sub($counted, profile => 1);
+Perl::JIT::Emit::jit_sub($timed, profile => 2);
+Perl::JIT::Emit::jit_sub($plain);
+
+$counted->($_) for 1 .. 10;
+$timed->($_) for 1 .. 5;
+$plain->($_) for 1 .. 3;
+
+my %stats;
+for my $entry (@{Perl::JIT::stats()}) {
+  push @{$stats{$entry->{sub}}}, $entry;
+}
+
+ok($stats{$counted}, "regions reported");
+is_deeply([map $_->{calls}, @{$stats{$counted}}], [(10) x @{$stats{$counted}}], "executions counted");
+ok(!exists $stats{$counted}[0]{cycles}, "no timing without profile => 2");
+ok($stats{$counted}[0]{line}, "source line");
+
+is($stats{$timed}[0]{calls}, 5, "executions counted");
+cmp_ok($stats{$timed}[0]{cycles}, '>', 0, "cycles measured");
+
+ok(!$stats{$plain}, "regions without profiling are not reported");
+
+eval { Perl::JIT::Emit::jit_sub($plain, profile => 3) };
+like($@, qr/Invalid profiling level 3/, "profiling level checked");
@@ -0,0 +1,26 @@
+#!/usr/bin/env perl
+
+use t::lib::Perl::JIT::Test;
+
+plan skip_all => "perf output is Linux-specific" unless $^O eq 'linux';
+plan tests => 4;
+
+my $map = "/tmp/perf-$$.map";
+my $dump = "/tmp/jit-$$.dump";
+unlink $map, $dump;
+
+my $sub = build_jit_test_sub('$x', '$x += 30; $x += 5', '$x');
+Perl::JIT::Emit::jit_sub($sub, perf => 'map,jitdump');
+is($sub->(7), 42, "result");
+
+my $entries = do { local (@ARGV, $/) = $map; <> } // '';
+like($entries, qr/^[0-9a-f]+ [0-9a-f]+ \S+ \[.+:\d+\] #0$/m, "perf map entry");
+
+open my $fh, '<:raw', $dump or die "Can't open $dump: $!";
+read $fh, my $magic, 4;
+is(unpack('L', $magic), 0x4A695444, "jitdump header");
+
+eval { Perl::JIT::Emit::jit_sub($sub, perf => 'flamegraph') };
+like($@, qr/Invalid perf output 'flamegraph'/, "outputs checked");
+
+unlink $map, $dump;
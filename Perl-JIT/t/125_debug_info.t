@@ -0,0 +1,51 @@
+#!/usr/bin/env perl
+
+use t::lib::Perl::JIT::Test;
+
+plan skip_all => "jitdump is Linux-specific" unless $^O eq 'linux';
+plan tests => 3;
+
+my $dump = "/tmp/jit-$$.dump";
+unlink $dump;
+
+my $sub = eval <<'EOT' or die $@;
+#line 100 "debug_info.pl"
+use Perl::JIT;
+sub {
+  my ($x) = @_;
+  $x += 30;
+  $x += 5;
+  return $x;
+}
+EOT
+
+Perl::JIT::Emit::jit_sub($sub, perf => 'jitdump');
+is($sub->(7), 42, "result");
+
+my $data = do { local (@ARGV, $/) = $dump; binmode ARGV; <> } // '';
+my (%lines, $loads);
+for (my $offset = 40; $offset + 16 <= length $data; ) {
+  my ($id, $size) = unpack 'L L', substr $data, $offset, 8;
+  last unless $size;
+
+  if ($id == 0) {
+    ++$loads;
+  } elsif ($id == 2) {
+    my ($count) = unpack 'Q', substr $data, $offset + 24, 8;
+    my $entry = $offset + 32;
+
+    for (1 .. $count) {
+      my ($line, $file) = unpack 'x8 l x4 Z*', substr $data, $entry;
+      $lines{"$file:$line"} = 1;
+      $entry += 16 + length($file) + 1;
+    }
+  }
+  $offset += $size;
+}
+
+ok($loads, "code load records");
+ok($lines{'debug_info.pl:103'} || $lines{'debug_info.pl:104'},
+   "code attributed to source lines")
+  or diag(join ', ', sort keys %lines);
+
+unlink $dump;
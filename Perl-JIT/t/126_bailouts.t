@@ -0,0 +1,18 @@
+#!/usr/bin/env perl
+
+use t::lib::Perl::JIT::Test;
+
+plan tests => 4;
+
+Perl::JIT::Emit::reset_bailouts();
+is_deeply(Perl::JIT::Emit::bailouts(), {}, "no bailouts after reset");
+
+my $sub = build_jit_test_sub('$x', '$x += length $x; $x += 1', '$x');
+Perl::JIT::Emit::jit_sub($sub);
+is($sub->(10), 13, "result");
+
+my $bailouts = Perl::JIT::Emit::bailouts();
+cmp_ok($bailouts->{unknown_op}{length} // 0, '>=', 1, "unsupported op recorded");
+
+Perl::JIT::Emit::reset_bailouts();
+is_deeply(Perl::JIT::Emit::bailouts(), {}, "reset");
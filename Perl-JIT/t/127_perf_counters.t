@@ -0,0 +1,17 @@
+#!/usr/bin/env perl
+
+use t::lib::Perl::JIT::Test;
+
+my $counters = Perl::JIT::PerfCounters->new;
+plan skip_all => "hardware performance counters not available"
+  unless $counters->is_available;
+plan tests => 2;
+
+my $x = 0;
+$counters->start;
+$x += $_ for 1 .. 10_000;
+$counters->stop;
+
+my $counts = $counters->counts;
+ok(scalar keys %$counts, "events counted");
+cmp_ok($counts->{instructions} // 1, '>', 0, "instructions");
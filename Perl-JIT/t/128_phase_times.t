@@ -0,0 +1,21 @@
+#!/usr/bin/env perl
+
+use t::lib::Perl::JIT::Test;
+
+plan tests => 5;
+
+Perl::JIT::Emit::reset_phase_times();
+my $times = Perl::JIT::Emit::phase_times();
+is_deeply([sort keys %$times],
+          [qw(build_ast cache codegen emit find_candidates infer_types optimize)],
+          "all phases reported");
+is((grep $_->{count}, values %$times), 0, "no timings after reset");
+
+my $sub = build_jit_test_sub('$x', '$x = $x + 1', '$x');
+Perl::JIT::Emit::jit_sub($sub);
+Perl::JIT::Emit::wait_for_compilation();
+is($sub->(10), 11, "result");
+
+$times = Perl::JIT::Emit::phase_times();
+cmp_ok($times->{$_}{count}, '>=', 1, "$_ timed")
+  for qw(find_candidates emit);
@@ -0,0 +1,23 @@
+#!/usr/bin/env perl
+
+use t::lib::Perl::JIT::Test;
+use Perl::JIT qw(:all);
+
+plan tests => 6;
+
+# the arena of the ASTs is released once no Perl object refers to it
+my @asts = Perl::JIT::find_jit_candidates(sub { my $x = $_[0] + 1; return $x * 2 });
+ok(scalar @asts, "found candidates");
+
+my @kids = map $_->get_kids, @asts;
+@asts = ();
+ok(scalar @kids, "kids outlive their parents");
+ok(!grep(!defined $_->get_type, @kids), "kids are still usable");
+
+my $double = Perl::JIT::AST::Scalar->new(pj_double_type);
+is($double->to_string, 'Double', "scalar type");
+
+my $array = Perl::JIT::AST::Array->new($double);
+undef $double;
+is($array->to_string, 'Array[Double]', "element type outlives its Perl object");
+is($array->element->to_string, 'Double', "element type");
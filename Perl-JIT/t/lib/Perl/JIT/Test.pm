@@ -22,6 +22,7 @@ our @EXPORT = qw(
   is_jitting
   is_not_jitting
   is_not_jitted
+  count_adds
   run_jit_tests
   count_jit_tests
   build_jit_test_sub
@@ -247,6 +248,15 @@ sub is_not_jitted {
   return ok(1, $diag);
 }
 
+# Number of add ops left in the op tree of a sub, to tell whether its
+# JITted code has been installed
+sub count_adds {
+  my ($sub) = @_;
+  my ($count) = _count_matches($sub, [{ name => 'add' }]);
+
+  return $count;
+}
+
 sub count_jit_tests {
   my $tests = shift;
   return 2 * @$tests;
@@ -351,7 +361,42 @@ sub compile_and_test {
     print "\n=======================================\nBenchmarking $name:\n";
     $bench->report;
     print "\n";
+
+    report_perf_counters($repeat,
+      perl => sub {$perl_sub->(@args) for 1..$repeat;},
+      jit  => sub {$jit_sub->(@args)  for 1..$repeat;},
+    ) if $args{perf_counters} // $ENV{BENCHMARK_COUNTERS};
+  }
+}
+
+# Hardware counters for each variant, per iteration, to tell fewer
+# instructions apart from fewer stalls (mispredicted runloop dispatch,
+# cache and TLB misses)
+sub report_perf_counters {
+  my ($repeat, @variants) = @_;
+  my $counters = Perl::JIT::PerfCounters->new;
+
+  unless ($counters->is_available) {
+    print "Hardware performance counters not available\n\n";
+    return;
+  }
+
+  while (my ($variant, $code) = splice @variants, 0, 2) {
+    $counters->start;
+    $code->();
+    $counters->stop;
+
+    my $counts = $counters->counts;
+    my @report = sprintf "%-5s", $variant;
+    push @report, sprintf "IPC %.2f", $counts->{instructions} / $counts->{cycles}
+      if $counts->{cycles} && exists $counts->{instructions};
+    for my $event (qw(cycles instructions branch_misses l1d_misses llc_misses itlb_misses)) {
+      next unless exists $counts->{$event};
+      push @report, sprintf "%s/iter %.1f", $event, $counts->{$event} / $repeat;
+    }
+    print join('  ', @report), "\n";
   }
+  print "\n";
 }
 
 package t::lib::Perl::JIT::Test;